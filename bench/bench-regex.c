@@ -0,0 +1,681 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "regex.h"
+#include "regex-private.h"
+#include "ccl.h"
+#include "cache.h"
+
+// generated by the Makefile from tests/shell-tokens.txt
+#include "shell-matcher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Runs every benchmark below with a few warmup passes followed by timed
+ * passes, and reports the median pass as one row of CSV (the default) or
+ * JSON, so that runs of different versions can be diffed:
+ *
+ *      bin/bench-regex [--format csv|json] [--iters n] [--warmup n] [--filter str]
+ *
+ * A pass makes one call to the matcher per line for the line benchmarks,
+ * and one call per match (or per token) for the others, so `ns_per_match`
+ * is the median time of a pass over the number of calls it made
+ */
+
+#define NUM_LINES 1000000
+#define LINE_LEN  64
+
+/**
+ * @brief what a single pass of a benchmark does
+ * --------
+ *      BENCH_RECOMPILE re_is_match on every line, compiling the pattern each time
+ *      BENCH_CACHED    re_is_match on every line, with the pattern cache on
+ *      BENCH_EACH      re_is_match on every line with each alternative of the
+ *                      pattern in turn, until one matches
+ *      BENCH_MATCH     re_pattern_match on every line, or on the whole text
+ *      BENCH_FIND      re_pattern_find on every line, copying each match
+ *      BENCH_SPAN      re_pattern_span on every line, copying nothing
+ *      BENCH_BUDGET    re_pattern_match_budget on every line, or on the whole
+ *                      text, with a budget and deadline it never reaches
+ *      BENCH_BATCH     re_pattern_match_batch over every line, on every processor
+ *      BENCH_ITER      every match in the text, with an iterator
+ *      BENCH_STREAM    every match in the text, fed to a stream in 64 KiB chunks
+ *      BENCH_LEX       tokenizes the text with one set of every token pattern
+ *      BENCH_LEX_EACH  tokenizes the text with a set per token pattern
+ *      BENCH_LEX_GEN   tokenizes the text with the matcher regex-gen generated
+ *      BENCH_CCL       ccl_span over the text, with the kernel given as the flags
+ */
+typedef enum bench_kind {
+    BENCH_RECOMPILE, BENCH_CACHED, BENCH_EACH, BENCH_MATCH, BENCH_FIND, BENCH_SPAN, BENCH_BUDGET, BENCH_BATCH, BENCH_ITER, BENCH_STREAM, BENCH_LEX, BENCH_LEX_EACH, BENCH_LEX_GEN, BENCH_CCL
+} bench_kind_t;
+
+/**
+ * @brief the inputs the benchmarks run over
+ * --------
+ *      INPUT_LINES     a million short log lines, one in a hundred with an email
+ *      INPUT_LOG       16 MB of log lines with a single match at the very end
+ *      INPUT_PROSE     16 MB on one line, beginning with an unterminated quote
+ *      INPUT_SCRIPT    4 MB of a shell script with ten kinds of token
+ *      INPUT_XY_SHORT  128 bytes of alternating `y`s and `x`s
+ *      INPUT_XY_LONG   1 MB of alternating `y`s and `x`s
+ *      INPUT_AS        24 `a`s
+ */
+typedef enum bench_input {
+    INPUT_LINES, INPUT_LOG, INPUT_PROSE, INPUT_SCRIPT, INPUT_XY_SHORT, INPUT_XY_LONG, INPUT_AS, NUM_INPUTS
+} bench_input_t;
+
+typedef struct bench {
+    const char   *group;    /* the kind of workload */
+    const char   *name;     /* the engine or variant being measured */
+    bench_kind_t  kind;     /* what a pass does */
+    const char   *pattern;  /* the pattern to match */
+    int           flags;    /* the `re_flags_t` to compile with (see BENCH_CCL) */
+    bench_input_t input;    /* the input to match against */
+} bench_t;
+
+static const bench_t BENCHES[] = {
+    // repeated small matches
+    { "small",      "recompile",            BENCH_RECOMPILE, "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LINES },
+    { "small",      "cached",               BENCH_CACHED,    "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LINES },
+    { "small",      "backtrack",            BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LINES },
+    { "small",      "nfa",                  BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_NFA,                    INPUT_LINES },
+    { "small",      "dfa",                  BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_DFA,                    INPUT_LINES },
+    { "small",      "jit",                  BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_JIT,                    INPUT_LINES },
+    { "small",      "find (copy)",          BENCH_FIND,      "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LINES },
+    { "small",      "span (no copy)",       BENCH_SPAN,      "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LINES },
+    { "small",      "backtrack (budget)",   BENCH_BUDGET,    "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LINES },
+    { "small",      "batch (all cores)",    BENCH_BATCH,     "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LINES },
+    { "small",      "batch jit (all cores)", BENCH_BATCH,    "\\w+@\\w+\\.com",      RE_JIT,                    INPUT_LINES },
+
+    // any of several words, in one pattern or one call per word
+    { "alternation", "one call per word",   BENCH_EACH,      "mail|error|warning|timeout|refused|denied", RE_BACKTRACK, INPUT_LINES },
+    { "alternation", "cached",              BENCH_CACHED,    "mail|error|warning|timeout|refused|denied", RE_BACKTRACK, INPUT_LINES },
+    { "alternation", "dfa",                 BENCH_MATCH,     "mail|error|warning|timeout|refused|denied", RE_DFA,       INPUT_LINES },
+
+    // large buffers with a single match
+    { "scan-rare",  "backtrack (no prefilter)", BENCH_MATCH, "export [A-Z]+=",      RE_NO_PREFILTER,           INPUT_LOG },
+    { "scan-rare",  "backtrack",            BENCH_MATCH,     "export [A-Z]+=",      RE_BACKTRACK,              INPUT_LOG },
+    { "scan-rare",  "dfa (no prefilter)",   BENCH_MATCH,     "export [A-Z]+=",      RE_DFA | RE_NO_PREFILTER,  INPUT_LOG },
+    { "scan-rare",  "dfa",                  BENCH_MATCH,     "export [A-Z]+=",      RE_DFA,                    INPUT_LOG },
+    { "scan-rare",  "backtrack (no prefilter)", BENCH_MATCH, "\\w+@\\w+\\.com",     RE_NO_PREFILTER,           INPUT_LOG },
+    { "scan-rare",  "backtrack",            BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LOG },
+    { "scan-rare",  "dfa (no prefilter)",   BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_DFA | RE_NO_PREFILTER,  INPUT_LOG },
+    { "scan-rare",  "dfa",                  BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_DFA,                    INPUT_LOG },
+    { "scan-rare",  "jit",                  BENCH_MATCH,     "\\w+@\\w+\\.com",      RE_JIT,                    INPUT_LOG },
+    { "scan-rare",  "backtrack (budget)",   BENCH_BUDGET,    "\\w+@\\w+\\.com",      RE_BACKTRACK,              INPUT_LOG },
+
+    // large buffers with a match every few bytes
+    { "scan-many",  "backtrack",            BENCH_ITER,      "f[a-z]+ ",            RE_BACKTRACK,              INPUT_PROSE },
+    { "scan-many",  "dfa",                  BENCH_ITER,      "f[a-z]+ ",            RE_DFA,                    INPUT_PROSE },
+    { "scan-many",  "backtrack",            BENCH_ITER,      "[0-9]+ ms",           RE_BACKTRACK,              INPUT_LOG },
+    { "scan-many",  "dfa",                  BENCH_ITER,      "[0-9]+ ms",           RE_DFA,                    INPUT_LOG },
+    { "scan-many",  "backtrack",            BENCH_ITER,      "[0-9]{1,3} ms",       RE_BACKTRACK,              INPUT_LOG },
+    { "scan-many",  "dfa",                  BENCH_ITER,      "[0-9]{1,3} ms",       RE_DFA,                    INPUT_LOG },
+    { "scan-many",  "jit",                  BENCH_ITER,      "[0-9]{1,3} ms",       RE_JIT,                    INPUT_LOG },
+    { "scan-many",  "nfa",                  BENCH_ITER,      "[0-9]{1,3} ms",       RE_NFA,                    INPUT_LOG },
+    { "scan-many",  "stream (64 KiB chunks)", BENCH_STREAM,  "[0-9]{1,3} ms",       RE_NFA,                    INPUT_LOG },
+    { "scan-many",  "backtrack",            BENCH_ITER,      "a.?c",                RE_BACKTRACK,              INPUT_PROSE },
+    { "scan-many",  "jit",                  BENCH_ITER,      "a.?c",                RE_JIT,                    INPUT_PROSE },
+
+    // long runs of a single class
+    { "class",      "backtrack",            BENCH_MATCH,     "^[^\n]*$",            RE_BACKTRACK,              INPUT_PROSE },
+    { "class",      "dfa",                  BENCH_MATCH,     "^[^\n]*$",            RE_DFA,                    INPUT_PROSE },
+    { "class",      "backtrack",            BENCH_MATCH,     "\"[^\"]*\"",          RE_BACKTRACK,              INPUT_PROSE },
+    { "class",      "dfa",                  BENCH_MATCH,     "\"[^\"]*\"",          RE_DFA,                    INPUT_PROSE },
+    { "class",      "backtrack",            BENCH_MATCH,     "[0-9]+ms",            RE_BACKTRACK,              INPUT_PROSE },
+    { "class",      "dfa",                  BENCH_MATCH,     "[0-9]+ms",            RE_DFA,                    INPUT_PROSE },
+    { "class",      "jit",                  BENCH_MATCH,     "[0-9]+ms",            RE_JIT,                    INPUT_PROSE },
+    { "class",      "scalar",               BENCH_CCL,       "[^\n]",               CCL_SCALAR,                INPUT_PROSE },
+    { "class",      "sse2",                 BENCH_CCL,       "[^\n]",               CCL_SSE2,                  INPUT_PROSE },
+    { "class",      "avx2",                 BENCH_CCL,       "[^\n]",               CCL_AVX2,                  INPUT_PROSE },
+    { "class",      "scalar",               BENCH_CCL,       "[a-zA-Z0-9 \"]",      CCL_SCALAR,                INPUT_PROSE },
+    { "class",      "sse2",                 BENCH_CCL,       "[a-zA-Z0-9 \"]",      CCL_SSE2,                  INPUT_PROSE },
+    { "class",      "avx2",                 BENCH_CCL,       "[a-zA-Z0-9 \"]",      CCL_AVX2,                  INPUT_PROSE },
+
+    // exponential (or high polynomial) backtracking
+    { "pathological", "backtrack",          BENCH_MATCH,     ".*x.*y.*z",           RE_BACKTRACK,              INPUT_XY_SHORT },
+    { "pathological", "nfa",                BENCH_MATCH,     ".*x.*y.*z",           RE_NFA,                    INPUT_XY_SHORT },
+    { "pathological", "nfa",                BENCH_MATCH,     ".*x.*y.*z",           RE_NFA,                    INPUT_XY_LONG },
+    { "pathological", "backtrack (memo)",   BENCH_MATCH,     ".*x.*y.*z",           RE_BACKTRACK,              INPUT_XY_LONG },
+    { "pathological", "backtrack (budget)", BENCH_BUDGET,    ".*x.*y.*z",           RE_BACKTRACK,              INPUT_XY_LONG },
+    { "pathological", "dfa",                BENCH_MATCH,     ".*x.*y.*z",           RE_DFA,                    INPUT_XY_LONG },
+    { "pathological", "backtrack",          BENCH_MATCH,     "a*a*a*a*a*[bc]",      RE_BACKTRACK,              INPUT_AS },
+    { "pathological", "nfa",                BENCH_MATCH,     "a*a*a*a*a*[bc]",      RE_NFA,                    INPUT_AS },
+    { "pathological", "dfa",                BENCH_MATCH,     "a*a*a*a*a*[bc]",      RE_DFA,                    INPUT_AS },
+
+    // tokenizing with many patterns at once
+    { "lex",        "one set per pattern",  BENCH_LEX_EACH,  "",                    RE_BACKTRACK,              INPUT_SCRIPT },
+    { "lex",        "combined set",         BENCH_LEX,       "",                    RE_BACKTRACK,              INPUT_SCRIPT },
+    { "lex",        "generated matcher",    BENCH_LEX_GEN,   "",                    RE_BACKTRACK,              INPUT_SCRIPT },
+};
+
+#define NUM_BENCHES (sizeof(BENCHES) / sizeof(BENCHES[0]))
+
+/* the token patterns of the lexing benchmarks, which are those of tests/shell-tokens.txt */
+static const char *LEX_PATTERNS[] = {
+    "if", "then", "fi", "[a-z_][a-z_0-9]*", "\\d+", "\\s+", ">>", ">", "\\|", "-", "\"[^\"]*\"", "--?[a-z]+(=\\w+)?"
+};
+static const int   LEX_TOKENS[]   = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+#define NUM_LEX_PATTERNS (sizeof(LEX_PATTERNS) / sizeof(LEX_PATTERNS[0]))
+
+/* the size of the chunks BENCH_STREAM feeds */
+#define STREAM_CHUNK (64 * 1024)
+
+/* the most alternatives BENCH_EACH splits a pattern into */
+#define MAX_ALTS 16
+
+/***********************************
+ *         Bench Structures        *
+ ***********************************/
+typedef struct inputs {
+    char  **lines;          /* INPUT_LINES */
+    size_t  lines_len;      /* the total length of the lines */
+    char   *text[NUM_INPUTS]; /* every other input, null-terminated */
+} inputs_t;
+
+typedef struct state {
+    const bench_t *bench;
+    const inputs_t *inputs;
+    re_pattern_t  *pattern;                     /* compiled once, outside the timing */
+    re_set_t      *sets[NUM_LEX_PATTERNS];      /* BENCH_LEX and BENCH_LEX_EACH only */
+    size_t         nsets;
+    char          *alts[MAX_ALTS];              /* BENCH_EACH only */
+    size_t         nalts;
+    ccl_t          ccl;                         /* BENCH_CCL only */
+    re_subject_t  *subjects;                    /* BENCH_BATCH only */
+    unsigned char *matched;                     /* BENCH_BATCH only */
+} state_t;
+
+typedef struct result {
+    size_t calls;           /* calls made to the matcher in a pass */
+    size_t matches;         /* matches found in a pass */
+    size_t bytes;           /* bytes of input in a pass */
+} result_t;
+
+typedef struct options {
+    int         json;       /* true to print JSON rather than CSV */
+    int         iters;      /* timed passes per benchmark */
+    int         warmup;     /* untimed passes per benchmark */
+    const char *filter;     /* only run benchmarks whose group or name contains this */
+} options_t;
+
+/***********************************
+ *             Inputs              *
+ ***********************************/
+
+/* returns the current monotonic time in seconds */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* fills `lines` with log-like lines, one in every hundred containing an email */
+static char **make_lines(int n, size_t *total) {
+    char **lines = malloc(n * sizeof(char *));
+    *total = 0;
+
+    for (int i = 0; i < n; i++) {
+        lines[i] = malloc(LINE_LEN);
+        if (i % 100 == 0)
+            snprintf(lines[i], LINE_LEN, "%06d INFO sent mail to user%d@example.com", i, i);
+        else
+            snprintf(lines[i], LINE_LEN, "%06d INFO request served in %d ms", i, i % 997);
+        *total += strlen(lines[i]);
+    }
+
+    return lines;
+}
+
+/* fills a large buffer with log-like lines, with a single match at the very end */
+static char *make_log(size_t len) {
+    char *text = malloc(len + 1);
+    size_t idx = 0;
+
+    for (int i = 0; idx + LINE_LEN < len; i++)
+        idx += snprintf(text + idx, LINE_LEN, "%06d INFO request served in %d ms\n", i, i % 997);
+
+    strcpy(text + idx - LINE_LEN, "export PATH=sent mail to user@example.com\n");
+    return text;
+}
+
+/* repeats `str` to fill a buffer of `len` characters */
+static char *make_repeated(const char *str, size_t len) {
+    const size_t str_len = strlen(str);
+    char *text = malloc(len + 1);
+
+    for (size_t i = 0; i < len; i++)
+        text[i] = str[i % str_len];
+    text[len] = '\0';
+
+    return text;
+}
+
+static void make_inputs(inputs_t *inputs) {
+    inputs->lines = make_lines(NUM_LINES, &inputs->lines_len);
+    inputs->text[INPUT_LINES] = NULL;
+    inputs->text[INPUT_LOG] = make_log(16 << 20);
+
+    // one long line, one long quoted string and no digits at all
+    inputs->text[INPUT_PROSE] = make_repeated("the quick brown fox jumps over the lazy dog ", 16 << 20);
+    inputs->text[INPUT_PROSE][0] = '"';
+
+    inputs->text[INPUT_SCRIPT] = make_repeated("if test -f out_1 then cat log_2 | head -12 >> out_1 fi\n", 4 << 20);
+    inputs->text[INPUT_XY_SHORT] = make_repeated("yx", 128);
+    inputs->text[INPUT_XY_LONG] = make_repeated("yx", 1 << 20);
+    inputs->text[INPUT_AS] = make_repeated("a", 24);
+}
+
+static void free_inputs(inputs_t *inputs) {
+    for (int i = 0; i < NUM_LINES; i++)
+        free(inputs->lines[i]);
+    free(inputs->lines);
+
+    for (int i = 0; i < NUM_INPUTS; i++)
+        free(inputs->text[i]);
+}
+
+/***********************************
+ *             Passes              *
+ ***********************************/
+
+/* compiles what the benchmark needs, returning false if it cannot run here */
+static int setup(state_t *state) {
+    const bench_t *bench = state->bench;
+
+    switch (bench->kind) {
+        case BENCH_RECOMPILE:
+            re_cache_set_capacity(0);
+            return 1;
+
+        case BENCH_CACHED:
+            return 1;
+
+        case BENCH_EACH:
+            // the pattern is a plain list of alternatives, without groups
+            for (const char *alt = bench->pattern; state->nalts < MAX_ALTS; alt++) {
+                const size_t len = strcspn(alt, "|");
+                state->alts[state->nalts] = malloc(len + 1);
+                memcpy(state->alts[state->nalts], alt, len);
+                state->alts[state->nalts++][len] = '\0';
+
+                alt += len;
+                if (!*alt)
+                    break;
+            }
+            return 1;
+
+        case BENCH_LEX:
+            state->sets[state->nsets++] = re_set_compile(LEX_PATTERNS, LEX_TOKENS, NUM_LEX_PATTERNS);
+            return 1;
+
+        case BENCH_LEX_EACH:
+            // one pass over each token per pattern
+            for (size_t i = 0; i < NUM_LEX_PATTERNS; i++)
+                state->sets[state->nsets++] = re_set_compile(&LEX_PATTERNS[i], &LEX_TOKENS[i], 1);
+            return 1;
+
+        case BENCH_LEX_GEN:
+            // the matcher was compiled along with the benchmark
+            return 1;
+
+        case BENCH_CCL: {
+            re_t *reg = re_compile(bench->pattern);
+            ccl_compile(&state->ccl, reg);
+            re_free(reg);
+
+#if defined(__x86_64__)
+            if (bench->flags == CCL_AVX2 && !__builtin_cpu_supports("avx2"))
+                return 0;
+            if (bench->flags == CCL_SSE2 && state->ccl.nranges > CCL_MAX_RANGES)
+                return 0;
+#else
+            if (bench->flags != CCL_SCALAR)
+                return 0;
+#endif
+            state->ccl.kernel = bench->flags;
+            return 1;
+        }
+
+        case BENCH_BATCH:
+            // every line is handed over at once
+            state->subjects = malloc(NUM_LINES * sizeof(re_subject_t));
+            state->matched = malloc(NUM_LINES / 8 + 1);
+            for (int i = 0; i < NUM_LINES; i++)
+                state->subjects[i] = (re_subject_t) { state->inputs->lines[i], strlen(state->inputs->lines[i]) };
+            state->pattern = re_pattern_compile_flags(bench->pattern, bench->flags);
+            return state->pattern != NULL;
+
+        default:
+            state->pattern = re_pattern_compile_flags(bench->pattern, bench->flags);
+            return state->pattern != NULL;
+    }
+}
+
+static void teardown(state_t *state) {
+    re_cache_set_capacity(CACHE_DEFAULT_CAPACITY);
+    re_cache_clear();
+    re_pattern_free(state->pattern);
+    for (size_t i = 0; i < state->nsets; i++)
+        re_set_free(state->sets[i]);
+    for (size_t i = 0; i < state->nalts; i++)
+        free(state->alts[i]);
+    free(state->subjects);
+    free(state->matched);
+}
+
+/* returns a budget no benchmark runs out of, so that only checking it is
+   measured (the clock included) */
+static re_budget_t ample_budget() {
+    re_budget_t budget = { (size_t) 1 << 40, { 0, 0 } };
+    clock_gettime(CLOCK_MONOTONIC, &budget.deadline);
+    budget.deadline.tv_sec += 3600;
+    return budget;
+}
+
+/* runs the benchmark over every line of the input */
+static result_t pass_lines(const state_t *state) {
+    const bench_t *bench = state->bench;
+    char **lines = state->inputs->lines;
+    result_t res = { NUM_LINES, 0, state->inputs->lines_len };
+    const re_budget_t budget = ample_budget();
+    re_span_t span;
+    char *match;
+
+    if (bench->kind == BENCH_BATCH) {
+        res.matches = re_pattern_match_batch(state->pattern, state->subjects, NUM_LINES, state->matched, NULL, 0);
+        return res;
+    }
+
+    for (int i = 0; i < NUM_LINES; i++) {
+        switch (bench->kind) {
+            case BENCH_RECOMPILE:
+            case BENCH_CACHED:
+                res.matches += re_is_match((char *) bench->pattern, lines[i]);
+                break;
+            case BENCH_EACH:
+                for (size_t j = 0; j < state->nalts; j++) {
+                    if (re_is_match(state->alts[j], lines[i])) {
+                        res.matches++;
+                        break;
+                    }
+                }
+                break;
+            case BENCH_MATCH:
+                res.matches += re_pattern_match(state->pattern, lines[i]);
+                break;
+            case BENCH_FIND:
+                match = re_pattern_find(state->pattern, lines[i]);
+                res.matches += match != NULL;
+                free(match);
+                break;
+            case BENCH_SPAN:
+                res.matches += re_pattern_span(state->pattern, lines[i], &span);
+                break;
+            case BENCH_BUDGET:
+                res.matches += re_pattern_match_budget(state->pattern, lines[i], strlen(lines[i]), &budget) == 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return res;
+}
+
+/* tokenizes the text, taking the longest token of any set at each position */
+static result_t pass_lex(const state_t *state, const char *text, size_t len) {
+    result_t res = { 0, 0, len };
+    int token;
+
+    for (size_t pos = 0; pos < len; ) {
+        long best = -1;
+
+        for (size_t i = 0; i < state->nsets; i++) {
+            long match = re_set_match(state->sets[i], text + pos, len - pos, &token);
+            if (match > best)
+                best = match;
+            res.calls++;
+        }
+
+        res.matches += best > 0;
+        pos += best > 0 ? best : 1;
+    }
+
+    return res;
+}
+
+/* tokenizes the text like pass_lex, with the generated matcher */
+static result_t pass_lex_gen(const char *text, size_t len) {
+    result_t res = { 0, 0, len };
+    int token;
+
+    for (size_t pos = 0; pos < len; ) {
+        long match = shell_match(text + pos, len - pos, &token);
+        res.calls++;
+
+        res.matches += match > 0;
+        pos += match > 0 ? match : 1;
+    }
+
+    return res;
+}
+
+/* counts the matches of a stream */
+static void count_match(re_span_t span, void *data) {
+    (void) span;
+    ++*(size_t *) data;
+}
+
+/* feeds the text to a stream a chunk at a time */
+static result_t pass_stream(const state_t *state, const char *text, size_t len) {
+    result_t res = { 0, 0, len };
+    re_stream_t *stream = re_stream_new(state->pattern, count_match, &res.matches);
+
+    for (size_t pos = 0; pos < len; pos += STREAM_CHUNK)
+        re_stream_feed(stream, text + pos, len - pos < STREAM_CHUNK ? len - pos : STREAM_CHUNK);
+
+    re_stream_finish(stream);
+    re_stream_free(stream);
+
+    // each match is reported by a call, as with an iterator
+    res.calls = res.matches + 1;
+    return res;
+}
+
+/* runs a single pass of the benchmark */
+static result_t pass(const state_t *state) {
+    const char *text = state->inputs->text[state->bench->input];
+    result_t res = { 1, 0, 0 };
+    re_budget_t budget;
+    re_iter_t iter;
+    re_span_t span;
+
+    if (state->bench->input == INPUT_LINES)
+        return pass_lines(state);
+
+    res.bytes = strlen(text);
+
+    switch (state->bench->kind) {
+        case BENCH_MATCH:
+            res.matches = re_pattern_match(state->pattern, text);
+            break;
+        case BENCH_BUDGET:
+            budget = ample_budget();
+            res.matches = re_pattern_match_budget(state->pattern, text, res.bytes, &budget) == 1;
+            break;
+        case BENCH_ITER:
+            re_iter_init_n(&iter, state->pattern, text, res.bytes);
+            while (re_iter_next(&iter, &span))
+                res.matches++;
+            res.calls = res.matches + 1;
+            break;
+        case BENCH_STREAM:
+            return pass_stream(state, text, res.bytes);
+        case BENCH_LEX:
+        case BENCH_LEX_EACH:
+            return pass_lex(state, text, res.bytes);
+        case BENCH_LEX_GEN:
+            return pass_lex_gen(text, res.bytes);
+        case BENCH_CCL:
+            res.matches = ccl_span(&state->ccl, text, text + res.bytes) - text;
+            break;
+        default:
+            break;
+    }
+
+    return res;
+}
+
+/***********************************
+ *            Reporting            *
+ ***********************************/
+
+static int compare_doubles(const void *a, const void *b) {
+    const double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* prints `str` as a quoted CSV or JSON string */
+static void print_string(const char *str, int json) {
+    putchar('"');
+
+    for (; *str; str++) {
+        if (!json && *str == '"')
+            printf("\"\"");
+        else if (json && (*str == '"' || *str == '\\'))
+            printf("\\%c", *str);
+        else if ((unsigned char) *str < ' ')
+            printf(json ? "\\u%04x" : "\\x%02x", (unsigned char) *str);
+        else
+            putchar(*str);
+    }
+
+    putchar('"');
+}
+
+/* prints a row of results: the benchmark, then the median pass */
+static void report(const bench_t *bench, const result_t *res, const double *secs, const options_t *opts, int first) {
+    const double median = secs[opts->iters / 2];
+    const char *fields[] = { "group", "name", "pattern", "bytes", "iters", "ns_per_match", "mb_per_s", "matches", "min_ms", "median_ms" };
+
+    if (first && !opts->json) {
+        for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+            printf("%s%s", i ? "," : "", fields[i]);
+        putchar('\n');
+    }
+
+    if (opts->json)
+        printf("%s\n  { \"%s\": ", first ? "[" : ",", fields[0]);
+    print_string(bench->group, opts->json);
+
+    if (opts->json)
+        printf(", \"%s\": ", fields[1]);
+    else
+        putchar(',');
+    print_string(bench->name, opts->json);
+
+    if (opts->json)
+        printf(", \"%s\": ", fields[2]);
+    else
+        putchar(',');
+    print_string(*bench->pattern ? bench->pattern : "(token patterns)", opts->json);
+
+    const double values[] = {
+        res->bytes, opts->iters, 1e9 * median / res->calls, res->bytes / median / 1e6, res->matches,
+        1e3 * secs[0], 1e3 * median
+    };
+    const char *formats[] = { "%.0f", "%.0f", "%.2f", "%.1f", "%.0f", "%.3f", "%.3f" };
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        if (opts->json)
+            printf(", \"%s\": ", fields[3 + i]);
+        else
+            putchar(',');
+        printf(formats[i], values[i]);
+    }
+
+    printf(opts->json ? " }" : "\n");
+}
+
+/* runs the warmup and timed passes of a benchmark, returning false if it was skipped */
+static int run(const bench_t *bench, const inputs_t *inputs, const options_t *opts, int first) {
+    state_t state = { .bench = bench, .inputs = inputs };
+    double *secs = malloc(opts->iters * sizeof(double));
+    result_t res = { 0 };
+
+    if (!setup(&state)) {
+        teardown(&state);
+        free(secs);
+        return 0;
+    }
+
+    for (int i = 0; i < opts->warmup; i++)
+        pass(&state);
+
+    for (int i = 0; i < opts->iters; i++) {
+        double start = now();
+        res = pass(&state);
+        secs[i] = now() - start;
+    }
+
+    qsort(secs, opts->iters, sizeof(double), compare_doubles);
+    report(bench, &res, secs, opts, first);
+
+    teardown(&state);
+    free(secs);
+    return 1;
+}
+
+static int usage(void) {
+    fprintf(stderr, "Usage: bench-regex [--format csv|json] [--iters n] [--warmup n] [--filter str]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    options_t opts = { 0, 5, 1, NULL };
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc)
+            return usage();
+
+        if (!strcmp(argv[i], "--format"))
+            opts.json = !strcmp(argv[++i], "json");
+        else if (!strcmp(argv[i], "--iters"))
+            opts.iters = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--warmup"))
+            opts.warmup = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--filter"))
+            opts.filter = argv[++i];
+        else
+            return usage();
+    }
+
+    if (opts.iters < 1 || opts.warmup < 0)
+        return usage();
+
+    inputs_t inputs;
+    make_inputs(&inputs);
+
+    int first = 1;
+    for (size_t i = 0; i < NUM_BENCHES; i++) {
+        const bench_t *bench = &BENCHES[i];
+
+        if (opts.filter && !strstr(bench->group, opts.filter) && !strstr(bench->name, opts.filter))
+            continue;
+
+        if (run(bench, &inputs, &opts, first)) {
+            first = 0;
+            fflush(stdout);
+        }
+    }
+
+    if (opts.json)
+        printf(first ? "[]\n" : "\n]\n");
+
+    free_inputs(&inputs);
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file arena.h
+ * @author Anshul Kamath
+ * @brief A bump allocator that compiled patterns draw their memory from.
+ *        Allocations are never freed one at a time: the whole arena is
+ *        released at once
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* the size of the blocks of an arena created with a block size of 0 */
+#define ARENA_DEFAULT_BLOCK (64 << 10)
+
+/***********************************
+ *        Arena Structures         *
+ ***********************************/
+typedef struct arena_block {
+    struct arena_block *next;   /* the previously filled block */
+    size_t              size;   /* the usable size of the block */
+    size_t              used;   /* the bytes handed out so far */
+    max_align_t         data[]; /* the memory handed out */
+} arena_block_t;
+
+typedef struct re_arena {
+    arena_block_t *head;        /* the block being filled, or NULL */
+    size_t         block_size;  /* the minimum size of a new block */
+    size_t         allocated;   /* the bytes handed out over the arena's life */
+} arena_t;
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief creates an empty arena, whose blocks are at least `block_size`
+ *        bytes (or ARENA_DEFAULT_BLOCK if it is 0)
+ * NOTE:  the returned arena must be freed with `arena_free`
+ * 
+ * @param block_size the minimum size of each block
+ * @return arena_t* 
+ */
+arena_t *arena_new(size_t block_size);
+
+/**
+ * @brief returns `size` bytes aligned for any type, from a new block if the
+ *        current one is full. Without an arena, falls back to malloc
+ * 
+ * @param arena the arena to allocate from (or NULL)
+ * @param size  the number of bytes to allocate
+ * @return void* 
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * @brief same as `arena_alloc`, but zeroes `n` elements of `size` bytes.
+ *        Without an arena, falls back to calloc
+ * 
+ * @param arena the arena to allocate from (or NULL)
+ * @param n     the number of elements
+ * @param size  the size of each element
+ * @return void* 
+ */
+void *arena_calloc(arena_t *arena, size_t n, size_t size);
+
+/**
+ * @brief frees every allocation made from the arena, and the arena itself
+ * 
+ * @param arena the arena to free (may be NULL)
+ */
+void arena_free(arena_t *arena);
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * @file cache.h
+ * @author Anshul Kamath
+ * @brief A bounded, thread-safe LRU cache of compiled patterns, keyed by the
+ *        pattern string, which lets `re_is_match` and `re_get_match` compile
+ *        each distinct pattern only once
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "regex.h"
+
+#include <stddef.h>
+
+/* the number of patterns the cache holds until it is resized */
+#define CACHE_DEFAULT_CAPACITY 64
+
+/* the number of buckets in the cache's table of patterns */
+#define CACHE_BUCKETS 256
+
+/***********************************
+ *         Cache Structures        *
+ ***********************************/
+typedef struct cache_entry {
+    char               *key;        /* the pattern string */
+    size_t              hash;       /* the hash of the pattern string */
+    re_pattern_t       *pattern;    /* the compiled pattern */
+    int                 refs;       /* the number of callers using the pattern */
+    int                 cached;     /* true while the entry is in the cache */
+    struct cache_entry *prev;       /* the next most recently used entry */
+    struct cache_entry *next;       /* the next least recently used entry */
+    struct cache_entry *chain;      /* the next entry in the same bucket */
+} cache_entry_t;
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief returns the cached entry of the pattern, compiling it (and evicting
+ *        the least recently used entry if the cache is full) on a miss.
+ *        Returns NULL if the pattern is malformed. Without room in the cache,
+ *        the entry is only for the caller
+ * NOTE:  the entry must be given back with `cache_release`
+ * 
+ * @param regexp the pattern to look up
+ * @return cache_entry_t* 
+ */
+cache_entry_t *cache_acquire(const char *regexp);
+
+/**
+ * @brief gives back an entry from `cache_acquire`, freeing it if it has been
+ *        evicted and no one else is using it
+ * 
+ * @param entry the entry to give back
+ */
+void cache_release(cache_entry_t *entry);
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file ccl.h
+ * @author Anshul Kamath
+ * @brief Scanners that test a character class against 16 or 32 bytes at a
+ *        time (SSE2 or AVX2, chosen at runtime, with a scalar fallback)
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef CCL_H
+#define CCL_H
+
+#include "regex-private.h"
+
+/* the most ranges the SSE2 kernel will compare against */
+#define CCL_MAX_RANGES 8
+
+/**
+ * @brief the kernels a scanner can use
+ * --------
+ *      CCL_SCALAR  one byte at a time, through the bitmap
+ *      CCL_SSE2    16 bytes at a time, comparing against each range
+ *      CCL_AVX2    32 bytes at a time, through nibble lookup tables
+ */
+typedef enum ccl_kernel {
+    CCL_SCALAR, CCL_SSE2, CCL_AVX2
+} ccl_kernel_t;
+
+/***********************************
+ *        Scanner Structure        *
+ ***********************************/
+typedef struct ccl {
+    unsigned char set[32];              /* bit `i` is set if byte `i` is in the class */
+    ccl_kernel_t  kernel;               /* the kernel used to scan */
+
+    /* SSE2: the class (or its complement, if `invert`) as a list of ranges */
+    unsigned char lo[CCL_MAX_RANGES];   /* the first byte of each range */
+    unsigned char width[CCL_MAX_RANGES];/* the number of bytes in each range, less one */
+    int           nranges;              /* the number of ranges */
+    int           invert;               /* true if the ranges hold the complement */
+
+    /* AVX2: bit `h` of nibbles[l] (nibbles[16 + l]) is set if the byte with
+       low nibble `l` and high nibble `h` (8 + h) is in the class */
+    unsigned char nibbles[32];
+} ccl_t;
+
+/***********************************
+ *        Helper Functions         *
+ ***********************************/
+
+/* returns true if `ch` is in the class */
+static inline int ccl_has(const ccl_t *ccl, unsigned char ch) {
+    return (ccl->set[ch >> 3] >> (ch & 7)) & 1;
+}
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief builds a scanner for the characters a single `re_t` (CHAR, DOT or
+ *        CHAR_CLASS) accepts
+ * 
+ * @param ccl   the scanner to build
+ * @param atom  the `re_t` to build it from
+ */
+void ccl_compile(ccl_t *ccl, const re_t *atom);
+
+/**
+ * @brief returns a pointer to the first character in [text, end) that is
+ *        not in the class, or `end` if there is none
+ * 
+ * @param ccl   the scanner to use
+ * @param text  the beginning of the text to scan
+ * @param end   the end of the text to scan
+ * @return const char* 
+ */
+const char *ccl_span(const ccl_t *ccl, const char *text, const char *end);
+
+/**
+ * @brief returns a pointer to the first character in [text, end) that is
+ *        in the class, or NULL if there is none
+ * 
+ * @param ccl   the scanner to use
+ * @param text  the beginning of the text to scan
+ * @param end   the end of the text to scan
+ * @return const char* 
+ */
+const char *ccl_find(const ccl_t *ccl, const char *text, const char *end);
+
+/**
+ * @brief attaches a scanner to every `*` or `+` atom of `reg` that is
+ *        followed by an atom it can never match. Such a run has to be
+ *        consumed in full, so `match_kleene` can skip over it in one scan
+ * NOTE:  returns the array of scanners (or NULL), which must be freed if
+ *        it was not drawn from an arena
+ * 
+ * @param reg   the compiled regexp, terminated by TERMINAL
+ * @param arena the arena to allocate from (or NULL)
+ * @return ccl_t* 
+ */
+ccl_t *ccl_annotate(re_t *reg, arena_t *arena);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file codegen.h
+ * @author Anshul Kamath
+ * @brief An ahead-of-time code generator, which builds the whole DFA of a set
+ *        of token patterns and writes it out as a C state machine, so that a
+ *        lexer pays nothing to compile its patterns at startup
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* the most DFA states a generated matcher may have */
+#define CODEGEN_MAX_STATES 4096
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief writes a C header defining an enum of the tokens and a function
+ *        `<prefix>_match`, which behaves like `re_set_match` on a set of the
+ *        patterns whose tokens are their indices. Every state of the set's DFA
+ *        becomes a label, and every transition a `goto`. Returns false if a
+ *        pattern is malformed, a name is not an identifier or the DFA has more
+ *        than `CODEGEN_MAX_STATES` states
+ * 
+ * @param out      where to write the header
+ * @param prefix   the prefix of every identifier in the header
+ * @param names    the name of each token, which follows the prefix in the enum
+ * @param patterns the pattern of each token
+ * @param n        the number of tokens
+ * @return int
+ */
+int codegen_write(FILE *out, const char *prefix, const char *const *names, const char *const *patterns, size_t n);
+
+#endif
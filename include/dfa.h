@@ -0,0 +1,135 @@
+/**
+ * @file dfa.h
+ * @author Anshul Kamath
+ * @brief A lazily constructed DFA over a Pike VM program. Each set of NFA
+ *        states is materialised once, on demand, and its transitions are
+ *        cached so matching costs a single table lookup per input byte
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef DFA_H
+#define DFA_H
+
+#include "nfa.h"
+
+#include <stddef.h>
+
+/* the default memory budget of a DFA's state cache, in bytes */
+#define DFA_DEFAULT_BUDGET (1 << 20)
+
+/* the number of buckets in a DFA's table of states */
+#define DFA_BUCKETS 1024
+
+/***********************************
+ *         DFA Structures          *
+ ***********************************/
+typedef struct dstate {
+    int            accept;      /* true if the set contains OP_MATCH */
+    int            accept_eol;  /* true if the set matches at the end of input */
+    int            token;       /* the lowest OP_MATCH token in the set, or -1 */
+    int            token_eol;   /* the lowest token matched at the end of input, or -1 */
+    int            n;           /* the number of instructions in the set */
+    int            bol;         /* true if the state is at the beginning of the input */
+    struct dstate *chain;       /* the next state in the same bucket */
+    struct dstate *next[256];   /* cached transitions (NULL if not computed yet) */
+    int            pcs[];       /* the (sorted) NFA instructions in the set */
+} dstate_t;
+
+typedef struct dfa {
+    const prog_t *prog;         /* the program the DFA simulates */
+    dstate_t     *start[2];     /* the start states past the beginning of the input
+                                   and at it (NULL until needed) */
+    dstate_t     *buckets[DFA_BUCKETS]; /* every materialised state, by hash */
+    size_t        mem;          /* bytes used by materialised states */
+    size_t        budget;       /* flush the cache when `mem` would exceed this */
+    int           has_bol;      /* true if the program has a `^` anywhere */
+    size_t        nstates;      /* the number of materialised states */
+    size_t        nflushes;     /* the number of times the cache was flushed */
+    size_t        nsteps;       /* the number of transitions worked out */
+#ifdef RE_STATS
+    size_t        nbytes;       /* the number of bytes stepped over */
+#endif
+
+    /* scratch space for computing the next set of instructions */
+    int          *set;          /* the set being built */
+    int          *mark;         /* mark[pc] == gen if pc is in `set` */
+    int          *stack;        /* the closure's explicit stack */
+    int           gen;          /* the current generation of `mark` */
+} dfa_t;
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief creates an empty DFA for `prog`, whose state cache is flushed
+ *        whenever it would grow past `budget` bytes
+ * NOTE:  this function allocates memory on the heap: must free
+ * 
+ * @param prog   the program to simulate, which must outlive the DFA
+ * @param budget the memory budget of the state cache, in bytes
+ * @return dfa_t* 
+ */
+dfa_t *dfa_new(const prog_t *prog, size_t budget);
+
+/**
+ * @brief frees the DFA and every state it has materialised
+ * 
+ * @param dfa 
+ */
+void dfa_free(dfa_t *dfa);
+
+/**
+ * @brief returns the start state of the DFA at the beginning of the input,
+ *        materialising it if needed
+ * 
+ * @param dfa 
+ * @return dstate_t* 
+ */
+dstate_t *dfa_start(dfa_t *dfa);
+
+/**
+ * @brief returns the state the DFA moves to from `state` on `ch`,
+ *        materialising it if needed. A state with no instructions is dead
+ * NOTE:  a flush frees every state, so the states returned so far are only
+ *        valid while the DFA stays within its budget
+ * 
+ * @param dfa   the DFA to run
+ * @param state the state to move from
+ * @param ch    the next input byte
+ * @return dstate_t* 
+ */
+dstate_t *dfa_next(dfa_t *dfa, dstate_t *state, unsigned char ch);
+
+/**
+ * @brief returns true if and only if the DFA's program matches somewhere
+ *        in [text, end), materialising states as they are reached
+ * 
+ * @param dfa   the DFA to run
+ * @param text  the beginning of the text to search
+ * @param end   the end of the text to search
+ * @param bol   true if `text` is the beginning of the input (where `^` matches)
+ * @return int 
+ */
+int dfa_is_match(dfa_t *dfa, const char *text, const char *end, int bol);
+
+/**
+ * @brief finds the longest match of the DFA's (anchored) program at the
+ *        beginning of [text, end), storing the token of the OP_MATCH that
+ *        produced it in `token` (the lowest token wins a tie). Returns the
+ *        length of the match, or -1 if there is none. `text` is taken to be
+ *        the beginning of the input, where `^` matches
+ * 
+ * @param dfa   the DFA to run
+ * @param text  the beginning of the text to match
+ * @param end   the end of the text to match
+ * @param token set to the token of the match
+ * @return long 
+ */
+long dfa_longest(dfa_t *dfa, const char *text, const char *end, int *token);
+
+#endif
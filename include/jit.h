@@ -0,0 +1,57 @@
+/**
+ * @file jit.h
+ * @author Anshul Kamath
+ * @brief A JIT that translates the backtracking matcher's program into x86-64
+ *        code, in which every instruction's test is specialised to its class
+ *        and the interpreter's dispatch on instruction types disappears
+ * @version 0.1
+ * @date 2022-05-03
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "regex-private.h"
+
+#include <stddef.h>
+
+/***********************************
+ *         JIT Structures          *
+ ***********************************/
+typedef char *(*jit_fn_t)(char *text, char *end);
+
+typedef struct jit {
+    jit_fn_t  match;        /* `match_here` from the instruction it was compiled at */
+    void     *mem;          /* the executable pages the code lives in */
+    size_t    size;         /* the size of the pages */
+} jit_t;
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief compiles the program into native code that returns the same as
+ *        `match_here(code, &code->inst[start], text, end)`. Returns NULL on
+ *        anything but x86-64, if the program has an instruction the
+ *        interpreter rejects or if executable memory cannot be mapped
+ * NOTE:  this function allocates memory: must free with `jit_free`. The
+ *        code reads the program's classes, so it must not outlive them
+ *
+ * @param code  the program to compile
+ * @param start the instruction to begin matching at
+ * @return jit_t*
+ */
+jit_t *jit_compile(const re_code_t *code, int start);
+
+/**
+ * @brief frees the compiled code
+ *
+ * @param jit
+ */
+void jit_free(jit_t *jit);
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * @file nfa.h
+ * @author Anshul Kamath
+ * @brief A Thompson NFA (Pike VM) compiled from a list of `re_t`s. The
+ *        simulation advances every state in lockstep, so matching takes
+ *        O(pattern * text) time and never recurses
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef NFA_H
+#define NFA_H
+
+#include "regex-private.h"
+
+/**
+ * @brief instructions understood by the Pike VM
+ * --------
+ *      OP_CHAR     consumes the literal character `c`
+ *      OP_ANY      consumes any single character
+ *      OP_CLASS    consumes any character accepted by the class `cl`
+ *      OP_FAIL     never matches (a metacharacter out of place)
+ *      OP_BOL      asserts that we are at the beginning of the input
+ *      OP_EOL      asserts that we are at the end of the input
+ *      OP_SPLIT    continues at both `x` and `y`, preferring `x`
+ *      OP_JMP      continues at `x`
+ *      OP_SAVE     stores the position in capture slot `x` and continues
+ *      OP_MATCH    the pattern (numbered `x` in a union) has matched
+ */
+typedef enum op {
+    OP_CHAR, OP_ANY, OP_CLASS, OP_FAIL, OP_BOL, OP_EOL, OP_SPLIT, OP_JMP, OP_SAVE, OP_MATCH
+} op_t;
+
+/* the most instructions a program may have. Counted repetitions are
+   copied out, so a pattern can compile to far more than its length */
+#define NFA_MAX_LEN 10000
+
+/***********************************
+ *         NFA Structures          *
+ ***********************************/
+typedef struct inst {
+    op_t        op;         /* OP_CHAR, OP_SPLIT, etc. */
+    int         c;          /* the character for OP_CHAR */
+    const re_t *cl;         /* the character class for OP_CLASS */
+    int         x;          /* the (preferred) branch target, the slot of OP_SAVE
+                               or the token of OP_MATCH */
+    int         y;          /* the alternative branch target for OP_SPLIT */
+} inst_t;
+
+typedef struct prog {
+    inst_t *inst;           /* the instructions, starting at index 0 */
+    int     len;            /* the number of instructions */
+    int     anchored;       /* true if every alternative began with `^` */
+    int     nslots;         /* the number of capture slots, two per group */
+} prog_t;
+
+/**
+ * @brief a Pike VM that is fed the text a byte at a time, for searching a
+ *        stream. It keeps only its thread lists, and offsets rather than
+ *        pointers, so it uses the same memory however long the text is
+ */
+typedef struct nfa_stream nfa_stream_t;
+
+/**
+ * @brief the thread lists and stack a search runs in. Kept from one search
+ *        to the next, it saves allocating them every time
+ */
+typedef struct nfa_scratch nfa_scratch_t;
+
+/**
+ * @brief the state of a streaming search
+ * --------
+ *      NFA_SEARCHING   nothing has matched yet
+ *      NFA_PENDING     something matched, but a thread ahead of it may still
+ *                      find a better match
+ *      NFA_MATCHED     the match is final
+ *      NFA_FAILED      nothing can match anymore
+ */
+typedef enum nfa_status {
+    NFA_SEARCHING, NFA_PENDING, NFA_MATCHED, NFA_FAILED
+} nfa_status_t;
+
+/***********************************
+ *        Helper Functions         *
+ ***********************************/
+
+/* returns true if the consuming instruction `inst` accepts `ch` */
+static inline int nfa_accepts(const inst_t *inst, unsigned char ch) {
+    switch (inst->op) {
+        case OP_CHAR:
+            return inst->c == ch;
+        case OP_ANY:
+            return 1;
+        case OP_CLASS:
+            return inst->cl->nccl ^ get_ind(inst->cl->class.mask, ch);
+        default:
+            return 0;
+    }
+}
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief compiles a list of `re_t`s into a Pike VM program. Quantifiers
+ *        keep the priorities of the backtracking matcher: `*` and `+`
+ *        prefer the shortest repetition, while `?` prefers to consume.
+ *        Alternatives are compiled to a chain of splits that share a single
+ *        scan, with the first character of neighbouring alternatives
+ *        factored out where they agree. `{m,n}` copies what it repeats,
+ *        so returns NULL if the program would be longer than NFA_MAX_LEN
+ * NOTE:  the program refers to the classes in `reg`, which must outlive it.
+ *        Without an arena, it is on the heap and must be freed
+ * 
+ * @param reg   the compiled regexp, terminated by TERMINAL
+ * @param arena the arena to allocate from (or NULL)
+ * @return prog_t* 
+ */
+prog_t *nfa_compile(const re_t *reg, arena_t *arena);
+
+/**
+ * @brief combines `n` programs into a single anchored program that tries
+ *        each of them at the start of the input. The OP_MATCH of the `i`th
+ *        program reports token `i`. A leading `^` is implied, so it is
+ *        dropped from every program
+ * NOTE:  the union refers to the same classes as the programs it was built
+ *        from, but the programs themselves may be freed
+ * 
+ * @param progs the programs to combine, in priority order
+ * @param n     the number of programs (at least one)
+ * @param arena the arena to allocate from (or NULL)
+ * @return prog_t* 
+ */
+prog_t *nfa_union(prog_t *const *progs, size_t n, arena_t *arena);
+
+/**
+ * @brief frees the memory allocated by `nfa_compile` without an arena
+ * 
+ * @param prog 
+ */
+void nfa_free(prog_t *prog);
+
+/**
+ * @brief creates empty scratch space, which the first search run in it
+ *        sizes for its program
+ * NOTE:  only one search may run in the scratch space at a time, and only
+ *        for the program it was sized for. It must be freed with
+ *        `nfa_scratch_free`
+ * @return nfa_scratch_t* 
+ */
+nfa_scratch_t *nfa_scratch_new(void);
+
+/**
+ * @brief frees the memory of `nfa_scratch_new` and every search run in it
+ * @param scratch the scratch space (may be NULL)
+ */
+void nfa_scratch_free(nfa_scratch_t *scratch);
+
+/**
+ * @brief finds the leftmost match of `prog` in [text, end), storing where
+ *        it begins in `start`. Returns a pointer past the end of the match
+ *        or NULL if there is no match
+ * 
+ * @param prog    the program to run
+ * @param scratch the scratch space to run in (or NULL to allocate some)
+ * @param text    the beginning of the text to search
+ * @param end     the end of the text to search
+ * @param bol     true if `text` is the beginning of the input (where `^` matches)
+ * @param start   set to the beginning of the match
+ * @return const char* 
+ */
+const char *nfa_search(const prog_t *prog, nfa_scratch_t *scratch, const char *text, const char *end, int bol,
+                       const char **start);
+
+/**
+ * @brief same as `nfa_search`, but also stores where each group of the
+ *        match began and ended in slots `2 * i` and `2 * i + 1` of `caps`
+ *        (NULL if the group did not take part). A group inside a loop keeps
+ *        its last iteration. The slots are carried by each thread, so this
+ *        is still a single pass over the text
+ * 
+ * @param prog    the program to run
+ * @param scratch the scratch space to run in (or NULL to allocate some)
+ * @param text    the beginning of the text to search
+ * @param end     the end of the text to search
+ * @param bol     true if `text` is the beginning of the input (where `^` matches)
+ * @param start   set to the beginning of the match
+ * @param caps    set to the capture slots (`prog->nslots` of them)
+ * @return const char* 
+ */
+const char *nfa_captures(const prog_t *prog, nfa_scratch_t *scratch, const char *text, const char *end, int bol,
+                         const char **start, const char **caps);
+
+/**
+ * @brief returns true if and only if `prog` matches somewhere in
+ *        [text, end). Faster than `nfa_search` since it stops at the
+ *        first match found
+ * 
+ * @param prog    the program to run
+ * @param scratch the scratch space to run in (or NULL to allocate some)
+ * @param text    the beginning of the text to search
+ * @param end     the end of the text to search
+ * @param bol     true if `text` is the beginning of the input (where `^` matches)
+ * @return int 
+ */
+int nfa_is_match(const prog_t *prog, nfa_scratch_t *scratch, const char *text, const char *end, int bol);
+
+/**
+ * @brief finds the longest match of the (anchored) program at the beginning
+ *        of [text, end), like `dfa_longest`: the lowest token wins a tie,
+ *        and `text` is taken to be the beginning of the input. Returns the
+ *        length of the match, or -1 if there is none. Slower than the DFA,
+ *        but it only reads the program, so threads may share it
+ * @param prog  the program to run
+ * @param text  the beginning of the text to match
+ * @param end   the end of the text to match
+ * @param token set to the token of the match
+ * @return long 
+ */
+long nfa_longest(const prog_t *prog, const char *text, const char *end, int *token);
+
+/**
+ * @brief creates a streaming search with room for every thread of `prog`
+ * NOTE:  this pointer must be freed with `nfa_stream_free`
+ * 
+ * @param prog the program to run (which must outlive the search)
+ * @return nfa_stream_t* 
+ */
+nfa_stream_t *nfa_stream_new(const prog_t *prog);
+
+/**
+ * @brief begins a new search at absolute offset `offset` of the stream,
+ *        forgetting the last one. An empty match may already be final.
+ *        `^` only matches at offset 0
+ * 
+ * @param vm     the streaming search
+ * @param offset the offset of the next byte
+ * @return nfa_status_t 
+ */
+nfa_status_t nfa_stream_start(nfa_stream_t *vm, size_t offset);
+
+/**
+ * @brief advances the search over the next byte of the stream. Must not be
+ *        called once the search has matched or failed
+ * 
+ * @param vm the streaming search
+ * @param ch the next byte
+ * @return nfa_status_t 
+ */
+nfa_status_t nfa_stream_step(nfa_stream_t *vm, unsigned char ch);
+
+/**
+ * @brief ends the search at the end of the stream (where `$` matches).
+ *        Returns either NFA_MATCHED or NFA_FAILED
+ * 
+ * @param vm the streaming search
+ * @return nfa_status_t 
+ */
+nfa_status_t nfa_stream_end(nfa_stream_t *vm);
+
+/**
+ * @brief stores the offsets the best match so far begins and ends at in
+ *        `start` and `end`. Returns false if there is none
+ * 
+ * @param vm    the streaming search
+ * @param start set to the offset of the match
+ * @param end   set to the offset past its end
+ * @return int 
+ */
+int nfa_stream_match(const nfa_stream_t *vm, size_t *start, size_t *end);
+
+/**
+ * @brief frees the memory allocated by `nfa_stream_new`
+ * 
+ * @param vm the streaming search (may be NULL)
+ */
+void nfa_stream_free(nfa_stream_t *vm);
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * @file optimize.h
+ * @author Anshul Kamath
+ * @brief A pass between parsing and matching that simplifies a compiled
+ *        pattern without changing what any engine matches
+ * @version 0.1
+ * @date 2022-05-03
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "regex-private.h"
+
+#include <stddef.h>
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief simplifies the compiled regexp in place:
+ * --------
+ *      [x]     a class of a single character becomes that CHAR
+ *      a*a*    adjacent repetitions of the same atom are merged into one
+ *              (`a+a*` and `a*a+` into `a+`)
+ *
+ * @param reg the compiled regexp, terminated by TERMINAL
+ */
+void re_optimize(re_t *reg);
+
+/**
+ * @brief returns the length of the pattern if it is nothing but literal
+ *        characters (so its matches are the occurrences of the literal),
+ *        and 0 otherwise
+ *
+ * @param reg the compiled regexp, terminated by TERMINAL
+ * @return size_t
+ */
+size_t re_literal_len(const re_t *reg);
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file prefilter.h
+ * @author Anshul Kamath
+ * @brief A prefilter built from a literal that every match must contain,
+ *        used to skip straight to the positions where a match could begin
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include "regex-private.h"
+
+#include <stddef.h>
+
+/* literals at least this long are searched for with Boyer-Moore-Horspool */
+#define PREFILTER_BMH_MIN 4
+
+/***********************************
+ *       Prefilter Structure       *
+ ***********************************/
+typedef struct prefilter {
+    char   *lit;            /* the literal every match contains */
+    size_t  len;            /* the length of the literal */
+    long    offset;         /* where the literal begins in every match, or -1 if it varies */
+    size_t *skip;           /* the Boyer-Moore-Horspool shift table (long literals only) */
+} prefilter_t;
+
+/***********************************
+ *            Functions            *
+ ***********************************/
+
+/**
+ * @brief extracts the longest run of literal characters that every match
+ *        of `reg` must contain, preferring the earliest run on ties.
+ *        Returns NULL if the pattern has no such literal
+ * NOTE:  without an arena, this function allocates memory on the heap: must free
+ * 
+ * @param reg   the compiled regexp, terminated by TERMINAL
+ * @param arena the arena to allocate from (or NULL)
+ * @return prefilter_t* 
+ */
+prefilter_t *prefilter_compile(const re_t *reg, arena_t *arena);
+
+/**
+ * @brief frees the memory allocated by `prefilter_compile` without an arena
+ * 
+ * @param pf 
+ */
+void prefilter_free(prefilter_t *pf);
+
+/**
+ * @brief returns the first occurrence of the literal in [text, end),
+ *        or NULL if there is none
+ * 
+ * @param pf    the prefilter to search with
+ * @param text  the beginning of the text to search
+ * @param end   the end of the text to search
+ * @return const char* 
+ */
+const char *prefilter_find(const prefilter_t *pf, const char *text, const char *end);
+
+/**
+ * @brief returns the first position in [text, end) at which a match could
+ *        begin, or NULL if there can be no match at all. Anchored patterns
+ *        can only begin at `text`
+ * 
+ * @param pf        the prefilter to search with
+ * @param text      the beginning of the text to search
+ * @param end       the end of the text to search
+ * @param anchored  true if the pattern began with `^`
+ * @return const char* 
+ */
+const char *prefilter_start(const prefilter_t *pf, const char *text, const char *end, int anchored);
+
+#endif
@@ -12,6 +12,11 @@
 #ifndef REGEX_PRIV_H
 #define REGEX_PRIV_H
 
+#include <pthread.h>
+#include <stddef.h>
+#include "arena.h"
+#include "regex.h"
+
 /**
  * @brief character classes given by the following list:
  * --------
@@ -22,15 +27,27 @@
  *      *   STAR        matches zero or more occurrences of the previous character
  *      +   PLUS        matches one or more occurrences of the previous character
  *      ?   OPTIONAL    matches the previous character zero or once
+ *    {m,n} REPEAT      matches the previous character (or group) between
+ *                      `class.rep.min` and `class.rep.max` times
  *    [abc] CHAR_CLASS  matches any character inside the class
  *    [^..] NEG_CLASS   matches any character not inside the class
+ *      (   BEGIN_GROUP starts capture group number `class.c`
+ *      )   END_GROUP   ends capture group number `class.c`
+ *      |   ALTERNATE   separates the alternatives of a group (or the pattern)
+ *          STRING      matches a run of literal characters (only in the
+ *                      compact program, see `re_code_compile`)
  * 
  */
 typedef enum class { 
-    CHAR = 1, CHAR_CLASS, DOT = '.', STAR = '*', PLUS = '+', OPTIONAL = '?', BEGIN = '^', END = '$', TERMINAL = '\0',
-    BEGIN_CCL = '[', END_CCL = ']', RANGE = '-', ESCAPE = '\\'
+    CHAR = 1, CHAR_CLASS, STRING, DOT = '.', STAR = '*', PLUS = '+', OPTIONAL = '?', BEGIN = '^', END = '$', TERMINAL = '\0',
+    BEGIN_CCL = '[', END_CCL = ']', RANGE = '-', ESCAPE = '\\', BEGIN_GROUP = '(', END_GROUP = ')',
+    ALTERNATE = '|', REPEAT = '{'
 } class_t;
 
+/* the largest bound of a repetition, and the maximum of one without any */
+#define REPEAT_MAX 1000
+#define REPEAT_INF (-1)
+
 /**
  * @brief shortcuts for common regex shortcuts
  * --------
@@ -52,22 +69,128 @@ typedef struct re {
     union {
         int     c;          /* the character */
         long    mask[4];    /* set where 1 in `i`th bit means char in class */
-    } class;                /* union to the character or character class */
+        struct {
+            int min;        /* the fewest repetitions */
+            int max;        /* the most repetitions, or REPEAT_INF */
+        } rep;              /* the bounds of a REPEAT */
+    } class;                /* union to the character, character class or bounds */
     class_t type;           /* CHAR, STAR, etc. */
     int     nccl;           /* true if character class is negated */
+    const struct ccl *run;  /* scanner for a `*` or `+` run that must be consumed
+                               in full (see `ccl_annotate`), or NULL */
 } re_t;
 
+/***********************************
+ *        Compact Program          *
+ ***********************************/
+typedef struct re_inst {
+    unsigned char  type;    /* the type of the `re_t` it was lowered from */
+    short          c;       /* the fewest repetitions of a REPEAT, or 0 */
+    unsigned short cl;      /* the bytes it consumes, as an index into `classes`
+                               (where a STRING begins in `lits`) */
+    unsigned short run;     /* one more than the index of its run scanner, or 0
+                               (the most repetitions of a REPEAT, or USHRT_MAX;
+                               the length of a STRING) */
+} re_inst_t;
+
+typedef unsigned char re_class_t[32];   /* bit `ch` is set if `ch` is consumed */
+
+typedef struct re_code {
+    re_inst_t        *inst;     /* the instructions, terminated by TERMINAL */
+    re_class_t       *classes;  /* the distinct classes, where class 0 is empty */
+    int               nclasses; /* the number of classes */
+    const struct ccl *runs;     /* the scanners of the `re_t`s it was lowered from */
+    char             *lits;     /* the characters of every STRING */
+} re_code_t;
+
+/* what is left of the budget of a search (see `re_budget_t`) */
+typedef struct re_limit {
+    size_t          steps;      /* the tries of the program left, which is 0
+                                   once the budget is exceeded */
+    struct timespec deadline;   /* when the search gives up, or {0, 0} */
+    int             exceeded;   /* true once the steps or the time ran out */
+} re_limit_t;
+
+/* the state of one search of the backtracking matcher, which it only needs
+   to remember where it failed (see RE_MEMO), to keep to a budget or to
+   count its work (RE_STATS) */
+typedef struct re_exec {
+    unsigned char *visited; /* bit `(pos - text) * stride + i` is set once the
+                               program from instruction `i` was tried at `pos`
+                               (or, for a `*` or `+`, the loop repeating its
+                               atom went on from `pos`), or NULL */
+    const char    *text;    /* the beginning of the text searched */
+    size_t         stride;  /* the bits of each position (the pattern's `memo`) */
+    size_t         reach;   /* one past the furthest position with a bit set */
+    re_limit_t    *limit;   /* the budget it is on, or NULL */
+#ifdef RE_STATS
+    re_stats_t     stats;   /* the work done so far, added to the pattern's
+                               once the search is over */
+#endif
+} re_exec_t;
+
+/***********************************
+ *        Compiled Pattern         *
+ ***********************************/
+struct re_pattern {
+    re_t        *reg;       /* the compiled program, terminated by TERMINAL */
+    re_code_t   *code;      /* `reg` lowered for the backtracking matcher */
+    struct jit  *jit;       /* `code` compiled to native code (RE_JIT), or NULL */
+    struct prog *prog;      /* the Pike VM program (RE_NFA, RE_DFA, groups or `|`) */
+    struct dfa  *dfa;       /* the lazily built DFA of `prog` (or `vm_prog`) unless
+                               RE_NFA, or NULL */
+    pthread_mutex_t dfa_lock; /* taken by the thread running the DFA, if any */
+    struct nfa_scratch *scratch; /* where the Pike VM runs (with `prog`), or NULL */
+    pthread_mutex_t scratch_lock; /* taken by the thread running in `scratch`, if any */
+    struct prefilter *prefilter; /* a literal every match contains, or NULL */
+    struct ccl  *runs;      /* the scanners attached to the `re_t`s, or NULL */
+    struct ccl  *first;     /* the class every match begins with, or NULL */
+    int          flags;     /* the `re_flags_t` the pattern was compiled with */
+    int          ngroups;   /* the number of capture groups */
+    int          anchored;  /* true if every alternative begins with `^` */
+    size_t       literal;   /* the length of a pattern of only literal characters,
+                               whose matches the prefilter finds by itself, or 0 */
+    size_t       memo;      /* the number of instructions (with the terminator)
+                               whose failures are remembered (RE_MEMO), or 0 */
+    unsigned char *memo_bits; /* the memo searches reuse, kept clear between
+                               them (NULL until a search needs it) */
+    size_t       memo_cap;  /* the size of `memo_bits`, in bytes */
+    pthread_mutex_t memo_lock; /* taken by the thread searching with `memo_bits` */
+    struct prog *vm_prog;   /* the Pike VM program of a pattern without `prog`,
+                               which the DFA runs and which takes over a text
+                               too long to memoize, or NULL */
+#ifdef RE_STATS
+    re_stats_t   stats;     /* the work of every search so far, which threads
+                               add to atomically (but for the DFA's) */
+#endif
+    arena_t     *arena;     /* the arena everything above (but the DFA) lives in */
+    int          owns_arena; /* true if the arena is freed with the pattern */
+};
+
+/***********************************
+ *        Compiled Token Set       *
+ ***********************************/
+struct re_set {
+    arena_t     *arena;     /* the arena everything but the DFA lives in */
+    re_t       **regs;      /* the compiled program of each pattern */
+    int         *tokens;    /* the token reported for each pattern */
+    size_t       n;         /* the number of patterns */
+    struct prog *prog;      /* the union of every pattern's Pike VM program */
+    struct dfa  *dfa;       /* the lazily built DFA of the union */
+    pthread_mutex_t dfa_lock; /* taken by the thread running the DFA, if any */
+};
+
 /***********************************
  *        Helper Functions         *
  ***********************************/
 #define BITS_LONG (8 * sizeof(long))
 
 inline __attribute__ ((always_inline)) void set_ind(long arr[4], int i) {
-    arr[i / BITS_LONG] |= (1l << (i % BITS_LONG));
+    arr[i / BITS_LONG] |= (long) (1ul << (i % BITS_LONG));
 }
 
 inline __attribute__ ((always_inline)) int get_ind(const long arr[4], int i) {
-    return (arr[i / BITS_LONG] >> (i % BITS_LONG)) & 1;
+    return ((unsigned long) arr[i / BITS_LONG] >> (i % BITS_LONG)) & 1;
 }
 
 /***********************************
@@ -75,7 +198,8 @@ inline __attribute__ ((always_inline)) int get_ind(const long arr[4], int i) {
  ***********************************/
 
 /**
- * @brief returns a buffer with all the pattern's shortcuts expanded
+ * @brief returns a buffer with all the pattern's shortcuts expanded. The
+ *        compiler no longer needs this, since it compiles shortcuts in place
  * 
  * @param dest   
  * @param regexp  
@@ -83,6 +207,17 @@ inline __attribute__ ((always_inline)) int get_ind(const long arr[4], int i) {
  */
 char *re_precompile(const char *regexp);
 
+/**
+ * @brief same as `re_precompile`, but expands a pattern of the given length
+ *        (which may contain '\0's), storing the length of the result in `out_len`
+ * 
+ * @param regexp  the pattern to expand
+ * @param len     the length of the pattern
+ * @param out_len set to the length of the expanded pattern
+ * @return char* 
+ */
+char *re_precompile_n(const char *regexp, size_t len, size_t *out_len);
+
 /**
  * @brief compiles a regexp pattern into a list of `re_t`s
  * NOTE:  this function allocates memory on the heap: must free
@@ -92,6 +227,55 @@ char *re_precompile(const char *regexp);
  */
 re_t *re_compile(const char *regexp);
 
+/**
+ * @brief same as `re_compile`, but compiles a pattern of the given length,
+ *        in which a '\0' is an ordinary character, drawing its memory from
+ *        `arena`. Shortcuts are compiled to the classes they stand for
+ * NOTE:  without an arena, the result is on the heap: must free
+ * 
+ * @param regexp the pattern to compile
+ * @param len    the length of the pattern
+ * @param arena  the arena to allocate from (or NULL)
+ * @return re_t* 
+ */
+re_t *re_compile_n(const char *regexp, size_t len, arena_t *arena);
+
+/**
+ * @brief returns the END_GROUP that closes the group `open` begins. The
+ *        compiler only accepts patterns whose groups are balanced
+ * 
+ * @param open the BEGIN_GROUP of the group
+ * @return const re_t* 
+ */
+const re_t *re_group_end(const re_t *open);
+
+/**
+ * @brief returns the `|` that ends the alternative beginning at `reg`, or
+ *        the END_GROUP or TERMINAL that ends the last alternative. Groups
+ *        inside the alternative are skipped over
+ * 
+ * @param reg the first `re_t` of the alternative
+ * @return const re_t* 
+ */
+const re_t *re_alternative_end(const re_t *reg);
+
+/**
+ * @brief returns true if every alternative of the pattern begins with `^`.
+ *        Anywhere else, `^` is out of place and never matches
+ * 
+ * @param reg the compiled regexp, terminated by TERMINAL
+ * @return int 
+ */
+int re_anchored(const re_t *reg);
+
+/**
+ * @brief returns the number of capture groups in `reg`
+ * 
+ * @param reg the compiled regexp, terminated by TERMINAL
+ * @return int 
+ */
+int re_count_groups(const re_t *reg);
+
 /**
  * @brief frees the memory allocated by the given `re_t`
  * 
@@ -100,15 +284,56 @@ re_t *re_compile(const char *regexp);
 void re_free(re_t *reg);
 
 /**
- * @brief returns true if and only if `regexp` matches `text`
+ * @brief lowers a list of `re_t`s (and the scanners `ccl_annotate` attached
+ *        to them) into the compact program the backtracking matcher runs.
+ *        Each distinct set of bytes an instruction consumes is stored once,
+ *        so checking a character against any instruction is one lookup, and
+ *        a run of literal characters becomes a single STRING. Returns NULL
+ *        if there are more than 65536 distinct sets
+ * NOTE:  without an arena, the result is on the heap: must free
+ * 
+ * @param reg   the compiled regexp, terminated by TERMINAL
+ * @param runs  the scanners attached to `reg` (or NULL)
+ * @param arena the arena to allocate from (or NULL)
+ * @return re_code_t* 
+ */
+re_code_t *re_code_compile(const re_t *reg, const struct ccl *runs, arena_t *arena);
+
+/**
+ * @brief frees the memory allocated by `re_code_compile` without an arena
+ * 
+ * @param code 
+ */
+void re_code_free(re_code_t *code);
+
+/**
+ * @brief returns the end of the match if the program starting at `inst`
+ *        matches the beginning of [text, end), and NULL otherwise
  * NOTE:  this is a private function - use re_is_match instead
  * TODO:  move this to a separate file
  * 
- * @param reg the regexp to test against
+ * @param code   the program being run
+ * @param inst   the instruction to start from
  * @param text   the text to match
- * @return int 
+ * @param end    the end of the text
+ * @return char* 
+ */
+char *match_here(const re_code_t *code, const re_inst_t *inst, char *text, char *end);
+
+/**
+ * @brief same as match_here, but skips (and records) every instruction and
+ *        position in `exec` that was tried before, if it has a bitmap. Only
+ *        failures are ever tried again, since the first success is the match
+ * NOTE:  this is a private function - use re_is_match instead
+ * 
+ * @param code   the program being run
+ * @param inst   the instruction to start from
+ * @param text   the text to match
+ * @param end    the end of the text
+ * @param exec   the state of the search (or NULL to remember nothing)
+ * @return char* 
  */
-char *match_here(const re_t *reg, char *text);
+char *match_exec(const re_code_t *code, const re_inst_t *inst, char *text, char *end, re_exec_t *exec);
 
 /**
  * @brief same as match_here, but matches an arbitrary number of
@@ -116,11 +341,32 @@ char *match_here(const re_t *reg, char *text);
  * NOTE:  this is a private function - use re_is_match instead
  * TODO:  move this to a separate file
  * 
- * @param c     the regex class to match arbitrarily
- * @param reg   the pattern to match against
+ * @param code  the program being run
+ * @param c     the instruction to match arbitrarily
+ * @param inst  the rest of the program to match against
  * @param text  the text to match
- * @return int 
+ * @param end   the end of the text
+ * @param exec  the state of the search (or NULL)
+ * @return char* 
+ */
+char *match_kleene(const re_code_t *code, const re_inst_t *c, const re_inst_t *inst, char *text, char *end,
+                   re_exec_t *exec);
+
+/**
+ * @brief same as match_kleene, but matches at most `max` character `c`s
+ *        (any number if `max` is negative), counting them as it goes
+ * NOTE:  this is a private function - use re_is_match instead
+ * 
+ * @param code  the program being run
+ * @param c     the instruction to match up to `max` times
+ * @param inst  the rest of the program to match against
+ * @param text  the text to match
+ * @param end   the end of the text
+ * @param max   the most `c`s to match
+ * @param exec  the state of the search (or NULL)
+ * @return char* 
  */
-char *match_kleene(const re_t *c, const re_t *reg, char *text);
+char *match_repeat(const re_code_t *code, const re_inst_t *c, const re_inst_t *inst, char *text, char *end, int max,
+                   re_exec_t *exec);
 
 #endif
@@ -12,19 +12,198 @@
 #ifndef REGEX_H
 #define REGEX_H
 
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * @brief an opaque, compiled regex pattern. Compile a pattern once with
+ *        `re_pattern_compile` and reuse it for as many matches as needed.
+ *        Matching never changes a pattern (but for its DFA's state cache,
+ *        which one thread at a time takes over), so any number of threads
+ *        may match with one at once. Only configuring and freeing it must
+ *        not race with matching
+ */
+typedef struct re_pattern re_pattern_t;
+
+/**
+ * @brief an opaque set of token patterns compiled into a single automaton,
+ *        which finds the longest match of any of them in one pass
+ */
+typedef struct re_set re_set_t;
+
+/**
+ * @brief an opaque bump allocator that patterns can be compiled into with
+ *        `re_pattern_compile_arena`, so that all of them are freed at once
+ */
+typedef struct re_arena re_arena_t;
+
+/**
+ * @brief the location of a match inside the string that was searched
+ */
+typedef struct re_span {
+    size_t start;           /* the offset of the first character of the match */
+    size_t len;             /* the length of the match (which may be zero) */
+} re_span_t;
+
+/* the start of the span of a group that took no part in the match */
+#define RE_NO_GROUP ((size_t) -1)
+
+/**
+ * @brief one of the strings matched by `re_pattern_match_batch`
+ */
+typedef struct re_subject {
+    const char *string;     /* the characters of the subject */
+    size_t      len;        /* the number of characters (which may include '\0's) */
+} re_subject_t;
+
+/**
+ * @brief an iterator over the successive, non-overlapping matches of a
+ *        compiled pattern in a string. Set it up with `re_iter_init` and
+ *        read its fields through the spans `re_iter_next` returns only
+ */
+typedef struct re_iter {
+    const re_pattern_t *pattern;    /* the pattern being matched */
+    const char         *string;     /* the string being searched */
+    size_t              len;        /* the length of the string */
+    size_t              pos;        /* where the next search begins */
+    int                 done;       /* true once every match was returned */
+} re_iter_t;
+
+/**
+ * @brief the most work a single search may do before it gives up (see
+ *        `re_pattern_match_budget`). A step is one try of the backtracking
+ *        matcher's program, at a start or after a repetition, which costs at
+ *        most one pass over the pattern. The deadline is an absolute time on
+ *        CLOCK_MONOTONIC, which is only read every RE_CLOCK_STEPS steps
+ */
+typedef struct re_budget {
+    size_t          steps;      /* the most steps, or 0 for no limit */
+    struct timespec deadline;   /* when to give up, or {0, 0} for never */
+} re_budget_t;
+
+/* the number of steps between readings of the clock */
+#define RE_CLOCK_STEPS 4096
+
+/* what a search on a budget returns if it ran out before it knew the answer */
+#define RE_BUDGET_EXCEEDED (-1)
+
+/* what a stream returns once it could not keep a byte it needed (see
+   `re_stream_set_limit`) */
+#define RE_STREAM_ERROR ((size_t) -1)
+
+/**
+ * @brief an opaque search over a text that arrives in chunks, which reports
+ *        each match (by its offset in the whole stream) to a callback. See
+ *        `re_stream_new`
+ */
+typedef struct re_stream re_stream_t;
+
+/* called with each match a stream finds, and the data it was created with */
+typedef void (*re_stream_fn)(re_span_t span, void *data);
+
+/**
+ * @brief the work the searches of a pattern did, counted only if the library
+ *        was built with RE_STATS defined (`make STATS=1`). Without it, the
+ *        matchers count nothing and pay nothing for it
+ */
+typedef struct re_stats {
+    size_t searches;        /* texts searched */
+    size_t bytes;           /* bytes of the texts searched */
+    size_t skipped;         /* positions the prefilter (or a leading class)
+                               ruled out without trying a match there */
+    size_t starts;          /* positions the backtracking matcher tried a match at */
+    size_t insts;           /* instructions it interpreted (not run natively) */
+    size_t backtracks;      /* times the rest of the pattern failed after a
+                               repetition, which then took one more if it could */
+    size_t memo_hits;       /* tries the memo ruled out (see RE_MEMO) */
+    size_t dfa_bytes;       /* bytes the DFA stepped over */
+    size_t dfa_hits;        /* steps it found in its state cache */
+    size_t dfa_misses;      /* steps it had to work out (and cache) */
+    size_t dfa_flushes;     /* times its state cache was emptied to stay in budget */
+} re_stats_t;
+
+/**
+ * @brief the counters of the cache of compiled patterns that `re_is_match`
+ *        and `re_get_match` share
+ */
+typedef struct re_cache_stats {
+    size_t hits;            /* lookups that found their pattern compiled */
+    size_t misses;          /* lookups that had to compile their pattern */
+    size_t evictions;       /* patterns dropped to make room for others */
+    size_t size;            /* the number of patterns cached */
+    size_t capacity;        /* the most patterns the cache holds */
+} re_cache_stats_t;
+
+/**
+ * @brief flags that select how a compiled pattern is matched
+ * --------
+ *      RE_BACKTRACK    the default, recursive backtracking matcher. Patterns
+ *                      with groups or `|` run on the Pike VM instead, with
+ *                      a DFA to rule out texts without a match. The DFA
+ *                      also answers whether there is a match at all (as in
+ *                      `re_is_match`), in one lookup per byte, unless the
+ *                      matcher never backtracks and only tries a match at
+ *                      the start or a literal, which is as fast. Every
+ *                      engine finds the same match, so a group never
+ *                      changes it
+ *      RE_NFA          a Thompson NFA (Pike VM) simulation, which runs in
+ *                      O(pattern * text) time without recursing. It copies
+ *                      out `{m,n}`, so where that makes its program too
+ *                      large the backtracking matcher is used instead (or,
+ *                      with groups or `|`, the pattern is rejected)
+ *      RE_DFA          a lazily built DFA, which costs one table lookup per
+ *                      byte (matches are located with the Pike VM). One
+ *                      thread runs it at a time, while others sharing the
+ *                      pattern fall back to the Pike VM
+ *      RE_NO_PREFILTER disables skipping ahead to a literal that every match
+ *                      contains (for benchmarking and debugging)
+ *      RE_JIT          compiles the backtracking matcher's program to native
+ *                      code, for patterns that are matched many times. On
+ *                      anything but x86-64 the program is interpreted as usual
+ *      RE_MEMO         has the backtracking matcher remember where the rest
+ *                      of the pattern failed, so it never tries it there
+ *                      again. Matches are the same, but found in
+ *                      O(pattern * text) time, at the cost of a bit per
+ *                      instruction and byte, which the pattern keeps for
+ *                      its next search. A text needing more than 8 MB of
+ *                      them is searched by the Pike VM instead. Patterns
+ *                      with more than one repetition that backtracks use
+ *                      it anyway, and are interpreted even with RE_JIT
+ */
+typedef enum re_flags {
+    RE_BACKTRACK = 0, RE_NFA = 1 << 0, RE_DFA = 1 << 1, RE_NO_PREFILTER = 1 << 2, RE_JIT = 1 << 3,
+    RE_MEMO = 1 << 4
+} re_flags_t;
+
 /**
  * @brief returns true if and only if the given pattern matches
  *        the given string. Support for the following constructs:
  * --------
  *      c   CHAR        matches any literal character `c`
  *      .   DOT         matches any single character
- *      ^   BEGIN       matches the beginning of the input string
+ *      ^   BEGIN       matches the beginning of the input string (anywhere
+ *                      in the pattern, though past a character it never can)
  *      $   END         matches the end of the input string
  *      *   STAR        matches zero or more occurrences of the previous character
  *      +   PLUS        matches one or more occurrences of the previous character
  *      ?   OPTIONAL    matches the previous character zero or once
+ *    {m,n} REPEAT      matches the previous character (or group) between `m`
+ *                      and `n` times, preferring fewer like `*`. `{m}` is
+ *                      exactly `m` times and `{m,}` at least `m`. The bounds
+ *                      go up to 1000, and a brace without them is literal
  *    [abc] CHAR_CLASS  matches any character inside the class
  *    [^..] NEG_CLASS   matches any character not inside the class
+ *    (...) GROUP       matches what is inside, which may be quantified as a
+ *                      whole and whose span is captured (see
+ *                      `re_pattern_captures`). `\(` and `\)` are literal
+ *    a|b   ALTERNATE   matches either side, preferring the left one. It
+ *                      splits the group it is in (or the whole pattern),
+ *                      and a `^` only anchors the alternative it is in, so
+ *                      `^a|b` finds "a" at the beginning or "b" anywhere.
+ *                      `\|` is literal
+ * 
+ * Each distinct pattern is compiled once and kept in a cache shared by
+ * every thread (see `re_cache_set_capacity`)
  * 
  * @param pattern   a pointer to the pattern to check
  * @param string    a pointer to the string to match
@@ -34,7 +213,8 @@ int re_is_match(char *pattern, char *string);
 
 /**
  * @brief returns a string of the first match found with the given `pattern`
- *        or NULL if no such match is found.
+ *        or NULL if no such match is found. Like `re_is_match`, it compiles
+ *        the pattern through the cache
  * NOTE:  this pointer must be freed
  * 
  * @param pattern a pointer to the pattern to check
@@ -43,4 +223,436 @@ int re_is_match(char *pattern, char *string);
  */
 char *re_get_match(char *pattern, char *string);
 
+/**
+ * @brief compiles the given pattern (see `re_is_match` for the supported
+ *        constructs) into a reusable pattern, or NULL if it is malformed
+ * NOTE:  the returned pattern must be freed with `re_pattern_free`
+ * 
+ * @param pattern a pointer to the pattern to compile
+ * @return re_pattern_t* 
+ */
+re_pattern_t *re_pattern_compile(const char *pattern);
+
+/**
+ * @brief same as `re_pattern_compile`, but selects the matching engine
+ *        (and other options) with a bitwise or of `re_flags_t`s
+ * NOTE:  the returned pattern must be freed with `re_pattern_free`
+ * 
+ * @param pattern a pointer to the pattern to compile
+ * @param flags   a bitwise or of `re_flags_t`s
+ * @return re_pattern_t* 
+ */
+re_pattern_t *re_pattern_compile_flags(const char *pattern, int flags);
+
+/**
+ * @brief same as `re_pattern_compile_flags`, but compiles a pattern of the
+ *        given length, which need not be null-terminated. A '\0' in the
+ *        pattern is an ordinary character
+ * NOTE:  the returned pattern must be freed with `re_pattern_free`
+ * 
+ * @param pattern a pointer to the pattern to compile
+ * @param len     the length of the pattern
+ * @param flags   a bitwise or of `re_flags_t`s
+ * @return re_pattern_t* 
+ */
+re_pattern_t *re_pattern_compile_n(const char *pattern, size_t len, int flags);
+
+/**
+ * @brief same as `re_pattern_compile_n`, but draws the pattern's memory from
+ *        the given arena, which saves an allocation (and a free) per part of
+ *        the pattern when many patterns are compiled together. A malformed
+ *        pattern may still use up some of the arena
+ * NOTE:  the memory is released by `re_arena_free`, but a pattern with a
+ *        DFA (see `re_flags_t`) must still be freed with `re_pattern_free`
+ *        first, which releases its state cache. An arena must not be shared
+ *        between threads
+ * 
+ * @param pattern a pointer to the pattern to compile
+ * @param len     the length of the pattern
+ * @param flags   a bitwise or of `re_flags_t`s
+ * @param arena   the arena to allocate from
+ * @return re_pattern_t* 
+ */
+re_pattern_t *re_pattern_compile_arena(const char *pattern, size_t len, int flags, re_arena_t *arena);
+
+/**
+ * @brief returns true if and only if the compiled pattern matches
+ *        the given string
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to match
+ * @return int 
+ */
+int re_pattern_match(const re_pattern_t *pattern, const char *string);
+
+/**
+ * @brief same as `re_pattern_match`, but matches the first `len` characters
+ *        of `string`, which need not be null-terminated. A '\0' in the
+ *        string is an ordinary character and `$` matches at the end of
+ *        the slice
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to match
+ * @param len     the length of the string
+ * @return int 
+ */
+int re_pattern_match_n(const re_pattern_t *pattern, const char *string, size_t len);
+
+/**
+ * @brief returns a string of the first match of the compiled pattern
+ *        or NULL if no such match is found. Use `re_pattern_span` to
+ *        find a match without copying it
+ * NOTE:  this pointer must be freed
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to match
+ * @return char* 
+ */
+char *re_pattern_find(const re_pattern_t *pattern, const char *string);
+
+/**
+ * @brief finds the first match of the compiled pattern without allocating,
+ *        storing where it lies in the given string in `span`. Returns true
+ *        if and only if there is a match
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to match
+ * @param span    set to the location of the match
+ * @return int 
+ */
+int re_pattern_span(const re_pattern_t *pattern, const char *string, re_span_t *span);
+
+/**
+ * @brief same as `re_pattern_span`, but searches the first `len` characters
+ *        of `string` (see `re_pattern_match_n`)
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to match
+ * @param len     the length of the string
+ * @param span    set to the location of the match
+ * @return int 
+ */
+int re_pattern_span_n(const re_pattern_t *pattern, const char *string, size_t len, re_span_t *span);
+
+/**
+ * @brief same as `re_pattern_match_n`, but gives up once the search has
+ *        taken more steps than the budget allows, or its deadline has
+ *        passed, and returns RE_BUDGET_EXCEEDED. The backtracking matcher
+ *        is interpreted to count its steps, even if compiled with RE_JIT.
+ *        Patterns on the Pike VM or the DFA (with groups or `|`, or RE_NFA
+ *        or RE_DFA) take time linear in the text anyway, and are not limited
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to check
+ * @param len     the length of the string
+ * @param budget  the most work the search may do
+ * @return int 
+ */
+int re_pattern_match_budget(const re_pattern_t *pattern, const char *string, size_t len, const re_budget_t *budget);
+
+/**
+ * @brief same as `re_pattern_span_n`, on a budget (see
+ *        `re_pattern_match_budget`). Returns RE_BUDGET_EXCEEDED, leaving
+ *        `span` alone, if it ran out
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to check
+ * @param len     the length of the string
+ * @param span    set to the location of the match
+ * @param budget  the most work the search may do
+ * @return int 
+ */
+int re_pattern_span_budget(const re_pattern_t *pattern, const char *string, size_t len, re_span_t *span,
+                           const re_budget_t *budget);
+
+/**
+ * @brief returns the number of capture groups of the compiled pattern
+ * 
+ * @param pattern the compiled pattern
+ * @return size_t 
+ */
+size_t re_pattern_groups(const re_pattern_t *pattern);
+
+/**
+ * @brief returns true if the compiled pattern has a `^` or `$` anywhere
+ *        (in any group or alternative), so that where the input begins or
+ *        ends can change what it matches. An escaped `\$` is literal
+ * 
+ * @param pattern the compiled pattern
+ * @return int 
+ */
+int re_pattern_has_anchor(const re_pattern_t *pattern);
+
+/**
+ * @brief finds the first match of the compiled pattern in the first `len`
+ *        characters of `string`, storing the span of the match in `spans[0]`
+ *        and the span of group `i` (numbered from 1 by its opening bracket)
+ *        in `spans[i]`, for as many of the `nspans` spans as there are. A
+ *        group that took no part in the match (or does not exist) starts at
+ *        RE_NO_GROUP, and one inside a loop has the span of its last
+ *        iteration. The groups are captured by the Pike VM in the same pass
+ *        that finds the match. Returns true if and only if there is a match
+ * NOTE:  the spans refer to `string`, so nothing is copied
+ * 
+ * @param pattern the compiled pattern to check
+ * @param string  a pointer to the string to match
+ * @param len     the length of the string
+ * @param spans   set to the spans of the match and of its groups
+ * @param nspans  the number of spans to set
+ * @return int 
+ */
+int re_pattern_captures(const re_pattern_t *pattern, const char *string, size_t len,
+                        re_span_t *spans, size_t nspans);
+
+/**
+ * @brief matches the pattern against each of the `n` subjects, spread over
+ *        `nthreads` threads (or one per processor if it is 0). Each thread
+ *        works through its own share of the subjects, and takes half of
+ *        another's when it runs out. If `matched` is given, bit `i % 8` of
+ *        `matched[i / 8]` is set if and only if subject `i` matches (and the
+ *        bits past the last subject are left alone). If `spans` is given,
+ *        `spans[i]` is set to the leftmost match in subject `i`, which
+ *        starts at RE_NO_GROUP if there is none. Returns the number of
+ *        subjects that matched
+ * NOTE:  the calling thread is one of the threads, and returns once every
+ *        subject has been matched
+ * 
+ * @param pattern  the compiled pattern to check
+ * @param subjects the strings to match
+ * @param n        the number of subjects
+ * @param matched  set to a bit per subject (or NULL)
+ * @param spans    set to a span per subject (or NULL)
+ * @param nthreads the number of threads to match with (or 0)
+ * @return size_t 
+ */
+size_t re_pattern_match_batch(const re_pattern_t *pattern, const re_subject_t *subjects, size_t n,
+                              unsigned char *matched, re_span_t *spans, int nthreads);
+
+/**
+ * @brief copies the characters of `string` covered by `span` into a new,
+ *        NUL-terminated string
+ * NOTE:  this pointer must be freed
+ * 
+ * @param string the string the span was found in
+ * @param span   the span to copy
+ * @return char* 
+ */
+char *re_span_dup(const char *string, re_span_t span);
+
+/**
+ * @brief sets up `iter` to return every match of the compiled pattern in
+ *        the given string, from left to right
+ * NOTE:  nothing is allocated, but the pattern and string must outlive
+ *        the iterator
+ * 
+ * @param iter    the iterator to set up
+ * @param pattern the compiled pattern to match
+ * @param string  a pointer to the string to search
+ */
+void re_iter_init(re_iter_t *iter, const re_pattern_t *pattern, const char *string);
+
+/**
+ * @brief same as `re_iter_init`, but iterates over the first `len`
+ *        characters of `string` (see `re_pattern_match_n`)
+ * 
+ * @param iter    the iterator to set up
+ * @param pattern the compiled pattern to match
+ * @param string  a pointer to the string to search
+ * @param len     the length of the string
+ */
+void re_iter_init_n(re_iter_t *iter, const re_pattern_t *pattern, const char *string, size_t len);
+
+/**
+ * @brief finds the next match after the previous one, storing where it lies
+ *        in the string in `span`. A search after an empty match begins one
+ *        character later, and `^` only matches at the start of the string
+ *        (not where each search begins). Returns false once there are no more
+ * 
+ * @param iter the iterator to advance
+ * @param span set to the location of the match
+ * @return int 
+ */
+int re_iter_next(re_iter_t *iter, re_span_t *span);
+
+/**
+ * @brief creates a search for the successive, non-overlapping matches of
+ *        the pattern in a stream, which is fed to it with `re_stream_feed`
+ *        and ended with `re_stream_finish`. The matches are those
+ *        `re_iter_next` finds with RE_NFA, and each is passed to `on_match`
+ *        as soon as it is certain, by its offsets in the whole stream. The
+ *        Pike VM runs over each byte once: while a match may still grow, a
+ *        second one searches on from its end. Bytes are only kept when that
+ *        search finds a match too before the first is final, which may
+ *        need them searched again, and then only up to the stream's limit
+ *        (see `re_stream_set_limit`). Returns NULL if the pattern is too
+ *        large for the Pike VM
+ * NOTE:  this pointer must be freed with `re_stream_free`, and the pattern
+ *        must outlive it
+ * 
+ * @param pattern  the compiled pattern to match
+ * @param on_match called with the span of each match
+ * @param data     passed to `on_match`
+ * @return re_stream_t* 
+ */
+re_stream_t *re_stream_new(const re_pattern_t *pattern, re_stream_fn on_match, void *data);
+
+/**
+ * @brief sets the most bytes the stream keeps to search again (16 MB by
+ *        default). A stream that would need more stops searching, and
+ *        `re_stream_feed` and `re_stream_finish` return RE_STREAM_ERROR
+ *        until it is finished. `a(.*z)?` fed "a" and then "xa" over and
+ *        over needs every byte after the second "a" until a "z" comes
+ * 
+ * @param stream the stream to limit
+ * @param limit  the most bytes to keep
+ */
+void re_stream_set_limit(re_stream_t *stream, size_t limit);
+
+/**
+ * @brief searches the next `len` bytes of the stream (which may include
+ *        '\0's). The chunk is not kept, and the matches it completes are
+ *        reported before this returns. Returns the number reported, or
+ *        RE_STREAM_ERROR if the stream ran out of room to keep a byte it
+ *        needed (or already had), after which it reports nothing more
+ * 
+ * @param stream the stream to feed
+ * @param chunk  the next bytes of the stream
+ * @param len    the number of bytes
+ * @return size_t 
+ */
+size_t re_stream_feed(re_stream_t *stream, const char *chunk, size_t len);
+
+/**
+ * @brief ends the stream, reporting the matches that were waiting on more
+ *        of it (or on `$`). The stream then starts over, at offset 0.
+ *        Returns the number of matches reported, or RE_STREAM_ERROR if the
+ *        stream ran out of room (see `re_stream_feed`)
+ * 
+ * @param stream the stream to end
+ * @return size_t 
+ */
+size_t re_stream_finish(re_stream_t *stream);
+
+/**
+ * @brief frees the memory allocated by `re_stream_new`
+ * 
+ * @param stream the stream to free (may be NULL)
+ */
+void re_stream_free(re_stream_t *stream);
+
+/**
+ * @brief sets the memory budget of a pattern's DFA state cache, which
+ *        is flushed whenever it would grow larger (1 MiB by default)
+ * 
+ * @param pattern the compiled pattern to configure
+ * @param bytes   the memory budget, in bytes
+ */
+void re_pattern_set_dfa_budget(re_pattern_t *pattern, size_t bytes);
+
+/**
+ * @brief stores the work the pattern's searches did so far in `stats`.
+ *        Returns false, with every counter 0, if the library was built
+ *        without RE_STATS
+ * 
+ * @param pattern the compiled pattern to read
+ * @param stats   set to the counters
+ * @return int 
+ */
+int re_pattern_get_stats(const re_pattern_t *pattern, re_stats_t *stats);
+
+/**
+ * @brief sets every counter of the pattern back to 0
+ * 
+ * @param pattern the compiled pattern to reset
+ */
+void re_pattern_reset_stats(re_pattern_t *pattern);
+
+/**
+ * @brief frees the memory allocated by `re_pattern_compile`. A pattern
+ *        compiled into a caller's arena only releases its DFA's state cache,
+ *        and leaves the rest to `re_arena_free`
+ * 
+ * @param pattern the compiled pattern to free (may be NULL)
+ */
+void re_pattern_free(re_pattern_t *pattern);
+
+/**
+ * @brief creates an empty arena to compile patterns into, which allocates
+ *        blocks of at least `block_size` bytes (or 64 KiB if it is 0)
+ * NOTE:  the returned arena must be freed with `re_arena_free`
+ * 
+ * @param block_size the minimum size of each block
+ * @return re_arena_t* 
+ */
+re_arena_t *re_arena_new(size_t block_size);
+
+/**
+ * @brief frees the arena along with every pattern compiled into it, all of
+ *        which must not be used afterwards
+ * 
+ * @param arena the arena to free (may be NULL)
+ */
+void re_arena_free(re_arena_t *arena);
+
+/**
+ * @brief sets the number of patterns the cache of `re_is_match` and
+ *        `re_get_match` holds (64 by default), evicting the least recently
+ *        used ones if there are more. A capacity of 0 disables the cache,
+ *        so every call compiles its pattern again
+ * 
+ * @param capacity the most patterns to keep compiled
+ */
+void re_cache_set_capacity(size_t capacity);
+
+/**
+ * @brief stores the cache's counters in `stats`
+ * 
+ * @param stats set to the counters
+ */
+void re_cache_get_stats(re_cache_stats_t *stats);
+
+/**
+ * @brief empties the cache and resets its counters. The capacity is kept
+ * 
+ */
+void re_cache_clear(void);
+
+/**
+ * @brief compiles an ordered list of token patterns into a single set, or
+ *        NULL if any pattern is malformed (or repeats too much for the
+ *        NFA, see `re_flags_t`). Every pattern is anchored at the
+ *        position being matched, where any `^` matches, so a leading one
+ *        makes no difference
+ * NOTE:  the returned set must be freed with `re_set_free`
+ * 
+ * @param patterns the patterns, in priority order
+ * @param tokens   the token reported for each pattern
+ * @param n        the number of patterns (at least one)
+ * @return re_set_t* 
+ */
+re_set_t *re_set_compile(const char *const *patterns, const int *tokens, size_t n);
+
+/**
+ * @brief finds the longest match of any pattern in the set at the beginning
+ *        of the first `len` characters of `string`, storing the token of the
+ *        pattern that matched in `token`. If several patterns match the
+ *        longest prefix, the one given first wins. Returns the length of the
+ *        match (which may be zero), or -1 if no pattern matches. Threads may
+ *        match with the same set at once
+ * 
+ * @param set    the compiled set to match
+ * @param string a pointer to the position to match at
+ * @param len    the number of characters left in the string
+ * @param token  set to the token of the pattern that matched
+ * @return long 
+ */
+long re_set_match(const re_set_t *set, const char *string, size_t len, int *token);
+
+/**
+ * @brief frees the memory allocated by `re_set_compile`
+ * 
+ * @param set the compiled set to free (may be NULL)
+ */
+void re_set_free(re_set_t *set);
+
 #endif
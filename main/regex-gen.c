@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "codegen.h"
+
+/***********************************
+ *        Token List Structure     *
+ ***********************************/
+typedef struct tokens {
+    char  **names;      /* the name of each token */
+    char  **patterns;   /* the pattern of each token */
+    size_t  n;          /* the number of tokens */
+    size_t  cap;        /* the capacity of both arrays */
+} tokens_t;
+
+static int usage(void) {
+    fprintf(stderr, "Usage: regex-gen [-p prefix] [-o output] <tokens>\n");
+    fprintf(stderr, "       where each line of <tokens> is a name and a pattern\n");
+    return 2;
+}
+
+/* reads the tokens, one `name pattern` per line. Blank lines and lines
+   beginning with `#` are skipped. Returns false on a malformed line */
+static int read_tokens(FILE *in, tokens_t *tokens) {
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int lineno = 0, ok = 1;
+
+    while (ok && (len = getline(&line, &cap, in)) >= 0) {
+        lineno++;
+
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+
+        char *name = line;
+        while (isspace((unsigned char) *name))
+            name++;
+
+        if (!*name || *name == '#')
+            continue;
+
+        // the pattern is everything after the whitespace following the name
+        char *pattern = name;
+        while (*pattern && !isspace((unsigned char) *pattern))
+            pattern++;
+
+        if (!*pattern) {
+            fprintf(stderr, "line %d: missing pattern!\n", lineno);
+            ok = 0;
+            break;
+        }
+
+        *pattern++ = '\0';
+        while (isspace((unsigned char) *pattern))
+            pattern++;
+
+        if (tokens->n == tokens->cap) {
+            tokens->cap = tokens->cap ? 2 * tokens->cap : 16;
+            tokens->names = realloc(tokens->names, tokens->cap * sizeof(char *));
+            tokens->patterns = realloc(tokens->patterns, tokens->cap * sizeof(char *));
+        }
+
+        tokens->names[tokens->n] = strdup(name);
+        tokens->patterns[tokens->n] = strdup(pattern);
+        tokens->n++;
+    }
+
+    free(line);
+    return ok;
+}
+
+static void free_tokens(tokens_t *tokens) {
+    for (size_t i = 0; i < tokens->n; i++) {
+        free(tokens->names[i]);
+        free(tokens->patterns[i]);
+    }
+
+    free(tokens->names);
+    free(tokens->patterns);
+}
+
+int main(int argc, char **argv) {
+    const char *prefix = "re", *output = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:o:")) != -1) {
+        switch (opt) {
+            case 'p':
+                prefix = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                return usage();
+        }
+    }
+
+    if (argc - optind != 1)
+        return usage();
+
+    FILE *in = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+    if (!in) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    tokens_t tokens = {0};
+    int ok = read_tokens(in, &tokens);
+    if (in != stdin)
+        fclose(in);
+
+    if (ok && !tokens.n) {
+        fprintf(stderr, "%s: no tokens!\n", argv[optind]);
+        ok = 0;
+    }
+
+    // write to memory first, so a failure never leaves half a header behind
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *mem = open_memstream(&buf, &len);
+
+    if (ok && !codegen_write(mem, prefix, (const char *const *) tokens.names, (const char *const *) tokens.patterns, tokens.n)) {
+        fprintf(stderr, "%s: could not generate a matcher!\n", argv[optind]);
+        ok = 0;
+    }
+
+    fclose(mem);
+
+    if (ok) {
+        FILE *out = output ? fopen(output, "w") : stdout;
+        if (!out) {
+            perror(output);
+            ok = 0;
+        } else {
+            fwrite(buf, 1, len, out);
+            if (out != stdout)
+                fclose(out);
+        }
+    }
+
+    free(buf);
+    free_tokens(&tokens);
+    return ok ? 0 : 1;
+}
@@ -1,19 +1,421 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "regex.h"
 
-int main(int argc, char **argv) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: reg <pattern> <string>\n");
+/* files are split into chunks of about this many bytes, ending on a line */
+#define CHUNK_SIZE (1 << 20)
+
+/**
+ * @brief what to print for the matching lines
+ * --------
+ *      MODE_LINES  every matching line, in order
+ *      MODE_COUNT  the number of matching lines in each file (-c)
+ *      MODE_FILES  the name of each file with a matching line (-l)
+ */
+typedef enum grep_mode {
+    MODE_LINES, MODE_COUNT, MODE_FILES
+} grep_mode_t;
+
+/***********************************
+ *          Grep Structures        *
+ ***********************************/
+typedef struct file {
+    const char *name;       /* the name to print */
+    char       *data;       /* the contents of the file */
+    size_t      len;        /* the length of the contents */
+    int         mapped;     /* true if `data` is mmap'd rather than malloc'd */
+    int         failed;     /* true if the file could not be read */
+    size_t      count;      /* the number of matching lines, once scanned */
+} file_t;
+
+typedef struct chunk {
+    file_t     *file;       /* the file the chunk belongs to */
+    const char *start;      /* the first line of the chunk */
+    const char *end;        /* past the last line of the chunk */
+    int         last;       /* true if this is the last chunk of its file */
+    char       *out;        /* the matching lines (MODE_LINES only) */
+    size_t      out_len;    /* the length of `out` */
+    size_t      out_cap;    /* the capacity of `out` */
+    size_t      count;      /* the number of matching lines */
+    int         done;       /* true once a worker has scanned the chunk */
+} chunk_t;
+
+typedef struct grep {
+    const re_pattern_t *pattern;    /* shared by every worker, never modified */
+    int                 per_line;   /* true if every line must be tried in turn */
+    grep_mode_t         mode;       /* what to print */
+    int                 prefix;     /* true if lines are prefixed by their file */
+    chunk_t            *chunks;     /* every chunk of every file, in order */
+    size_t              nchunks;    /* the number of chunks */
+    size_t              next;       /* the next chunk to hand out */
+    pthread_mutex_t     lock;       /* guards `next` and every chunk's `done` */
+    pthread_cond_t      cond;       /* signalled whenever a chunk is done */
+} grep_t;
+
+/***********************************
+ *             Helpers             *
+ ***********************************/
+
+/* appends `len` characters of `str` to the chunk's output */
+static void append(chunk_t *chunk, const char *str, size_t len) {
+    if (chunk->out_len + len > chunk->out_cap) {
+        while (chunk->out_len + len > chunk->out_cap)
+            chunk->out_cap = chunk->out_cap ? 2 * chunk->out_cap : 4096;
+        chunk->out = realloc(chunk->out, chunk->out_cap);
     }
-    
-    char *match = re_get_match(argv[1], argv[2]);
-    
+
+    memcpy(chunk->out + chunk->out_len, str, len);
+    chunk->out_len += len;
+}
+
+/* finds every matching line of the chunk */
+static void scan_chunk(const grep_t *grep, chunk_t *chunk) {
+    const char *line = chunk->start;
+    int skip = !grep->per_line;
+    re_span_t span;
+
+    while (line < chunk->end) {
+        // skip straight to the line the next match begins on. A match across
+        // lines is not a match of either, so the line is still checked below
+        if (skip) {
+            if (!re_pattern_span_n(grep->pattern, line, chunk->end - line, &span))
+                break;
+
+            const char *match = line + span.start;
+            while (match > line && match[-1] != '\n')
+                match--;
+            line = match;
+        }
+
+        const char *eol = memchr(line, '\n', chunk->end - line);
+        if (!eol)
+            eol = chunk->end;
+
+        if (!re_pattern_match_n(grep->pattern, line, eol - line)) {
+            // matches keep crossing lines, so stop searching past the line
+            // we are on, which could take quadratic time
+            skip = 0;
+        } else {
+            chunk->count++;
+
+            // only whether the file matches at all is needed
+            if (grep->mode == MODE_FILES)
+                break;
+
+            if (grep->mode == MODE_LINES) {
+                if (grep->prefix) {
+                    append(chunk, chunk->file->name, strlen(chunk->file->name));
+                    append(chunk, ":", 1);
+                }
+
+                append(chunk, line, eol - line);
+                append(chunk, "\n", 1);
+            }
+        }
+
+        line = eol + 1;
+    }
+}
+
+/* scans chunks until there are none left */
+static void *worker(void *arg) {
+    grep_t *grep = arg;
+
+    while (1) {
+        pthread_mutex_lock(&grep->lock);
+        size_t i = grep->next++;
+        pthread_mutex_unlock(&grep->lock);
+
+        if (i >= grep->nchunks)
+            return NULL;
+
+        scan_chunk(grep, &grep->chunks[i]);
+
+        pthread_mutex_lock(&grep->lock);
+        grep->chunks[i].done = 1;
+        pthread_cond_broadcast(&grep->cond);
+        pthread_mutex_unlock(&grep->lock);
+    }
+}
+
+/* reads all of stdin into memory, returning false on error */
+static int read_stdin(file_t *file) {
+    size_t cap = CHUNK_SIZE, n;
+    file->data = malloc(cap);
+
+    while ((n = fread(file->data + file->len, 1, cap - file->len, stdin)) > 0) {
+        file->len += n;
+        if (file->len == cap)
+            file->data = realloc(file->data, cap *= 2);
+    }
+
+    return !ferror(stdin);
+}
+
+/* maps the file into memory, returning false on error */
+static int open_file(file_t *file) {
+    if (!strcmp(file->name, "-"))
+        return read_stdin(file);
+
+    int fd = open(file->name, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(file->name);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+
+    file->len = st.st_size;
+    if (file->len) {
+        file->data = mmap(NULL, file->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (file->data == MAP_FAILED) {
+            perror(file->name);
+            file->data = NULL;
+            close(fd);
+            return 0;
+        }
+
+        file->mapped = 1;
+        posix_madvise(file->data, file->len, POSIX_MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+    return 1;
+}
+
+static void close_file(file_t *file) {
+    if (file->mapped)
+        munmap(file->data, file->len);
+    else
+        free(file->data);
+}
+
+/* splits every file into line-aligned chunks */
+static void split_files(grep_t *grep, file_t *files, int nfiles) {
+    size_t cap = nfiles;
+    grep->chunks = calloc(cap, sizeof(chunk_t));
+
+    for (int i = 0; i < nfiles; i++) {
+        if (files[i].failed)
+            continue;
+
+        // an empty file is not mapped at all, but still gets a chunk
+        const char *start = files[i].data;
+        const char *end = files[i].len ? start + files[i].len : start;
+
+        do {
+            const char *stop = end;
+            if (end - start > CHUNK_SIZE) {
+                const char *eol = memchr(start + CHUNK_SIZE, '\n', end - start - CHUNK_SIZE);
+                stop = eol ? eol + 1 : end;
+            }
+
+            if (grep->nchunks == cap)
+                grep->chunks = realloc(grep->chunks, (cap *= 2) * sizeof(chunk_t));
+
+            chunk_t *chunk = &grep->chunks[grep->nchunks++];
+            memset(chunk, 0, sizeof(chunk_t));
+            chunk->file = &files[i];
+            chunk->start = start;
+            chunk->end = stop;
+            chunk->last = stop == end;
+
+            start = stop;
+        } while (start < end);
+    }
+}
+
+/* prints the chunks in order as the workers finish them */
+static size_t print_chunks(grep_t *grep) {
+    size_t total = 0;
+
+    for (size_t i = 0; i < grep->nchunks; i++) {
+        chunk_t *chunk = &grep->chunks[i];
+
+        pthread_mutex_lock(&grep->lock);
+        while (!chunk->done)
+            pthread_cond_wait(&grep->cond, &grep->lock);
+        pthread_mutex_unlock(&grep->lock);
+
+        if (chunk->out_len)
+            fwrite(chunk->out, 1, chunk->out_len, stdout);
+        free(chunk->out);
+
+        chunk->file->count += chunk->count;
+        total += chunk->count;
+
+        if (!chunk->last)
+            continue;
+
+        if (grep->mode == MODE_COUNT) {
+            if (grep->prefix)
+                printf("%s:", chunk->file->name);
+            printf("%zu\n", chunk->file->count);
+        } else if (grep->mode == MODE_FILES && chunk->file->count) {
+            printf("%s\n", chunk->file->name);
+        }
+    }
+
+    return total;
+}
+
+static int usage(void) {
+    fprintf(stderr, "Usage: regex [-c | -l] [-j threads] [--stats] <pattern> [file...]\n");
+    fprintf(stderr, "       regex -s <pattern> <string>\n");
+    fprintf(stderr, "--stats prints the work of the searches (with `make STATS=1`), which count every\n"
+                    "        instruction only when interpreted, so the pattern is not compiled to native code\n");
+    return 2;
+}
+
+/* the original mode: match the pattern against a single string */
+static int match_string(char *pattern, char *string) {
+    char *match = re_get_match(pattern, string);
+
     printf("A match was%sfound\n", match ? " " : " not ");
 
     if (match)
         printf("\nMatch: %s\n", match);
 
     free(match);
-    return 0;
+    return match ? 0 : 1;
+}
+
+/* prints the work the searches did to stderr */
+static void print_stats(const re_pattern_t *pattern) {
+    re_stats_t stats;
+    fflush(stdout);
+
+    if (!re_pattern_get_stats(pattern, &stats)) {
+        fprintf(stderr, "regex: no statistics were counted (build with `make STATS=1`)\n");
+        return;
+    }
+
+    const struct { const char *name; size_t value; } rows[] = {
+        { "searches", stats.searches }, { "bytes", stats.bytes }, { "skipped", stats.skipped },
+        { "starts", stats.starts }, { "instructions", stats.insts }, { "backtracks", stats.backtracks },
+        { "memo hits", stats.memo_hits }, { "dfa bytes", stats.dfa_bytes }, { "dfa hits", stats.dfa_hits },
+        { "dfa misses", stats.dfa_misses }, { "dfa flushes", stats.dfa_flushes },
+    };
+
+    for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+        fprintf(stderr, "%-14s%zu\n", rows[i].name, rows[i].value);
+}
+
+int main(int argc, char **argv) {
+    grep_mode_t mode = MODE_LINES;
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int stats = 0, opt;
+
+    // getopt only knows short options, so the long one is taken out first
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--stats"))
+            stats = 1;
+        else
+            argv[nargs++] = argv[i];
+    }
+    argv[nargs] = NULL;
+    argc = nargs;
+
+    while ((opt = getopt(argc, argv, "clj:s")) != -1) {
+        switch (opt) {
+            case 'c':
+                mode = MODE_COUNT;
+                break;
+            case 'l':
+                mode = MODE_FILES;
+                break;
+            case 'j':
+                nthreads = atol(optarg);
+                break;
+            case 's':
+                if (argc - optind != 2)
+                    return usage();
+                return match_string(argv[optind], argv[optind + 1]);
+            default:
+                return usage();
+        }
+    }
+
+    if (optind >= argc || nthreads < 1)
+        return usage();
+
+    // compiled patterns are safe to share between threads. The pattern is
+    // tried on every line, so it is worth compiling to native code, unless
+    // every instruction the interpreter runs is to be counted (native code
+    // counts none). A pattern that may backtrack too much is interpreted
+    // with a memo either way, so no long line can make it take exponential
+    // time
+    re_pattern_t *pattern = re_pattern_compile_flags(argv[optind], stats ? RE_BACKTRACK : RE_JIT);
+    if (!pattern)
+        return 2;
+
+    char *stdin_name = "(standard input)";
+    int nfiles = argc - optind - 1;
+    file_t *files = calloc(nfiles ? nfiles : 1, sizeof(file_t));
+    int status = 0;
+
+    if (!nfiles) {
+        files[0].name = "-";
+        nfiles = 1;
+    }
+
+    for (int i = 0; i < nfiles; i++) {
+        if (argc - optind > 1)
+            files[i].name = argv[optind + 1 + i];
+
+        if (!open_file(&files[i])) {
+            files[i].failed = 1;
+            status = 2;
+        }
+
+        if (!strcmp(files[i].name, "-"))
+            files[i].name = stdin_name;
+    }
+
+    grep_t grep = {
+        .pattern = pattern,
+        // a `^` or `$` anywhere is anchored to the start or end of a line,
+        // so such a pattern can only be matched one line at a time
+        .per_line = re_pattern_has_anchor(pattern),
+        .mode = mode,
+        .prefix = nfiles > 1,
+    };
+    pthread_mutex_init(&grep.lock, NULL);
+    pthread_cond_init(&grep.cond, NULL);
+    split_files(&grep, files, nfiles);
+
+    pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+    for (long i = 0; i < nthreads; i++)
+        pthread_create(&threads[i], NULL, worker, &grep);
+
+    size_t total = print_chunks(&grep);
+
+    for (long i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_cond_destroy(&grep.cond);
+    pthread_mutex_destroy(&grep.lock);
+    free(threads);
+    free(grep.chunks);
+
+    for (int i = 0; i < nfiles; i++)
+        close_file(&files[i]);
+    free(files);
+
+    if (stats)
+        print_stats(pattern);
+    re_pattern_free(pattern);
+
+    // like grep: 0 if a line matched, 1 if none did, 2 on error
+    return status ? status : total ? 0 : 1;
 }
@@ -0,0 +1,60 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN(n) \
+    (((n) + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t))
+
+arena_t *arena_new(size_t block_size) {
+    arena_t *arena = calloc(1, sizeof(arena_t));
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK;
+    return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    if (!arena)
+        return malloc(size);
+
+    size = ALIGN(size);
+
+    // start a new block, large enough for the allocation, if this one is full
+    arena_block_t *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        const size_t block_size = size > arena->block_size ? size : arena->block_size;
+
+        block = malloc(sizeof(arena_block_t) + block_size);
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+    }
+
+    void *ptr = (char *) block->data + block->used;
+    block->used += size;
+    arena->allocated += size;
+
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t n, size_t size) {
+    if (!arena)
+        return calloc(n, size);
+
+    void *ptr = arena_alloc(arena, n * size);
+    memset(ptr, 0, n * size);
+    return ptr;
+}
+
+void arena_free(arena_t *arena) {
+    if (!arena) return;
+
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
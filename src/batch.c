@@ -0,0 +1,184 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "regex.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* subjects are claimed this many at a time. It is a multiple of 8, as is
+   every share a thread steals, so no two threads write the same byte of the
+   bitmap */
+#define BATCH_CHUNK 32
+
+/* the most threads a batch is spread over */
+#define BATCH_MAX_THREADS 256
+
+/***********************************
+ *          Batch State            *
+ ***********************************/
+typedef struct worker {
+    pthread_mutex_t  lock;      /* guards `lo` and `hi` */
+    size_t           lo;        /* the first subject not yet claimed */
+    size_t           hi;        /* one past the last subject of its share */
+    size_t           matches;   /* the subjects it found to match */
+    struct batch    *batch;     /* the batch it works on */
+    pthread_t        thread;    /* the thread it runs on */
+    int              started;   /* true if `thread` was created */
+} worker_t;
+
+typedef struct batch {
+    const re_pattern_t *pattern;    /* the pattern every subject is matched against */
+    const re_subject_t *subjects;   /* the subjects */
+    unsigned char      *matched;    /* a bit per subject, or NULL */
+    re_span_t          *spans;      /* a span per subject, or NULL */
+    worker_t           *workers;    /* one per thread */
+    int                 nworkers;   /* the number of threads */
+} batch_t;
+
+/* takes the next chunk of the worker's own share, returning false once
+   there is none left */
+static int claim(worker_t *worker, size_t *lo, size_t *hi) {
+    pthread_mutex_lock(&worker->lock);
+
+    const int found = worker->lo < worker->hi;
+    if (found) {
+        *lo = worker->lo;
+        *hi = worker->hi - worker->lo > BATCH_CHUNK ? worker->lo + BATCH_CHUNK : worker->hi;
+        worker->lo = *hi;
+    }
+
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+/* moves the back half of the first other share with anything left into the
+   worker's own, returning false if every share is empty. The rest of a
+   share too small to split is taken whole */
+static int steal(worker_t *worker) {
+    const batch_t *batch = worker->batch;
+    const int self = worker - batch->workers;
+
+    for (int i = 1; i < batch->nworkers; i++) {
+        worker_t *victim = &batch->workers[(self + i) % batch->nworkers];
+        size_t lo = 0, hi = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->lo < victim->hi) {
+            lo = victim->lo + ((victim->hi - victim->lo) / 2 & ~(size_t) 7);
+            hi = victim->hi;
+            victim->hi = lo;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (lo < hi) {
+            pthread_mutex_lock(&worker->lock);
+            worker->lo = lo;
+            worker->hi = hi;
+            pthread_mutex_unlock(&worker->lock);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* matches the subjects in [lo, hi), returning how many matched */
+static size_t match_range(const batch_t *batch, size_t lo, size_t hi) {
+    size_t matches = 0;
+
+    for (size_t i = lo; i < hi; i++) {
+        const re_subject_t *subject = &batch->subjects[i];
+        int match;
+
+        // the span of a match says everything a bit does
+        if (batch->spans) {
+            match = re_pattern_span_n(batch->pattern, subject->string, subject->len, &batch->spans[i]);
+            if (!match)
+                batch->spans[i] = (re_span_t) { RE_NO_GROUP, 0 };
+        } else {
+            match = re_pattern_match_n(batch->pattern, subject->string, subject->len);
+        }
+
+        if (batch->matched) {
+            if (match)
+                batch->matched[i / 8] |= 1 << (i % 8);
+            else
+                batch->matched[i / 8] &= ~(1 << (i % 8));
+        }
+
+        matches += match;
+    }
+
+    return matches;
+}
+
+/* works through the worker's share, then through whatever it can steal */
+static void *run_worker(void *arg) {
+    worker_t *worker = arg;
+    size_t lo, hi;
+
+    do {
+        while (claim(worker, &lo, &hi))
+            worker->matches += match_range(worker->batch, lo, hi);
+    } while (steal(worker));
+
+    return NULL;
+}
+
+size_t re_pattern_match_batch(const re_pattern_t *pattern, const re_subject_t *subjects, size_t n,
+                              unsigned char *matched, re_span_t *spans, int nthreads) {
+    if (!n)
+        return 0;
+
+    // more threads than chunks would only wait for work
+    long nworkers = nthreads > 0 ? nthreads : sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t nchunks = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    if (nworkers < 1)
+        nworkers = 1;
+    if (nworkers > BATCH_MAX_THREADS)
+        nworkers = BATCH_MAX_THREADS;
+    if ((size_t) nworkers > nchunks)
+        nworkers = nchunks;
+
+    batch_t batch = { pattern, subjects, matched, spans, NULL, nworkers };
+
+    // a single thread has no one to share with
+    if (nworkers == 1)
+        return match_range(&batch, 0, n);
+
+    batch.workers = calloc(nworkers, sizeof(worker_t));
+    if (!batch.workers)
+        return match_range(&batch, 0, n);
+
+    // every thread starts with an equal share, each beginning on a byte
+    const size_t share = (n / nworkers + 7) & ~(size_t) 7;
+    for (int i = 0; i < nworkers; i++) {
+        worker_t *worker = &batch.workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->lo = i * share < n ? i * share : n;
+        worker->hi = worker->lo + share < n && i < nworkers - 1 ? worker->lo + share : n;
+        worker->batch = &batch;
+    }
+
+    // the share of a thread that could not be created is stolen by the others
+    for (int i = 1; i < nworkers; i++)
+        batch.workers[i].started = !pthread_create(&batch.workers[i].thread, NULL, run_worker, &batch.workers[i]);
+
+    run_worker(&batch.workers[0]);
+
+    // a thread may still look through every share until it is done
+    for (int i = 1; i < nworkers; i++) {
+        if (batch.workers[i].started)
+            pthread_join(batch.workers[i].thread, NULL);
+    }
+
+    size_t matches = 0;
+    for (int i = 0; i < nworkers; i++) {
+        matches += batch.workers[i].matches;
+        pthread_mutex_destroy(&batch.workers[i].lock);
+    }
+
+    free(batch.workers);
+    return matches;
+}
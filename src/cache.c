@@ -0,0 +1,191 @@
+#include "cache.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************
+ *          Cache State            *
+ ***********************************/
+static struct {
+    pthread_mutex_t lock;                   /* guards everything below */
+    cache_entry_t  *buckets[CACHE_BUCKETS]; /* the cached entries, by hash */
+    cache_entry_t  *head;                   /* the most recently used entry */
+    cache_entry_t  *tail;                   /* the least recently used entry */
+    size_t          size;                   /* the number of cached entries */
+    size_t          capacity;               /* the most entries the cache holds */
+    size_t          hits;                   /* lookups that found their entry */
+    size_t          misses;                 /* lookups that compiled their pattern */
+    size_t          evictions;              /* entries dropped to make room */
+} cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .capacity = CACHE_DEFAULT_CAPACITY,
+};
+
+/* FNV-1a hash of a pattern string */
+static size_t hash_key(const char *key) {
+    size_t hash = 2166136261u;
+
+    for (; *key; key++) {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void free_entry(cache_entry_t *entry) {
+    re_pattern_free(entry->pattern);
+    free(entry->key);
+    free(entry);
+}
+
+/* removes the entry from the LRU list */
+static void unlink_entry(cache_entry_t *entry) {
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache.head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache.tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+/* makes the entry the most recently used one */
+static void push_entry(cache_entry_t *entry) {
+    entry->next = cache.head;
+    if (cache.head)
+        cache.head->prev = entry;
+    else
+        cache.tail = entry;
+
+    cache.head = entry;
+}
+
+/* drops the entry from the cache, freeing it unless it is in use */
+static void evict_entry(cache_entry_t *entry) {
+    cache_entry_t **link = &cache.buckets[entry->hash % CACHE_BUCKETS];
+    while (*link != entry)
+        link = &(*link)->chain;
+    *link = entry->chain;
+
+    unlink_entry(entry);
+    entry->cached = 0;
+    cache.size--;
+
+    if (!entry->refs)
+        free_entry(entry);
+}
+
+/* evicts the least recently used entries until at most `size` are left */
+static void shrink(size_t size) {
+    while (cache.size > size) {
+        evict_entry(cache.tail);
+        cache.evictions++;
+    }
+}
+
+/* returns the cached entry of the pattern, or NULL if there is none */
+static cache_entry_t *find_entry(const char *regexp, size_t hash) {
+    for (cache_entry_t *entry = cache.buckets[hash % CACHE_BUCKETS]; entry; entry = entry->chain) {
+        if (entry->hash == hash && !strcmp(entry->key, regexp))
+            return entry;
+    }
+
+    return NULL;
+}
+
+cache_entry_t *cache_acquire(const char *regexp) {
+    const size_t hash = hash_key(regexp);
+
+    pthread_mutex_lock(&cache.lock);
+    cache_entry_t *entry = find_entry(regexp, hash);
+
+    if (entry) {
+        cache.hits++;
+        entry->refs++;
+        unlink_entry(entry);
+        push_entry(entry);
+        pthread_mutex_unlock(&cache.lock);
+        return entry;
+    }
+
+    cache.misses++;
+    pthread_mutex_unlock(&cache.lock);
+
+    // compile without holding the lock, so other patterns can still be found
+    re_pattern_t *pattern = re_pattern_compile(regexp);
+    if (!pattern)
+        return NULL;
+
+    entry = calloc(1, sizeof(cache_entry_t));
+    entry->key = malloc(strlen(regexp) + 1);
+    strcpy(entry->key, regexp);
+    entry->hash = hash;
+    entry->pattern = pattern;
+    entry->refs = 1;
+
+    pthread_mutex_lock(&cache.lock);
+
+    // another thread may have compiled the same pattern in the meantime
+    cache_entry_t *other = find_entry(regexp, hash);
+    if (other) {
+        other->refs++;
+        pthread_mutex_unlock(&cache.lock);
+        free_entry(entry);
+        return other;
+    }
+
+    if (cache.capacity) {
+        shrink(cache.capacity - 1);
+
+        cache_entry_t **bucket = &cache.buckets[hash % CACHE_BUCKETS];
+        entry->chain = *bucket;
+        *bucket = entry;
+        push_entry(entry);
+        entry->cached = 1;
+        cache.size++;
+    }
+
+    pthread_mutex_unlock(&cache.lock);
+    return entry;
+}
+
+void cache_release(cache_entry_t *entry) {
+    pthread_mutex_lock(&cache.lock);
+    const int unused = !--entry->refs && !entry->cached;
+    pthread_mutex_unlock(&cache.lock);
+
+    if (unused)
+        free_entry(entry);
+}
+
+void re_cache_set_capacity(size_t capacity) {
+    pthread_mutex_lock(&cache.lock);
+    cache.capacity = capacity;
+    shrink(capacity);
+    pthread_mutex_unlock(&cache.lock);
+}
+
+void re_cache_get_stats(re_cache_stats_t *stats) {
+    pthread_mutex_lock(&cache.lock);
+    stats->hits = cache.hits;
+    stats->misses = cache.misses;
+    stats->evictions = cache.evictions;
+    stats->size = cache.size;
+    stats->capacity = cache.capacity;
+    pthread_mutex_unlock(&cache.lock);
+}
+
+void re_cache_clear(void) {
+    pthread_mutex_lock(&cache.lock);
+    while (cache.size)
+        evict_entry(cache.tail);
+
+    cache.hits = cache.misses = cache.evictions = 0;
+    pthread_mutex_unlock(&cache.lock);
+}
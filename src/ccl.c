@@ -0,0 +1,282 @@
+#include "ccl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define CCL_X86
+#include <immintrin.h>
+#endif
+
+#define IS_ATOM(x) \
+    ((x) == CHAR || (x) == DOT || (x) == CHAR_CLASS)
+
+/* returns true if the single `re_t` accepts `ch` */
+static int atom_accepts(const re_t *atom, int ch) {
+    switch (atom->type) {
+        case CHAR:
+            return (unsigned char) atom->class.c == ch;
+        case DOT:
+            return 1;
+        case CHAR_CLASS:
+            return atom->nccl ^ get_ind(atom->class.mask, ch);
+        default:
+            return 0;
+    }
+}
+
+/* stores the ranges of bytes whose membership is `in`, returning how many there are */
+static int find_ranges(const ccl_t *ccl, int in, unsigned char *lo, unsigned char *width) {
+    int n = 0;
+
+    for (int ch = 0; ch < 256; ch++) {
+        if (ccl_has(ccl, ch) != in)
+            continue;
+
+        int last = ch;
+        while (last + 1 < 256 && ccl_has(ccl, last + 1) == in)
+            last++;
+
+        if (n < CCL_MAX_RANGES) {
+            lo[n] = ch;
+            width[n] = last - ch;
+        }
+
+        n++;
+        ch = last;
+    }
+
+    return n;
+}
+
+void ccl_compile(ccl_t *ccl, const re_t *atom) {
+    memset(ccl, 0, sizeof(ccl_t));
+
+    for (int ch = 0; ch < 256; ch++) {
+        if (!atom_accepts(atom, ch))
+            continue;
+
+        ccl->set[ch >> 3] |= 1 << (ch & 7);
+        ccl->nibbles[(ch >> 7) * 16 + (ch & 15)] |= 1 << ((ch >> 4) & 7);
+    }
+
+    // compare against whichever of the class or its complement has fewer ranges
+    unsigned char lo[CCL_MAX_RANGES], width[CCL_MAX_RANGES];
+    int in = find_ranges(ccl, 1, ccl->lo, ccl->width);
+    int out = find_ranges(ccl, 0, lo, width);
+
+    ccl->nranges = in;
+    if (out < in) {
+        memcpy(ccl->lo, lo, sizeof(lo));
+        memcpy(ccl->width, width, sizeof(width));
+        ccl->nranges = out;
+        ccl->invert = 1;
+    }
+
+    ccl->kernel = CCL_SCALAR;
+
+#ifdef CCL_X86
+    if (__builtin_cpu_supports("avx2"))
+        ccl->kernel = CCL_AVX2;
+    else if (ccl->nranges <= CCL_MAX_RANGES)
+        ccl->kernel = CCL_SSE2;
+#endif
+}
+
+#ifdef CCL_X86
+/* returns a mask with bit `i` set if byte `i` of the block is in the class */
+static inline unsigned sse2_members(const ccl_t *ccl, __m128i block) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i hits = zero;
+
+    // (ch - lo) <= width, as unsigned bytes, if and only if ch is in the range
+    for (int i = 0; i < ccl->nranges; i++) {
+        __m128i diff = _mm_sub_epi8(block, _mm_set1_epi8(ccl->lo[i]));
+        __m128i over = _mm_subs_epu8(diff, _mm_set1_epi8(ccl->width[i]));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(over, zero));
+    }
+
+    unsigned mask = _mm_movemask_epi8(hits);
+    return ccl->invert ? ~mask & 0xffff : mask;
+}
+
+/* the AVX2 lookup tables, broadcast to both lanes */
+typedef struct avx2_tables {
+    __m256i low;            /* bits for bytes whose high nibble is 0-7 */
+    __m256i high;           /* bits for bytes whose high nibble is 8-15 */
+    __m256i pow2;           /* 1 << (high nibble % 8) */
+} avx2_tables_t;
+
+__attribute__((target("avx2")))
+static inline avx2_tables_t avx2_load_tables(const ccl_t *ccl) {
+    avx2_tables_t tables;
+
+    tables.low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) ccl->nibbles));
+    tables.high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (ccl->nibbles + 16)));
+    tables.pow2 = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128
+    );
+
+    return tables;
+}
+
+/* returns a mask with bit `i` set if byte `i` of the block is in the class */
+__attribute__((target("avx2")))
+static inline unsigned avx2_members(const avx2_tables_t *tables, __m256i block) {
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_and_si256(block, nibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+
+    // the top bit of each byte picks the table for its high nibble
+    __m256i bits = _mm256_blendv_epi8(
+        _mm256_shuffle_epi8(tables->low, low),
+        _mm256_shuffle_epi8(tables->high, low),
+        block
+    );
+    __m256i hits = _mm256_and_si256(bits, _mm256_shuffle_epi8(tables->pow2, high));
+
+    return ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(hits, _mm256_setzero_si256()));
+}
+
+static const char *sse2_span(const ccl_t *ccl, const char *text, const char *end) {
+    for (; end - text >= 16; text += 16) {
+        unsigned misses = ~sse2_members(ccl, _mm_loadu_si128((const __m128i *) text)) & 0xffff;
+        if (misses)
+            return text + __builtin_ctz(misses);
+    }
+
+    return text;
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_span(const ccl_t *ccl, const char *text, const char *end) {
+    const avx2_tables_t tables = avx2_load_tables(ccl);
+
+    for (; end - text >= 32; text += 32) {
+        unsigned misses = ~avx2_members(&tables, _mm256_loadu_si256((const __m256i *) text));
+        if (misses)
+            return text + __builtin_ctz(misses);
+    }
+
+    return text;
+}
+
+static const char *sse2_find(const ccl_t *ccl, const char *text, const char *end) {
+    for (; end - text >= 16; text += 16) {
+        unsigned hits = sse2_members(ccl, _mm_loadu_si128((const __m128i *) text));
+        if (hits)
+            return text + __builtin_ctz(hits);
+    }
+
+    return text;
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_find(const ccl_t *ccl, const char *text, const char *end) {
+    const avx2_tables_t tables = avx2_load_tables(ccl);
+
+    for (; end - text >= 32; text += 32) {
+        unsigned hits = avx2_members(&tables, _mm256_loadu_si256((const __m256i *) text));
+        if (hits)
+            return text + __builtin_ctz(hits);
+    }
+
+    return text;
+}
+#endif
+
+const char *ccl_span(const ccl_t *ccl, const char *text, const char *end) {
+#ifdef CCL_X86
+    // the kernels stop at the first miss or the last partial block
+    switch (ccl->kernel) {
+        case CCL_AVX2:
+            text = avx2_span(ccl, text, end);
+            break;
+        case CCL_SSE2:
+            text = sse2_span(ccl, text, end);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    while (text < end && ccl_has(ccl, *text))
+        text++;
+
+    return text;
+}
+
+const char *ccl_find(const ccl_t *ccl, const char *text, const char *end) {
+#ifdef CCL_X86
+    // the kernels stop at the first hit or the last partial block
+    switch (ccl->kernel) {
+        case CCL_AVX2:
+            text = avx2_find(ccl, text, end);
+            break;
+        case CCL_SSE2:
+            text = sse2_find(ccl, text, end);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    for (; text < end; text++) {
+        if (ccl_has(ccl, *text))
+            return text;
+    }
+
+    return NULL;
+}
+
+ccl_t *ccl_annotate(re_t *reg, arena_t *arena) {
+    size_t len = 0, runs_len = 0, count = 0;
+    for (; reg[len].type != TERMINAL; len++) {
+        if (IS_ATOM(reg[len].type) && (reg[len + 1].type == STAR || reg[len + 1].type == PLUS))
+            runs_len++;
+    }
+
+    // only allocate once there is a run that could be scanned
+    if (!runs_len)
+        return NULL;
+
+    ccl_t *runs = arena_calloc(arena, runs_len, sizeof(ccl_t));
+    ccl_t next;
+
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (!IS_ATOM(reg[i].type) || (reg[i + 1].type != STAR && reg[i + 1].type != PLUS))
+            continue;
+
+        const re_t *follow = &reg[i + 2];
+        ccl_compile(&runs[count], &reg[i]);
+
+        // `$` can only match once the run has consumed the rest of the text
+        if (follow[0].type == END && follow[1].type == TERMINAL) {
+            reg[i].run = &runs[count++];
+            continue;
+        }
+
+        // otherwise the run must be followed by an atom that has to match
+        if (!IS_ATOM(follow[0].type) || follow[1].type == STAR || follow[1].type == OPTIONAL ||
+            (follow[1].type == REPEAT && !follow[1].class.rep.min))
+            continue;
+
+        ccl_compile(&next, follow);
+
+        int disjoint = 1;
+        for (int j = 0; j < 32; j++)
+            disjoint &= !(runs[count].set[j] & next.set[j]);
+
+        if (disjoint)
+            reg[i].run = &runs[count++];
+    }
+
+    if (!count) {
+        if (!arena)
+            free(runs);
+        return NULL;
+    }
+
+    return runs;
+}
@@ -0,0 +1,272 @@
+#include "codegen.h"
+#include "regex.h"
+#include "regex-private.h"
+#include "dfa.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the number of slots in the table of state ids, at most half of them used */
+#define ID_SLOTS (2 * CODEGEN_MAX_STATES)
+
+/* the number of case labels written on each line of a switch */
+#define LABELS_PER_LINE 8
+
+/***********************************
+ *        Codegen Structures       *
+ ***********************************/
+typedef struct machine {
+    dfa_t     *dfa;                         /* the DFA being explored */
+    dstate_t  *states[CODEGEN_MAX_STATES];  /* every live state, by id */
+    int        nstates;                     /* the number of live states */
+    dstate_t  *keys[ID_SLOTS];              /* the states in the table of ids */
+    int        ids[ID_SLOTS];               /* the id of each state in the table */
+} machine_t;
+
+/* returns true if `name` is a C identifier (or the tail of one, if `tail`) */
+static int is_identifier(const char *name, int tail) {
+    if (!*name || (!tail && isdigit((unsigned char) *name)))
+        return 0;
+
+    for (; *name; name++) {
+        if (!isalnum((unsigned char) *name) && *name != '_')
+            return 0;
+    }
+
+    return 1;
+}
+
+/* returns the id of the state, numbering it if it is new. A dead state has
+   no id, and -1 is returned if there are too many states */
+static int state_id(machine_t *machine, dstate_t *state) {
+    if (!state->n)
+        return -1;
+
+    size_t slot = ((uintptr_t) state >> 4) % ID_SLOTS;
+    while (machine->keys[slot] && machine->keys[slot] != state)
+        slot = (slot + 1) % ID_SLOTS;
+
+    if (!machine->keys[slot]) {
+        if (machine->nstates == CODEGEN_MAX_STATES)
+            return -1;
+
+        machine->keys[slot] = state;
+        machine->ids[slot] = machine->nstates;
+        machine->states[machine->nstates++] = state;
+    }
+
+    return machine->ids[slot];
+}
+
+/* materialises every state reachable from the start state, filling in each
+   state's transitions. Returns false if there are too many states */
+static int explore(machine_t *machine) {
+    // the states are explored breadth first, in the order they are numbered
+    if (state_id(machine, dfa_start(machine->dfa)) < 0)
+        return 1;
+
+    for (int i = 0; i < machine->nstates; i++) {
+        for (int ch = 0; ch < 256; ch++) {
+            dstate_t *next = dfa_next(machine->dfa, machine->states[i], ch);
+
+            if (next->n && state_id(machine, next) < 0)
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* writes `str` in upper case */
+static void write_upper(FILE *out, const char *str) {
+    for (; *str; str++)
+        fputc(toupper((unsigned char) *str), out);
+}
+
+/* writes the pattern inside a comment, which it must neither end nor nest */
+static void write_comment(FILE *out, const char *pattern) {
+    for (; *pattern; pattern++) {
+        fputc(*pattern, out);
+        if ((pattern[0] == '*' && pattern[1] == '/') || (pattern[0] == '/' && pattern[1] == '*'))
+            fputc(' ', out);
+    }
+}
+
+/* writes the enum constant of the token */
+static void write_token(FILE *out, const char *prefix, const char *name) {
+    write_upper(out, prefix);
+    fputc('_', out);
+    write_upper(out, name);
+}
+
+/* writes a byte as a character constant */
+static void write_char(FILE *out, int ch) {
+    if (ch >= ' ' && ch <= '~' && ch != '\'' && ch != '\\')
+        fprintf(out, "'%c'", ch);
+    else
+        fprintf(out, "0x%02x", ch);
+}
+
+/* writes the jump to the state with id `id`, or the return of a dead state */
+static void write_jump(FILE *out, int id) {
+    if (id < 0)
+        fprintf(out, "return match;\n");
+    else
+        fprintf(out, "goto s%d;\n", id);
+}
+
+/* writes the label and switch of a state. The most common transition is the
+   switch's default, and the other labels are grouped by their target */
+static void write_state(FILE *out, machine_t *machine, int i, const int *targeted, const char *prefix, const char *const *names) {
+    dstate_t *state = machine->states[i];
+    int target[256], count[CODEGEN_MAX_STATES + 1] = {0};
+
+    for (int ch = 0; ch < 256; ch++) {
+        target[ch] = state_id(machine, state->next[ch]);
+        count[target[ch] + 1]++;
+    }
+
+    int common = -1;
+    for (int id = 0; id < machine->nstates; id++) {
+        if (count[id + 1] > count[common + 1])
+            common = id;
+    }
+
+    if (targeted[i])
+        fprintf(out, "s%d:\n", i);
+
+    // whatever the state matches now also matches at the end of the input
+    if (state->accept_eol) {
+        fprintf(out, "    if (sp == end) {\n        match = (long) len;\n        *token = ");
+        write_token(out, prefix, names[state->token_eol]);
+        fprintf(out, ";\n        return match;\n    }\n");
+    } else {
+        fprintf(out, "    if (sp == end)\n        return match;\n");
+    }
+
+    if (state->accept) {
+        fprintf(out, "    match = sp - (const unsigned char *) text;\n");
+        fprintf(out, "    *token = ");
+        write_token(out, prefix, names[state->token]);
+        fprintf(out, ";\n");
+    }
+
+    fprintf(out, "    switch (*sp++) {\n");
+
+    for (int id = -1; id < machine->nstates; id++) {
+        if (id == common || !count[id + 1])
+            continue;
+
+        int labels = 0;
+        for (int ch = 0; ch < 256; ch++) {
+            if (target[ch] != id)
+                continue;
+
+            if (labels && labels % LABELS_PER_LINE == 0)
+                fputc('\n', out);
+
+            fprintf(out, labels % LABELS_PER_LINE ? " case " : "    case ");
+            write_char(out, ch);
+            fputc(':', out);
+            labels++;
+        }
+
+        fprintf(out, "\n        ");
+        write_jump(out, id);
+    }
+
+    fprintf(out, "    default:\n        ");
+    write_jump(out, common);
+    fprintf(out, "    }\n\n");
+}
+
+/* writes the header around the states */
+static void write_machine(FILE *out, machine_t *machine, const char *prefix, const char *const *names, const char *const *patterns, size_t n) {
+    // only the states something jumps to need a label
+    int *targeted = calloc(machine->nstates + 1, sizeof(int));
+    int accepts = 0;
+
+    for (int i = 0; i < machine->nstates; i++) {
+        for (int ch = 0; ch < 256; ch++)
+            targeted[state_id(machine, machine->states[i]->next[ch]) + 1] = 1;
+
+        accepts |= machine->states[i]->accept || machine->states[i]->accept_eol;
+    }
+
+    fprintf(out, "/* generated by regex-gen: do not edit */\n\n");
+    fprintf(out, "#ifndef ");
+    write_upper(out, prefix);
+    fprintf(out, "_MATCHER_H\n#define ");
+    write_upper(out, prefix);
+    fprintf(out, "_MATCHER_H\n\n#include <stddef.h>\n\n");
+
+    fprintf(out, "enum %s_token {\n", prefix);
+    for (size_t i = 0; i < n; i++) {
+        fprintf(out, "    ");
+        write_token(out, prefix, names[i]);
+        fprintf(out, ",  /* ");
+        write_comment(out, patterns[i]);
+        fprintf(out, " */\n");
+    }
+    fprintf(out, "};\n\n#define ");
+    write_upper(out, prefix);
+    fprintf(out, "_NUM_TOKENS %zu\n\n", n);
+
+    fprintf(out, "/* finds the longest token at the beginning of the first `len` characters of\n");
+    fprintf(out, "   `text`, storing it in `token` (the earliest token wins a tie). Returns the\n");
+    fprintf(out, "   length of the token, or -1 if there is none */\n");
+    fprintf(out, "static long %s_match(const char *text, size_t len, int *token) {\n", prefix);
+    fprintf(out, "    const unsigned char *sp = (const unsigned char *) text;\n");
+    fprintf(out, "    const unsigned char *end = sp + len;\n");
+    fprintf(out, "    long match = -1;\n\n");
+
+    if (!accepts)
+        fprintf(out, "    (void) token;\n");
+
+    if (!machine->nstates)
+        fprintf(out, "    (void) end;\n    return match;\n");
+
+    for (int i = 0; i < machine->nstates; i++)
+        write_state(out, machine, i, targeted + 1, prefix, names);
+
+    fprintf(out, "}\n\n#endif\n");
+    free(targeted);
+}
+
+int codegen_write(FILE *out, const char *prefix, const char *const *names, const char *const *patterns, size_t n) {
+    if (!n || !is_identifier(prefix, 0))
+        return 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (!is_identifier(names[i], 1))
+            return 0;
+    }
+
+    // the tokens of the set are the indices of the patterns
+    int *tokens = malloc(n * sizeof(int));
+    for (size_t i = 0; i < n; i++)
+        tokens[i] = i;
+
+    re_set_t *set = re_set_compile(patterns, tokens, n);
+    free(tokens);
+
+    if (!set)
+        return 0;
+
+    // the states must all be alive at once, so the cache is never flushed
+    machine_t *machine = calloc(1, sizeof(machine_t));
+    machine->dfa = set->dfa;
+    machine->dfa->budget = SIZE_MAX;
+
+    const int ok = explore(machine);
+    if (ok)
+        write_machine(out, machine, prefix, names, patterns, n);
+    else
+        fprintf(stderr, "too many states!\n");
+
+    free(machine);
+    re_set_free(set);
+    return ok;
+}
@@ -0,0 +1,315 @@
+#include "dfa.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+dfa_t *dfa_new(const prog_t *prog, size_t budget) {
+    dfa_t *dfa = calloc(1, sizeof(dfa_t));
+    dfa->prog = prog;
+    dfa->budget = budget;
+
+    // each instruction pushes at most two others when it is first marked
+    dfa->set = calloc(prog->len, sizeof(int));
+    dfa->mark = calloc(prog->len, sizeof(int));
+    dfa->stack = calloc(2 * prog->len + 1, sizeof(int));
+
+    for (int pc = 0; pc < prog->len; pc++)
+        dfa->has_bol |= prog->inst[pc].op == OP_BOL;
+
+    return dfa;
+}
+
+/* frees every materialised state, leaving the cache empty */
+static void dfa_flush(dfa_t *dfa) {
+    for (int i = 0; i < DFA_BUCKETS; i++) {
+        dstate_t *state = dfa->buckets[i];
+
+        while (state) {
+            dstate_t *chain = state->chain;
+            free(state);
+            state = chain;
+        }
+
+        dfa->buckets[i] = NULL;
+    }
+
+    dfa->start[0] = dfa->start[1] = NULL;
+    dfa->mem = 0;
+    dfa->nstates = 0;
+    dfa->nflushes++;
+}
+
+void dfa_free(dfa_t *dfa) {
+    if (!dfa) return;
+
+    dfa_flush(dfa);
+    free(dfa->set);
+    free(dfa->mark);
+    free(dfa->stack);
+    free(dfa);
+}
+
+/* starts a new generation of marks, emptying the set being built */
+static void next_gen(dfa_t *dfa) {
+    if (dfa->gen == INT_MAX) {
+        memset(dfa->mark, 0, dfa->prog->len * sizeof(int));
+        dfa->gen = 0;
+    }
+
+    dfa->gen++;
+}
+
+/* adds every instruction reachable from `pc` without consuming input to the
+   set, where `^` matches if `bol` */
+static void add_closure(dfa_t *dfa, int pc, int bol, int *n) {
+    int top = 0;
+    dfa->stack[top++] = pc;
+
+    while (top) {
+        pc = dfa->stack[--top];
+
+        if (dfa->mark[pc] == dfa->gen)
+            continue;
+        dfa->mark[pc] = dfa->gen;
+
+        const inst_t *inst = &dfa->prog->inst[pc];
+        switch (inst->op) {
+            case OP_JMP:
+                dfa->stack[top++] = inst->x;
+                break;
+            case OP_SPLIT:
+                dfa->stack[top++] = inst->y;
+                dfa->stack[top++] = inst->x;
+                break;
+            case OP_SAVE:
+                dfa->stack[top++] = pc + 1;
+                break;
+            case OP_BOL:
+                if (bol)
+                    dfa->stack[top++] = pc + 1;
+                break;
+            case OP_FAIL:
+                break;
+            default:
+                // consuming instructions, OP_EOL (resolved at the end of
+                // the input) and OP_MATCH are kept in the set
+                dfa->set[(*n)++] = pc;
+                break;
+        }
+    }
+}
+
+/* returns the lowest token of the OP_MATCHes reachable from `pc` at the
+   end of the input (which is also its beginning if `bol`), or -1 if there
+   are none */
+static int matches_at_end(dfa_t *dfa, int pc, int bol) {
+    int token = -1;
+    int top = 0;
+    dfa->stack[top++] = pc;
+    next_gen(dfa);
+
+    while (top) {
+        pc = dfa->stack[--top];
+
+        if (dfa->mark[pc] == dfa->gen)
+            continue;
+        dfa->mark[pc] = dfa->gen;
+
+        const inst_t *inst = &dfa->prog->inst[pc];
+        switch (inst->op) {
+            case OP_MATCH:
+                if (token < 0 || inst->x < token)
+                    token = inst->x;
+                break;
+            case OP_JMP:
+                dfa->stack[top++] = inst->x;
+                break;
+            case OP_SPLIT:
+                dfa->stack[top++] = inst->y;
+                dfa->stack[top++] = inst->x;
+                break;
+            case OP_BOL:
+                if (bol)
+                    dfa->stack[top++] = pc + 1;
+                break;
+            case OP_EOL:
+            case OP_SAVE:
+                dfa->stack[top++] = pc + 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return token;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+/* FNV-1a hash of a set of instructions */
+static size_t hash_set(const int *set, int n, int bol) {
+    size_t hash = 2166136261u ^ (size_t) bol;
+
+    for (int i = 0; i < n; i++) {
+        hash ^= (size_t) set[i];
+        hash *= 16777619u;
+    }
+
+    return hash % DFA_BUCKETS;
+}
+
+/* returns the state for the first `n` instructions of the set being built,
+   materialising it (and flushing the cache if needed) if it is new. Only a
+   start state is at the beginning of the input (`bol`), which `^` after a
+   `$` tells apart from the same set later on */
+static dstate_t *find_state(dfa_t *dfa, int n, int bol) {
+    qsort(dfa->set, n, sizeof(int), compare_ints);
+
+    size_t hash = hash_set(dfa->set, n, bol);
+    for (dstate_t *state = dfa->buckets[hash]; state; state = state->chain) {
+        if (state->n == n && state->bol == bol && !memcmp(state->pcs, dfa->set, n * sizeof(int)))
+            return state;
+    }
+
+    const size_t size = sizeof(dstate_t) + n * sizeof(int);
+    if (dfa->nstates && dfa->mem + size > dfa->budget)
+        dfa_flush(dfa);
+
+    dstate_t *state = calloc(1, size);
+    state->n = n;
+    state->bol = bol;
+    memcpy(state->pcs, dfa->set, n * sizeof(int));
+
+    // `matches_at_end` reuses the marks, so only read from the state from here on
+    state->token = state->token_eol = -1;
+    for (int i = 0; i < n; i++) {
+        const inst_t *inst = &dfa->prog->inst[state->pcs[i]];
+        int token = -1;
+
+        if (inst->op == OP_MATCH) {
+            token = inst->x;
+            if (state->token < 0 || token < state->token)
+                state->token = token;
+        } else if (inst->op == OP_EOL) {
+            token = matches_at_end(dfa, state->pcs[i], bol);
+        }
+
+        // whatever matches now also matches at the end of the input
+        if (token >= 0 && (state->token_eol < 0 || token < state->token_eol))
+            state->token_eol = token;
+    }
+
+    state->accept = state->token >= 0;
+    state->accept_eol = state->token_eol >= 0;
+
+    state->chain = dfa->buckets[hash];
+    dfa->buckets[hash] = state;
+    dfa->mem += size;
+    dfa->nstates++;
+
+    return state;
+}
+
+/* returns the start state at the beginning of the input if `bol` (or past
+   it if not), materialising it if needed */
+static dstate_t *start_state(dfa_t *dfa, int bol) {
+    // without a `^`, the beginning is like anywhere else
+    bol = bol && dfa->has_bol;
+
+    if (!dfa->start[bol]) {
+        int n = 0;
+        next_gen(dfa);
+        add_closure(dfa, 0, bol, &n);
+        dfa->start[bol] = find_state(dfa, n, bol);
+    }
+
+    return dfa->start[bol];
+}
+
+/* computes (and caches) the transition out of `state` on `ch` */
+static dstate_t *step(dfa_t *dfa, dstate_t *state, unsigned char ch) {
+    int n = 0;
+    next_gen(dfa);
+    dfa->nsteps++;
+
+    for (int i = 0; i < state->n; i++) {
+        const int pc = state->pcs[i];
+
+        if (nfa_accepts(&dfa->prog->inst[pc], ch))
+            add_closure(dfa, pc + 1, 0, &n);
+    }
+
+    // an unanchored search may begin again at every position
+    if (!dfa->prog->anchored)
+        add_closure(dfa, 0, 0, &n);
+
+    const size_t nflushes = dfa->nflushes;
+    dstate_t *next = find_state(dfa, n, 0);
+
+    // a flush frees `state`, so only cache the transition if it survived
+    if (dfa->nflushes == nflushes)
+        state->next[ch] = next;
+
+    return next;
+}
+
+dstate_t *dfa_start(dfa_t *dfa) {
+    return start_state(dfa, 1);
+}
+
+dstate_t *dfa_next(dfa_t *dfa, dstate_t *state, unsigned char ch) {
+    return state->next[ch] ? state->next[ch] : step(dfa, state, ch);
+}
+
+int dfa_is_match(dfa_t *dfa, const char *text, const char *end, int bol) {
+    const unsigned char *sp = (const unsigned char *) text;
+    const unsigned char *ep = (const unsigned char *) end;
+    dstate_t *state = start_state(dfa, bol);
+
+    // stop as soon as we match, or when no thread is left alive
+    while (sp < ep && !state->accept && state->n) {
+        dstate_t *next = state->next[*sp];
+        state = next ? next : step(dfa, state, *sp);
+        sp++;
+    }
+
+#ifdef RE_STATS
+    dfa->nbytes += sp - (const unsigned char *) text;
+#endif
+
+    return state->accept || (sp == ep && state->accept_eol);
+}
+
+long dfa_longest(dfa_t *dfa, const char *text, const char *end, int *token) {
+    const unsigned char *sp = (const unsigned char *) text;
+    const unsigned char *ep = (const unsigned char *) end;
+    dstate_t *state = start_state(dfa, 1);
+    long len = -1;
+
+    // remember the last (and so longest) match until no thread is left alive
+    while (sp < ep && state->n) {
+        if (state->accept) {
+            len = sp - (const unsigned char *) text;
+            *token = state->token;
+        }
+
+        dstate_t *next = state->next[*sp];
+        state = next ? next : step(dfa, state, *sp);
+        sp++;
+    }
+
+#ifdef RE_STATS
+    dfa->nbytes += sp - (const unsigned char *) text;
+#endif
+
+    // a dead state never accepts, so only the end of the input is left
+    if (sp == ep && state->accept_eol) {
+        len = sp - (const unsigned char *) text;
+        *token = state->token_eol;
+    }
+
+    return len;
+}
@@ -0,0 +1,481 @@
+#define _DEFAULT_SOURCE 1
+
+#include "jit.h"
+#include "ccl.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* appends the bytes of an instruction to the code */
+#define EMIT(e, ...) do { \
+    static const unsigned char bytes_[] = { __VA_ARGS__ }; \
+    emit_bytes(e, bytes_, sizeof(bytes_)); \
+} while (0)
+
+/* the condition codes of `jcc` */
+#define CC_B  0x2
+#define CC_AE 0x3
+#define CC_E  0x4
+#define CC_NE 0x5
+
+/**
+ * @brief the registers of the generated code
+ * --------
+ *      rdi     the text being matched
+ *      rsi     the end of the text
+ *      rbx     the program's classes
+ *      rax     the result of a block (and scratch)
+ *      rcx     scratch for the class tests
+ *      rdx     the count of a `{m,n}`
+ *
+ * Each instruction the interpreter may start at is a block, which returns
+ * the end of the match (or NULL) in rax like `match_here`. A quantifier
+ * tries the rest of the pattern by calling the block after it
+ */
+
+/* what the class of an instruction consumes, which decides its test */
+typedef enum class_kind {
+    CLASS_NONE, CLASS_BYTE, CLASS_ALL, CLASS_SET
+} class_kind_t;
+
+/***********************************
+ *        Emitter Structures       *
+ ***********************************/
+typedef struct fixup {
+    size_t at;              /* where the rel32 is in the code */
+    int    label;           /* the label it jumps to */
+} fixup_t;
+
+typedef struct emitter {
+    unsigned char *code;    /* the code emitted so far */
+    size_t         len;     /* the length of the code */
+    size_t         cap;     /* the capacity of `code` */
+    long          *labels;  /* the offset of each label, or -1 if unbound */
+    int            nlabels; /* the number of labels */
+    int            label_cap; /* the capacity of `labels` */
+    fixup_t       *fixups;  /* the jumps to patch once every label is bound */
+    size_t         nfixups; /* the number of fixups */
+    size_t         fixup_cap; /* the capacity of `fixups` */
+} emitter_t;
+
+static void emit_bytes(emitter_t *e, const unsigned char *bytes, size_t n) {
+    if (e->len + n > e->cap) {
+        while (e->len + n > e->cap)
+            e->cap = e->cap ? 2 * e->cap : 4096;
+        e->code = realloc(e->code, e->cap);
+    }
+
+    memcpy(e->code + e->len, bytes, n);
+    e->len += n;
+}
+
+static void emit32(emitter_t *e, uint32_t x) {
+    const unsigned char bytes[] = { x, x >> 8, x >> 16, x >> 24 };
+    emit_bytes(e, bytes, sizeof(bytes));
+}
+
+static void emit64(emitter_t *e, uint64_t x) {
+    emit32(e, x);
+    emit32(e, x >> 32);
+}
+
+static int new_label(emitter_t *e) {
+    if (e->nlabels == e->label_cap) {
+        e->label_cap = e->label_cap ? 2 * e->label_cap : 64;
+        e->labels = realloc(e->labels, e->label_cap * sizeof(long));
+    }
+
+    e->labels[e->nlabels] = -1;
+    return e->nlabels++;
+}
+
+static void bind(emitter_t *e, int label) {
+    e->labels[label] = e->len;
+}
+
+/* emits a rel32 to the label, patched once the label is bound */
+static void emit_rel32(emitter_t *e, int label) {
+    if (e->nfixups == e->fixup_cap) {
+        e->fixup_cap = e->fixup_cap ? 2 * e->fixup_cap : 64;
+        e->fixups = realloc(e->fixups, e->fixup_cap * sizeof(fixup_t));
+    }
+
+    e->fixups[e->nfixups++] = (fixup_t) { e->len, label };
+    emit32(e, 0);
+}
+
+static void emit_jmp(emitter_t *e, int label) {
+    EMIT(e, 0xE9);
+    emit_rel32(e, label);
+}
+
+static void emit_jcc(emitter_t *e, int cc, int label) {
+    EMIT(e, 0x0F);
+    emit_bytes(e, &(unsigned char) { 0x80 | cc }, 1);
+    emit_rel32(e, label);
+}
+
+static void emit_call(emitter_t *e, int label) {
+    EMIT(e, 0xE8);
+    emit_rel32(e, label);
+}
+
+/***********************************
+ *          Code Generation        *
+ ***********************************/
+
+/* returns what the class consumes, storing the byte of a CLASS_BYTE */
+static class_kind_t class_kind(const re_class_t class, int *byte) {
+    int n = 0;
+
+    for (int ch = 0; ch < 256; ch++) {
+        if ((class[ch >> 3] >> (ch & 7)) & 1) {
+            *byte = ch;
+            n++;
+        }
+    }
+
+    return !n ? CLASS_NONE : n == 1 ? CLASS_BYTE : n == 256 ? CLASS_ALL : CLASS_SET;
+}
+
+/* jumps to `miss` unless the byte at rdi + `disp` is in the class. The byte
+   must be before the end of the text */
+static void emit_test(emitter_t *e, const re_code_t *code, int cl, int32_t disp, int miss) {
+    int byte;
+
+    switch (class_kind(code->classes[cl], &byte)) {
+        case CLASS_NONE:
+            emit_jmp(e, miss);
+            break;
+
+        case CLASS_BYTE:
+            EMIT(e, 0x80, 0xBF);                    // cmp byte [rdi + disp32], imm8
+            emit32(e, disp);
+            emit_bytes(e, &(unsigned char) { byte }, 1);
+            emit_jcc(e, CC_NE, miss);
+            break;
+
+        case CLASS_ALL:
+            break;
+
+        case CLASS_SET:
+            EMIT(e, 0x0F, 0xB6, 0x87);              // movzx eax, byte [rdi + disp32]
+            emit32(e, disp);
+            EMIT(e, 0x89, 0xC1,                     // mov ecx, eax
+                    0xC1, 0xE9, 0x03,               // shr ecx, 3
+                    0x0F, 0xB6, 0x8C, 0x0B);        // movzx ecx, byte [rbx + rcx + disp32]
+            emit32(e, cl * sizeof(re_class_t));
+            EMIT(e, 0x83, 0xE0, 0x07,               // and eax, 7
+                    0x0F, 0xA3, 0xC1);              // bt ecx, eax
+            emit_jcc(e, CC_AE, miss);
+            break;
+    }
+}
+
+/* jumps to `miss` unless the `len` bytes at rdi + `disp` are `lit`, comparing
+   eight at a time. The bytes must be before the end of the text */
+static void emit_string(emitter_t *e, const char *lit, int len, int32_t disp, int miss) {
+    int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word = 0;
+        for (int j = 7; j >= 0; j--)
+            word = word << 8 | (unsigned char) lit[i + j];
+
+        EMIT(e, 0x48, 0xB8);                        // mov rax, imm64
+        emit64(e, word);
+        EMIT(e, 0x48, 0x39, 0x87);                  // cmp [rdi + disp32], rax
+        emit32(e, disp + i);
+        emit_jcc(e, CC_NE, miss);
+    }
+
+    for (; i < len; i++) {
+        EMIT(e, 0x80, 0xBF);                        // cmp byte [rdi + disp32], imm8
+        emit32(e, disp + i);
+        emit_bytes(e, &(unsigned char) { lit[i] }, 1);
+        emit_jcc(e, CC_NE, miss);
+    }
+}
+
+/* jumps to `miss` if fewer than `n` bytes are left */
+static void emit_bounds(emitter_t *e, int n, int miss) {
+    if (n == 1) {
+        EMIT(e, 0x48, 0x39, 0xF7);                  // cmp rdi, rsi
+        emit_jcc(e, CC_AE, miss);
+        return;
+    }
+
+    EMIT(e, 0x48, 0x89, 0xF0,                       // mov rax, rsi
+            0x48, 0x29, 0xF8,                       // sub rax, rdi
+            0x48, 0x3D);                            // cmp rax, imm32
+    emit32(e, n);
+    emit_jcc(e, CC_B, miss);
+}
+
+/* matches one byte of the class, jumping to `miss` if it cannot */
+static void emit_consume(emitter_t *e, const re_code_t *code, int cl, int miss) {
+    emit_bounds(e, 1, miss);
+    emit_test(e, code, cl, 0, miss);
+    EMIT(e, 0x48, 0xFF, 0xC7);                      // inc rdi
+}
+
+/* returns true if the instruction is matched on its own, one byte at a time */
+static int is_plain(const re_inst_t *inst) {
+    return inst[0].type != TERMINAL && inst[1].type != STAR && inst[1].type != PLUS &&
+           inst[1].type != REPEAT && inst[1].type != OPTIONAL &&
+           !(inst[0].type == END && inst[1].type == TERMINAL);
+}
+
+/* the possessive run of `c*` or `c+` (see `ccl_annotate`): the scanner skips
+   the run, and the rest of the pattern follows */
+static void emit_run(emitter_t *e, const re_code_t *code, const re_inst_t *c) {
+    EMIT(e, 0x55,                                   // push rbp
+            0x48, 0x89, 0xE5,                       // mov rbp, rsp
+            0x48, 0x83, 0xE4, 0xF0,                 // and rsp, -16
+            0x56,                                   // push rsi
+            0x57,                                   // push rdi
+            0x48, 0x89, 0xF2,                       // mov rdx, rsi
+            0x48, 0x89, 0xFE,                       // mov rsi, rdi
+            0x48, 0xBF);                            // mov rdi, imm64
+    emit64(e, (uintptr_t) &code->runs[c->run - 1]);
+    EMIT(e, 0x48, 0xB8);                            // mov rax, imm64
+    emit64(e, (uintptr_t) ccl_span);
+    EMIT(e, 0xFF, 0xD0,                             // call rax
+            0x5F,                                   // pop rdi
+            0x5E,                                   // pop rsi
+            0x48, 0x89, 0xEC,                       // mov rsp, rbp
+            0x5D,                                   // pop rbp
+            0x48, 0x89, 0xC7);                      // mov rdi, rax
+}
+
+/* the lazy loop of `c*`: try the rest of the pattern (the block at `rest`)
+   before every extra repetition. With `counted`, rdx bounds the repetitions */
+static void emit_lazy(emitter_t *e, const re_code_t *code, const re_inst_t *c, int rest, int counted, int fail, int done) {
+    const int loop = new_label(e);
+    bind(e, loop);
+
+    if (counted)
+        EMIT(e, 0x57, 0x52);                        // push rdi; push rdx
+    else
+        EMIT(e, 0x57);                              // push rdi
+
+    emit_call(e, rest);
+
+    if (counted)
+        EMIT(e, 0x5A, 0x5F);                        // pop rdx; pop rdi
+    else
+        EMIT(e, 0x5F);                              // pop rdi
+
+    EMIT(e, 0x48, 0x85, 0xC0);                      // test rax, rax
+    emit_jcc(e, CC_NE, done);
+
+    if (counted) {
+        EMIT(e, 0x48, 0x85, 0xD2);                  // test rdx, rdx
+        emit_jcc(e, CC_E, fail);
+        EMIT(e, 0x48, 0xFF, 0xCA);                  // dec rdx
+    }
+
+    emit_consume(e, code, c->cl, fail);
+    emit_jmp(e, loop);
+}
+
+/* the `?` of `c?`: try the rest of the pattern (the block at `rest`) after
+   one `c` if there is one, and otherwise fall through to it without */
+static void emit_optional(emitter_t *e, const re_code_t *code, const re_inst_t *c, int rest, int done) {
+    const int skip = new_label(e);
+
+    emit_bounds(e, 1, skip);
+    emit_test(e, code, c->cl, 0, skip);
+
+    EMIT(e, 0x57,                                   // push rdi
+            0x48, 0xFF, 0xC7);                      // inc rdi
+    emit_call(e, rest);
+    EMIT(e, 0x5F,                                   // pop rdi
+            0x48, 0x85, 0xC0);                      // test rax, rax
+    emit_jcc(e, CC_NE, done);
+
+    bind(e, skip);
+}
+
+/* emits a block for every instruction `match_here` reaches from `start`,
+   in the same order of checks. Returns false on an instruction the
+   interpreter rejects */
+static int emit_program(emitter_t *e, const re_code_t *code, int start, int fail, int done) {
+    for (int i = start; ; ) {
+        const re_inst_t *inst = &code->inst[i];
+        bind(e, i);
+
+        if (inst[0].type == TERMINAL) {
+            EMIT(e, 0x48, 0x89, 0xF8,               // mov rax, rdi
+                    0xC3);                          // ret
+            return 1;
+        }
+
+        if (inst[1].type == STAR || inst[1].type == PLUS) {
+            // `match_kleene` only repeats atoms
+            if (inst[0].type != CHAR && inst[0].type != DOT && inst[0].type != CHAR_CLASS)
+                return 0;
+
+            if (inst[1].type == PLUS)
+                emit_consume(e, code, inst[0].cl, fail);
+
+            if (inst[0].run)
+                emit_run(e, code, inst);
+            else
+                emit_lazy(e, code, inst, i + 2, 0, fail, done);
+
+            i += 2;
+            continue;
+        }
+
+        if (inst[0].type == END && inst[1].type == TERMINAL) {
+            EMIT(e, 0x48, 0x39, 0xF7);              // cmp rdi, rsi
+            emit_jcc(e, CC_NE, fail);
+            EMIT(e, 0x48, 0x89, 0xF8,               // mov rax, rdi
+                    0xC3);                          // ret
+            return 1;
+        }
+
+        if (inst[1].type == REPEAT) {
+            if (inst[1].c) {
+                const int loop = new_label(e);
+                EMIT(e, 0xBA);                      // mov edx, imm32
+                emit32(e, inst[1].c);
+                bind(e, loop);
+                emit_consume(e, code, inst[0].cl, fail);
+                EMIT(e, 0x48, 0xFF, 0xCA);          // dec rdx
+                emit_jcc(e, CC_NE, loop);
+            }
+
+            // without repetitions left to try, the rest simply follows
+            if (inst[1].run != inst[1].c) {
+                EMIT(e, 0x48, 0xC7, 0xC2);          // mov rdx, imm32
+                emit32(e, inst[1].run == USHRT_MAX ? UINT32_MAX : (uint32_t) (inst[1].run - inst[1].c));
+                emit_lazy(e, code, inst, i + 2, 1, fail, done);
+            }
+
+            i += 2;
+            continue;
+        }
+
+        if (inst[1].type == OPTIONAL) {
+            emit_optional(e, code, inst, i + 2, done);
+            i += 2;
+            continue;
+        }
+
+        // a run of single bytes (and strings) is checked against the end of
+        // the text once
+        int n = 0, width = 0;
+        for (; is_plain(&inst[n]); n++)
+            width += inst[n].type == STRING ? inst[n].run : 1;
+
+        emit_bounds(e, width, fail);
+        for (int j = 0, disp = 0; j < n; j++) {
+            if (inst[j].type == STRING) {
+                emit_string(e, code->lits + inst[j].cl, inst[j].run, disp, fail);
+                disp += inst[j].run;
+            } else {
+                emit_test(e, code, inst[j].cl, disp++, fail);
+            }
+        }
+
+        EMIT(e, 0x48, 0x81, 0xC7);                  // add rdi, imm32
+        emit32(e, width);
+        i += n;
+    }
+}
+
+/* patches every jump, and copies the code into executable pages */
+static jit_t *finish(emitter_t *e) {
+    for (size_t i = 0; i < e->nfixups; i++) {
+        const fixup_t *fix = &e->fixups[i];
+        const int32_t rel = e->labels[fix->label] - (long) (fix->at + 4);
+        const unsigned char bytes[] = { rel, rel >> 8, rel >> 16, rel >> 24 };
+        memcpy(e->code + fix->at, bytes, 4);
+    }
+
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t size = (e->len + page - 1) / page * page;
+
+    // the pages are never writable and executable at once
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
+
+    memcpy(mem, e->code, e->len);
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC)) {
+        munmap(mem, size);
+        return NULL;
+    }
+
+    jit_t *jit = malloc(sizeof(jit_t));
+    jit->mem = mem;
+    jit->size = size;
+    memcpy(&jit->match, &mem, sizeof(jit_fn_t));
+
+    return jit;
+}
+
+jit_t *jit_compile(const re_code_t *code, int start) {
+    emitter_t e = {0};
+
+    // every instruction has a label, followed by the shared exits
+    int len = 0;
+    while (code->inst[len].type != TERMINAL)
+        len++;
+    for (int i = 0; i <= len; i++)
+        new_label(&e);
+
+    const int fail = new_label(&e), done = new_label(&e);
+
+    EMIT(&e, 0x53,                                  // push rbx
+             0x48, 0xBB);                           // mov rbx, imm64
+    emit64(&e, (uintptr_t) code->classes);
+    emit_call(&e, start);
+    EMIT(&e, 0x5B,                                  // pop rbx
+             0xC3);                                 // ret
+
+    bind(&e, fail);
+    EMIT(&e, 0x31, 0xC0);                           // xor eax, eax
+    bind(&e, done);
+    EMIT(&e, 0xC3);                                 // ret
+
+    jit_t *jit = emit_program(&e, code, start, fail, done) ? finish(&e) : NULL;
+
+    free(e.code);
+    free(e.labels);
+    free(e.fixups);
+    return jit;
+}
+
+void jit_free(jit_t *jit) {
+    if (!jit) return;
+
+    munmap(jit->mem, jit->size);
+    free(jit);
+}
+
+#else
+
+jit_t *jit_compile(const re_code_t *code, int start) {
+    (void) code;
+    (void) start;
+    return NULL;
+}
+
+void jit_free(jit_t *jit) {
+    (void) jit;
+}
+
+#endif
@@ -0,0 +1,767 @@
+#include "nfa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IS_QUANTIFIER(x) \
+    ((x) == STAR || (x) == PLUS || (x) == OPTIONAL)
+
+/* the sizes of nested repetitions multiply, so they are only counted up to
+   just past the limit */
+#define SATURATE(x) ((x) > NFA_MAX_LEN ? NFA_MAX_LEN + 1 : (x))
+
+/***********************************
+ *          VM Structures          *
+ ***********************************/
+typedef struct thread {
+    int         pc;         /* the instruction the thread is waiting on */
+    size_t      start;      /* the offset where the thread's match began */
+} thread_t;
+
+typedef struct threadlist {
+    thread_t    *t;         /* the threads, in priority order */
+    int         *sparse;    /* index of each pc in `t` (sparse set) */
+    int          n;         /* the number of threads */
+    const char **caps;      /* the capture slots of each thread in `t`, if capturing */
+} threadlist_t;
+
+/* the memory a search runs in, which is allocated by the first search that
+   needs it and kept for the next */
+struct nfa_scratch {
+    thread_t    *threads;   /* the threads of both lists */
+    int         *ints;      /* the sparse sets of both lists, and the stack */
+    const char **slots;     /* the capture slots of both lists and of a new thread,
+                               then the values to restore (NULL until a search captures) */
+};
+
+/* the stack `add_thread` follows jumps with. A negative entry restores the
+   capture slot `-pc - 1` to the value at the same height of `old` */
+typedef struct vmstack {
+    int         *pc;        /* the instructions to add, or the slots to restore */
+    const char **old;       /* the values to restore (only if capturing) */
+} vmstack_t;
+
+/* appends an instruction to the program, returning its index */
+static int emit(prog_t *prog, op_t op) {
+    prog->inst[prog->len].op = op;
+    return prog->len++;
+}
+
+/* emits the instruction that consumes (or asserts) a single `re_t` */
+static void emit_atom(prog_t *prog, const re_t *atom) {
+    int pc;
+
+    switch (atom->type) {
+        case CHAR:
+            pc = emit(prog, OP_CHAR);
+            prog->inst[pc].c = (unsigned char) atom->class.c;
+            break;
+        case DOT:
+            emit(prog, OP_ANY);
+            break;
+        case CHAR_CLASS:
+            pc = emit(prog, OP_CLASS);
+            prog->inst[pc].cl = atom;
+            break;
+        case BEGIN:
+            emit(prog, OP_BOL);
+            break;
+        case END:
+            emit(prog, OP_EOL);
+            break;
+        default:
+            // a metacharacter out of place can never match
+            emit(prog, OP_FAIL);
+            break;
+    }
+}
+
+static void compile_branches(prog_t *prog, const re_t *reg, int skip);
+
+/* emits a single atom or group, followed by `quantifier` (`*`, `+`, `?` or
+   anything else for none) */
+static void emit_piece(prog_t *prog, const re_t *piece, class_t quantifier) {
+    int split, loop;
+
+    if (piece->type == BEGIN_GROUP) {
+        const int group = piece->class.c;
+
+        // the split of L1 comes before the group
+        loop = prog->len;
+        if (quantifier == STAR || quantifier == OPTIONAL)
+            emit(prog, OP_SPLIT);
+
+        prog->inst[emit(prog, OP_SAVE)].x = 2 * (group - 1);
+        compile_branches(prog, piece + 1, 0);
+        prog->inst[emit(prog, OP_SAVE)].x = 2 * (group - 1) + 1;
+    } else {
+        loop = prog->len;
+        if (quantifier == STAR || quantifier == OPTIONAL)
+            emit(prog, OP_SPLIT);
+
+        emit_atom(prog, piece);
+    }
+
+    switch (quantifier) {
+        // L1: split L3, L2; L2: piece; jmp L1; L3:
+        case STAR:
+            prog->inst[emit(prog, OP_JMP)].x = loop;
+            prog->inst[loop].x = prog->len;
+            prog->inst[loop].y = loop + 1;
+            break;
+
+        // L1: piece; split L2, L1; L2:
+        case PLUS:
+            split = emit(prog, OP_SPLIT);
+            prog->inst[split].x = prog->len;
+            prog->inst[split].y = loop;
+            break;
+
+        // split L1, L2; L1: piece; L2:
+        case OPTIONAL:
+            prog->inst[loop].x = loop + 1;
+            prog->inst[loop].y = prog->len;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief emits a piece repeated between `rep->class.rep.min` and `max`
+ *        times. The Pike VM has nowhere to keep a count, so the piece is
+ *        copied: `min` times, then either once more in a loop, or `max - min`
+ *        more times, each of which prefers to stop (like `*`):
+ *        piece; ...; split L3, L1; L1: piece; split L3, L2; L2: piece; L3:
+ *        `nfa_size` keeps the copies within NFA_MAX_LEN
+ */
+static void emit_repeat(prog_t *prog, const re_t *piece, const re_t *rep) {
+    const int min = rep->class.rep.min, max = rep->class.rep.max;
+
+    for (int i = 0; i < min; i++)
+        emit_piece(prog, piece, TERMINAL);
+
+    if (max == REPEAT_INF) {
+        emit_piece(prog, piece, STAR);
+        return;
+    }
+
+    // each split's way out is chained through `x` until the end is known
+    int last = -1;
+    for (int i = min; i < max; i++) {
+        const int split = emit(prog, OP_SPLIT);
+        prog->inst[split].x = last;
+        prog->inst[split].y = split + 1;
+        last = split;
+
+        emit_piece(prog, piece, TERMINAL);
+    }
+
+    while (last >= 0) {
+        const int next = prog->inst[last].x;
+        prog->inst[last].x = prog->len;
+        last = next;
+    }
+}
+
+/* returns the `re_t` after the atom or group `piece` */
+static const re_t *piece_end(const re_t *piece) {
+    return piece->type == BEGIN_GROUP ? re_group_end(piece) + 1 : piece + 1;
+}
+
+/* emits the atoms (and groups) in [reg, end), which has no `|` of its own */
+static void compile_sequence(prog_t *prog, const re_t *reg, const re_t *end) {
+    while (reg < end) {
+        // a quantifier must follow an atom (or a group)
+        const re_t *after = piece_end(reg);
+
+        if (after->type == REPEAT) {
+            emit_repeat(prog, reg, after);
+            reg = after + 1;
+        } else if (IS_QUANTIFIER(after->type)) {
+            emit_piece(prog, reg, after->type);
+            reg = after + 1;
+        } else {
+            emit_piece(prog, reg, TERMINAL);
+            reg = after;
+        }
+    }
+}
+
+/* returns true if the alternative [reg, end) begins with a literal
+   character that is matched exactly once */
+static int begins_with_char(const re_t *reg, const re_t *end) {
+    return reg < end && reg[0].type == CHAR && !IS_QUANTIFIER(reg[1].type) && reg[1].type != REPEAT;
+}
+
+/**
+ * @brief emits the alternatives [begins[i], ends[i]) in priority order:
+ *        split L1, L2; L1: alt 1; jmp L3; L2: alt 2; L3:
+ *        Neighbouring alternatives that begin with the same character share
+ *        a single instruction for it, so `if|in|int` is compiled as
+ *        `i(f|n|nt)` and then `i(f|n(|t))`. Only neighbours are merged, so
+ *        the alternatives keep their priorities
+ */
+static void compile_alternatives(prog_t *prog, const re_t **begins, const re_t **ends, int n) {
+    int *jumps = malloc(n * sizeof(int));
+    int njumps = 0;
+
+    for (int i = 0, j; i < n; i = j) {
+        // the alternatives from `i` to `j` share their first character
+        j = i + 1;
+        if (begins_with_char(begins[i], ends[i])) {
+            while (j < n && begins_with_char(begins[j], ends[j]) && begins[j]->class.c == begins[i]->class.c)
+                j++;
+        }
+
+        // every alternative but the last may be skipped in favour of the rest
+        int split = -1;
+        if (j < n) {
+            split = emit(prog, OP_SPLIT);
+            prog->inst[split].x = split + 1;
+        }
+
+        if (j - i > 1) {
+            emit_atom(prog, begins[i]);
+
+            const re_t **tails = malloc((j - i) * sizeof(const re_t *));
+            for (int k = i; k < j; k++)
+                tails[k - i] = begins[k] + 1;
+
+            compile_alternatives(prog, tails, ends + i, j - i);
+            free(tails);
+        } else {
+            compile_sequence(prog, begins[i], ends[i]);
+        }
+
+        if (split >= 0) {
+            jumps[njumps++] = emit(prog, OP_JMP);
+            prog->inst[split].y = prog->len;
+        }
+    }
+
+    // every alternative continues after the last one
+    for (int i = 0; i < njumps; i++)
+        prog->inst[jumps[i]].x = prog->len;
+
+    free(jumps);
+}
+
+/* emits the alternatives from `reg` up to the END_GROUP or TERMINAL that
+   ends the last one, leaving out the first `skip` `re_t`s of each */
+static void compile_branches(prog_t *prog, const re_t *reg, int skip) {
+    int n = 1;
+    for (const re_t *alt = re_alternative_end(reg); alt->type == ALTERNATE; alt = re_alternative_end(alt + 1))
+        n++;
+
+    const re_t **begins = malloc(2 * n * sizeof(const re_t *));
+    const re_t **ends = begins + n;
+    for (int i = 0; i < n; i++) {
+        begins[i] = reg + skip;
+        ends[i] = re_alternative_end(reg);
+        reg = ends[i] + 1;
+    }
+
+    compile_alternatives(prog, begins, ends, n);
+    free(begins);
+}
+
+static size_t branches_size(const re_t *reg);
+
+/* returns the most instructions [reg, end) compiles to, or more than
+   NFA_MAX_LEN if that is too many */
+static size_t sequence_size(const re_t *reg, const re_t *end) {
+    size_t size = 0;
+
+    while (reg < end && size <= NFA_MAX_LEN) {
+        const re_t *after = piece_end(reg);
+
+        // a group saves where it begins and ends
+        size_t piece = reg->type == BEGIN_GROUP ? SATURATE(branches_size(reg + 1) + 2) : 1;
+
+        if (after->type == REPEAT) {
+            // the copies, plus a loop (two instructions) or a split per optional copy
+            const size_t min = after->class.rep.min, max = after->class.rep.max;
+            piece = after->class.rep.max == REPEAT_INF ? (min + 1) * piece + 2 : min * piece + (max - min) * (piece + 1);
+            after++;
+        } else if (IS_QUANTIFIER(after->type)) {
+            piece += after->type == STAR ? 2 : 1;
+            after++;
+        }
+
+        size += piece;
+        reg = after;
+    }
+
+    return SATURATE(size);
+}
+
+/* returns the most instructions the alternatives from `reg` compile to
+   (see `compile_branches`), or more than NFA_MAX_LEN if that is too many */
+static size_t branches_size(const re_t *reg) {
+    size_t size = 0;
+
+    while (size <= NFA_MAX_LEN) {
+        const re_t *end = re_alternative_end(reg);
+        size += sequence_size(reg, end);
+
+        if (end->type != ALTERNATE)
+            break;
+
+        // a split before the alternative and a jump after it
+        size += 2;
+        reg = end + 1;
+    }
+
+    return SATURATE(size);
+}
+
+prog_t *nfa_compile(const re_t *reg, arena_t *arena) {
+    // copies of repeated pieces could make the program far larger than the pattern
+    const size_t size = branches_size(reg) + 1;
+    if (size > NFA_MAX_LEN)
+        return NULL;
+
+    prog_t *prog = arena_calloc(arena, 1, sizeof(prog_t));
+    prog->inst = arena_calloc(arena, size, sizeof(inst_t));
+
+    // each group saves where it begins and ends
+    prog->nslots = 2 * re_count_groups(reg);
+
+    // the `^` every alternative begins with is implied by anchoring
+    prog->anchored = re_anchored(reg);
+
+    compile_branches(prog, reg, prog->anchored);
+
+    emit(prog, OP_MATCH);
+    return prog;
+}
+
+prog_t *nfa_union(prog_t *const *progs, size_t n, arena_t *arena) {
+    // one split in front of every program but the last
+    int len = n - 1;
+    for (size_t i = 0; i < n; i++)
+        len += progs[i]->len;
+
+    prog_t *prog = arena_calloc(arena, 1, sizeof(prog_t));
+    prog->inst = arena_calloc(arena, len, sizeof(inst_t));
+    prog->anchored = 1;
+
+    for (size_t i = 0; i < n; i++) {
+        if (progs[i]->nslots > prog->nslots)
+            prog->nslots = progs[i]->nslots;
+    }
+
+    // L0: split P0, L1; L1: split P1, L2; ... Pn-1
+    for (size_t i = 0; i < n; i++) {
+        int split = -1;
+        if (i + 1 < n)
+            split = emit(prog, OP_SPLIT);
+
+        const int base = prog->len;
+        for (int pc = 0; pc < progs[i]->len; pc++) {
+            inst_t *inst = &prog->inst[prog->len++];
+            *inst = progs[i]->inst[pc];
+
+            if (inst->op == OP_JMP || inst->op == OP_SPLIT) {
+                inst->x += base;
+                inst->y += base;
+            } else if (inst->op == OP_MATCH) {
+                inst->x = i;
+            }
+        }
+
+        if (split >= 0) {
+            prog->inst[split].x = split + 1;
+            prog->inst[split].y = prog->len;
+        }
+    }
+
+    return prog;
+}
+
+void nfa_free(prog_t *prog) {
+    if (!prog) return;
+
+    free(prog->inst);
+    free(prog);
+}
+
+/* where in the input a new thread is waiting, for `^` and `$` */
+#define AT_BEGIN 1
+#define AT_END   2
+
+/**
+ * @brief adds the thread at `pc` to `list`, following jumps and splits
+ *        (in priority order) with an explicit stack rather than recursion.
+ *        `sp` is the position in the text the new thread will be waiting at,
+ *        and `at` says if it is the beginning (AT_BEGIN) or the end (AT_END)
+ *        of the input. If `nslots`,
+ *        `caps` holds the thread's capture slots, which are updated by the
+ *        OP_SAVEs along the way and copied into the list
+ */
+static void add_thread(const prog_t *prog, threadlist_t *list, vmstack_t *stack, int pc,
+                       size_t start, const char *sp, int at,
+                       const char **caps, int nslots) {
+    int top = 0;
+    stack->pc[top++] = pc;
+
+    while (top) {
+        pc = stack->pc[--top];
+
+        // the branch that saved the slot has been followed in full
+        if (pc < 0) {
+            caps[-pc - 1] = stack->old[top];
+            continue;
+        }
+
+        // each instruction is added to the list at most once
+        int idx = list->sparse[pc];
+        if (idx < list->n && list->t[idx].pc == pc)
+            continue;
+
+        list->sparse[pc] = list->n;
+        list->t[list->n].pc = pc;
+        list->t[list->n].start = start;
+        if (nslots)
+            memcpy(list->caps + (size_t) list->n * nslots, caps, nslots * sizeof(const char *));
+        list->n++;
+
+        const inst_t *inst = &prog->inst[pc];
+        switch (inst->op) {
+            case OP_JMP:
+                stack->pc[top++] = inst->x;
+                break;
+            case OP_SPLIT:
+                // push the alternative first so the preferred branch is taken first
+                stack->pc[top++] = inst->y;
+                stack->pc[top++] = inst->x;
+                break;
+            case OP_BOL:
+                if (at & AT_BEGIN)
+                    stack->pc[top++] = pc + 1;
+                break;
+            case OP_EOL:
+                if (at & AT_END)
+                    stack->pc[top++] = pc + 1;
+                break;
+            case OP_SAVE:
+                if (nslots) {
+                    stack->old[top] = caps[inst->x];
+                    stack->pc[top++] = -inst->x - 1;
+                    caps[inst->x] = sp;
+                }
+                stack->pc[top++] = pc + 1;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* returns where `sp` is in the input [text, end), for `add_thread` */
+static inline int where(const char *sp, const char *text, const char *end, int bol) {
+    return (bol && sp == text ? AT_BEGIN : 0) | (sp == end ? AT_END : 0);
+}
+
+/* allocates whatever a search of a program of `len` instructions, with
+   `nslots` capture slots, needs and `scratch` does not have yet */
+static void scratch_alloc(nfa_scratch_t *scratch, int len, int nslots) {
+    // both thread lists and the stack (each instruction pushes at most two
+    // others when it is first added) in one go. The sparse sets check what
+    // they find, so whatever an earlier search left in them is fine
+    if (!scratch->threads) {
+        scratch->threads = malloc(2 * len * sizeof(thread_t));
+        scratch->ints = calloc(4 * len + 1, sizeof(int));
+    }
+
+    // and if capturing, the slots of every thread (plus those of a new one)
+    // and the values to restore. A search puts back every slot it changes,
+    // so those of a new thread are still NULL
+    if (nslots && !scratch->slots)
+        scratch->slots = calloc((2 * len + 1) * nslots + 2 * len + 1, sizeof(const char *));
+}
+
+static void scratch_release(nfa_scratch_t *scratch) {
+    free(scratch->threads);
+    free(scratch->ints);
+    free(scratch->slots);
+}
+
+/* runs the VM over [text, end) in `scratch` (or memory of its own if
+   NULL), where `^` matches at `text` if `bol`. If `earliest`, stops at the
+   first match found. If `caps`, stores the capture slots of the match in it */
+static const char *pike_vm(const prog_t *prog, nfa_scratch_t *scratch, const char *text, const char *end,
+                           int bol, const char **start, int earliest, const char **caps) {
+    const int len = prog->len;
+    const int nslots = caps ? prog->nslots : 0;
+
+    nfa_scratch_t own = { 0 };
+    if (!scratch)
+        scratch = &own;
+
+    scratch_alloc(scratch, len, nslots);
+    thread_t *threads = scratch->threads;
+    int *ints = scratch->ints;
+    const char **slots = nslots ? scratch->slots : NULL;
+    vmstack_t stack = { ints + 2 * len, nslots ? slots + (size_t) (2 * len + 1) * nslots : NULL };
+
+    threadlist_t lists[2] = {
+        { threads,       ints,       0, slots },
+        { threads + len, ints + len, 0, slots + (size_t) len * nslots },
+    };
+    threadlist_t *clist = &lists[0], *nlist = &lists[1];
+
+    // the slots of a new thread, which no group has set
+    const char **empty = slots + (size_t) 2 * len * nslots;
+
+    const char *match_start = NULL, *match_end = NULL;
+
+    for (const char *sp = text; ; sp++) {
+        // start a new (lowest priority) thread here until something matches.
+        // An anchored program left out its `^`, so starts only where it matches
+        if (!match_end && (!prog->anchored || (bol && sp == text)))
+            add_thread(prog, clist, &stack, 0, sp - text, sp, where(sp, text, end, bol), empty, nslots);
+
+        if (clist->n == 0)
+            break;
+
+        nlist->n = 0;
+        for (int i = 0; i < clist->n; i++) {
+            const thread_t *t = &clist->t[i];
+            const inst_t *inst = &prog->inst[t->pc];
+            const char **t_caps = clist->caps + (size_t) i * nslots;
+
+            if (inst->op == OP_MATCH) {
+                match_start = text + t->start;
+                match_end = sp;
+                if (nslots)
+                    memcpy(caps, t_caps, nslots * sizeof(const char *));
+
+                // lower priority threads can never win, so cut them off
+                break;
+            }
+
+            if (sp < end && nfa_accepts(inst, *sp))
+                add_thread(prog, nlist, &stack, t->pc + 1, t->start, sp + 1, sp + 1 == end ? AT_END : 0,
+                           t_caps, nslots);
+        }
+
+        if ((earliest && match_end) || sp == end)
+            break;
+
+        threadlist_t *tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+    }
+
+    if (scratch == &own)
+        scratch_release(&own);
+
+    *start = match_start;
+    return match_end;
+}
+
+nfa_scratch_t *nfa_scratch_new(void) {
+    return calloc(1, sizeof(nfa_scratch_t));
+}
+
+void nfa_scratch_free(nfa_scratch_t *scratch) {
+    if (!scratch) return;
+
+    scratch_release(scratch);
+    free(scratch);
+}
+
+const char *nfa_search(const prog_t *prog, nfa_scratch_t *scratch, const char *text, const char *end, int bol,
+                       const char **start) {
+    return pike_vm(prog, scratch, text, end, bol, start, 0, NULL);
+}
+
+const char *nfa_captures(const prog_t *prog, nfa_scratch_t *scratch, const char *text, const char *end, int bol,
+                         const char **start, const char **caps) {
+    for (int i = 0; i < prog->nslots; i++)
+        caps[i] = NULL;
+
+    return pike_vm(prog, scratch, text, end, bol, start, 0, caps);
+}
+
+int nfa_is_match(const prog_t *prog, nfa_scratch_t *scratch, const char *text, const char *end, int bol) {
+    const char *start;
+    return !!pike_vm(prog, scratch, text, end, bol, &start, 1, NULL);
+}
+
+long nfa_longest(const prog_t *prog, const char *text, const char *end, int *token) {
+    const int len = prog->len;
+    nfa_scratch_t scratch = { 0 };
+    scratch_alloc(&scratch, len, 0);
+
+    vmstack_t stack = { scratch.ints + 2 * len, NULL };
+    threadlist_t lists[2] = {
+        { scratch.threads,       scratch.ints,       0, NULL },
+        { scratch.threads + len, scratch.ints + len, 0, NULL },
+    };
+    threadlist_t *clist = &lists[0], *nlist = &lists[1];
+    long match = -1;
+
+    // every thread starts at `text`, and runs until none is left alive
+    add_thread(prog, clist, &stack, 0, 0, text, where(text, text, end, 1), NULL, 0);
+
+    for (const char *sp = text; clist->n; sp++) {
+        // the last (and so longest) match wins, and the lowest token of those
+        int best = -1;
+        nlist->n = 0;
+        for (int i = 0; i < clist->n; i++) {
+            const inst_t *inst = &prog->inst[clist->t[i].pc];
+
+            if (inst->op == OP_MATCH && (best < 0 || inst->x < best))
+                best = inst->x;
+            else if (sp < end && nfa_accepts(inst, *sp))
+                add_thread(prog, nlist, &stack, clist->t[i].pc + 1, 0, sp + 1,
+                           sp + 1 == end ? AT_END : 0, NULL, 0);
+        }
+
+        if (best >= 0) {
+            match = sp - text;
+            *token = best;
+        }
+
+        if (sp == end)
+            break;
+
+        threadlist_t *tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+    }
+
+    scratch_release(&scratch);
+    return match;
+}
+
+/***********************************
+ *         Streaming Search        *
+ ***********************************/
+struct nfa_stream {
+    const prog_t *prog;         /* the program being run */
+    thread_t     *threads;      /* the threads of both lists */
+    int          *ints;         /* the sparse sets of both lists, and the stack */
+    vmstack_t     stack;        /* the stack `add_thread` follows jumps with */
+    threadlist_t  lists[2];     /* the current and next thread lists */
+    threadlist_t *clist;        /* the threads waiting on the byte at `pos` */
+    threadlist_t *nlist;        /* the threads waiting on the byte after it */
+    size_t        pos;          /* the offset of the next byte */
+    size_t        match_start;  /* where the best match found so far begins */
+    size_t        match_end;    /* ...and ends */
+    int           matched;      /* true if a match was found */
+};
+
+/* starts a new thread at `pos` if nothing has matched yet, then cuts off
+   every thread behind the best match there. Nothing here depends on the
+   byte at `pos`, so a match is known as soon as no thread ahead of it is
+   left, without waiting for the next byte */
+static nfa_status_t stream_settle(nfa_stream_t *vm) {
+    const prog_t *prog = vm->prog;
+    threadlist_t *clist = vm->clist;
+
+    if (!vm->matched && (!prog->anchored || !vm->pos))
+        add_thread(prog, clist, &vm->stack, 0, vm->pos, NULL, vm->pos ? 0 : AT_BEGIN, NULL, 0);
+
+    for (int i = 0; i < clist->n; i++) {
+        if (prog->inst[clist->t[i].pc].op == OP_MATCH) {
+            vm->match_start = clist->t[i].start;
+            vm->match_end = vm->pos;
+            vm->matched = 1;
+            clist->n = i;
+            break;
+        }
+    }
+
+    if (vm->matched)
+        return clist->n ? NFA_PENDING : NFA_MATCHED;
+
+    // an unanchored search starts again at the next byte
+    return !clist->n && prog->anchored ? NFA_FAILED : NFA_SEARCHING;
+}
+
+nfa_stream_t *nfa_stream_new(const prog_t *prog) {
+    const int len = prog->len;
+    nfa_stream_t *vm = calloc(1, sizeof(nfa_stream_t));
+
+    // the same layout as `pike_vm`, without the capture slots
+    vm->prog = prog;
+    vm->threads = malloc(2 * len * sizeof(thread_t));
+    vm->ints = calloc(4 * len + 1, sizeof(int));
+    vm->stack = (vmstack_t) { vm->ints + 2 * len, NULL };
+    vm->lists[0] = (threadlist_t) { vm->threads,       vm->ints,       0, NULL };
+    vm->lists[1] = (threadlist_t) { vm->threads + len, vm->ints + len, 0, NULL };
+
+    return vm;
+}
+
+nfa_status_t nfa_stream_start(nfa_stream_t *vm, size_t offset) {
+    vm->clist = &vm->lists[0];
+    vm->nlist = &vm->lists[1];
+    vm->clist->n = 0;
+    vm->pos = offset;
+    vm->matched = 0;
+
+    return stream_settle(vm);
+}
+
+nfa_status_t nfa_stream_step(nfa_stream_t *vm, unsigned char ch) {
+    threadlist_t *clist = vm->clist, *nlist = vm->nlist;
+
+    nlist->n = 0;
+    for (int i = 0; i < clist->n; i++) {
+        const thread_t *t = &clist->t[i];
+        if (nfa_accepts(&vm->prog->inst[t->pc], ch))
+            add_thread(vm->prog, nlist, &vm->stack, t->pc + 1, t->start, NULL, 0, NULL, 0);
+    }
+
+    vm->clist = nlist;
+    vm->nlist = clist;
+    vm->pos++;
+
+    return stream_settle(vm);
+}
+
+nfa_status_t nfa_stream_end(nfa_stream_t *vm) {
+    threadlist_t *clist = vm->clist, *nlist = vm->nlist;
+
+    // the threads waiting on a `$` can go on now. Adding each thread again
+    // in order follows the same paths (and more), so priorities are kept
+    nlist->n = 0;
+    for (int i = 0; i < clist->n; i++)
+        add_thread(vm->prog, nlist, &vm->stack, clist->t[i].pc, clist->t[i].start, NULL,
+                   vm->pos ? AT_END : AT_BEGIN | AT_END, NULL, 0);
+
+    vm->clist = nlist;
+    vm->nlist = clist;
+
+    for (int i = 0; i < nlist->n; i++) {
+        if (vm->prog->inst[nlist->t[i].pc].op == OP_MATCH) {
+            vm->match_start = nlist->t[i].start;
+            vm->match_end = vm->pos;
+            vm->matched = 1;
+            break;
+        }
+    }
+
+    return vm->matched ? NFA_MATCHED : NFA_FAILED;
+}
+
+int nfa_stream_match(const nfa_stream_t *vm, size_t *start, size_t *end) {
+    *start = vm->match_start;
+    *end = vm->match_end;
+    return vm->matched;
+}
+
+void nfa_stream_free(nfa_stream_t *vm) {
+    if (!vm) return;
+
+    free(vm->threads);
+    free(vm->ints);
+    free(vm);
+}
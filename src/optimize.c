@@ -0,0 +1,94 @@
+#include "optimize.h"
+
+#include <string.h>
+
+#define IS_ATOM(x) \
+    ((x) == CHAR || (x) == DOT || (x) == CHAR_CLASS)
+
+#define IS_QUANTIFIER(x) \
+    ((x) == STAR || (x) == PLUS || (x) == OPTIONAL || (x) == REPEAT)
+
+/* returns the only character of the class, or -1 if it has more or none */
+static int only_member(const re_t *atom) {
+    int member = -1;
+
+    for (int ch = 0; ch < 256; ch++) {
+        if (!(atom->nccl ^ get_ind(atom->class.mask, ch)))
+            continue;
+
+        if (member >= 0)
+            return -1;
+
+        member = ch;
+    }
+
+    return member;
+}
+
+/* returns true if the two atoms consume the same characters */
+static int same_atom(const re_t *a, const re_t *b) {
+    if (a->type != b->type)
+        return 0;
+
+    switch (a->type) {
+        case CHAR:
+            return a->class.c == b->class.c;
+        case CHAR_CLASS:
+            return a->nccl == b->nccl && !memcmp(a->class.mask, b->class.mask, sizeof(a->class.mask));
+        default:
+            return 1;
+    }
+}
+
+/* returns true if `reg` begins a repetition of an atom with `*` or `+` */
+static int is_kleene(const re_t *reg) {
+    return IS_ATOM(reg[0].type) && (reg[1].type == STAR || reg[1].type == PLUS);
+}
+
+void re_optimize(re_t *reg) {
+    size_t len = 0;
+    while (reg[len].type != TERMINAL)
+        len++;
+
+    for (size_t i = 0; i < len; i++) {
+        if (reg[i].type != CHAR_CLASS)
+            continue;
+
+        const int member = only_member(&reg[i]);
+        if (member < 0)
+            continue;
+
+        memset(&reg[i].class, 0, sizeof(reg[i].class));
+        reg[i].class.c = (char) member;
+        reg[i].type = CHAR;
+        reg[i].nccl = 0;
+    }
+
+    // x*x* matches the same as x*, and with one + at least one x (but x+x+
+    // needs two). Only a pair that is not itself repeated is merged
+    for (size_t i = 0; i + 3 < len; ) {
+        if (!is_kleene(&reg[i]) || !is_kleene(&reg[i + 2]) || !same_atom(&reg[i], &reg[i + 2]) ||
+            (reg[i + 1].type == PLUS && reg[i + 3].type == PLUS) || IS_QUANTIFIER(reg[i + 4].type)) {
+            i++;
+            continue;
+        }
+
+        if (reg[i + 3].type == PLUS)
+            reg[i + 1].type = PLUS;
+
+        // the terminator moves down with the rest
+        memmove(&reg[i + 2], &reg[i + 4], (len - i - 3) * sizeof(re_t));
+        len -= 2;
+    }
+}
+
+size_t re_literal_len(const re_t *reg) {
+    size_t len = 0;
+
+    for (; reg[len].type != TERMINAL; len++) {
+        if (reg[len].type != CHAR || IS_QUANTIFIER(reg[len + 1].type))
+            return 0;
+    }
+
+    return len;
+}
@@ -0,0 +1,164 @@
+#include "prefilter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IS_QUANTIFIER(x) \
+    ((x) == STAR || (x) == PLUS || (x) == OPTIONAL || (x) == REPEAT)
+
+prefilter_t *prefilter_compile(const re_t *reg, arena_t *arena) {
+    const re_t *best = NULL;
+    size_t best_len = 0;
+    long best_offset = -1;
+
+    // the number of characters before the current atom, if it is fixed
+    long offset = 0;
+
+    if (reg[0].type == BEGIN)
+        reg++;
+
+    while (reg[0].type != TERMINAL) {
+        // a run of literal characters, none of which may be repeated or skipped
+        const re_t *run = reg;
+        size_t len = 0;
+        while (run[len].type == CHAR && !IS_QUANTIFIER(run[len + 1].type))
+            len++;
+
+        if (len > best_len) {
+            best = run;
+            best_len = len;
+            best_offset = offset;
+        }
+
+        if (len) {
+            reg += len;
+            if (offset >= 0)
+                offset += len;
+            continue;
+        }
+
+        // no literal is common to every alternative of the pattern
+        if (reg[0].type == ALTERNATE)
+            return NULL;
+
+        // a quantified group may be skipped (or repeated), and only one of
+        // the alternatives of a group matches, so nothing in such a group
+        // has to match and its width varies
+        if (reg[0].type == BEGIN_GROUP) {
+            const re_t *close = re_group_end(reg);
+            if (IS_QUANTIFIER(close[1].type) || re_alternative_end(reg + 1)->type == ALTERNATE) {
+                offset = -1;
+                reg = close + 1 + IS_QUANTIFIER(close[1].type);
+                continue;
+            }
+        }
+
+        // the bounds of a group and `^` and `$` match no characters
+        if (reg[0].type == BEGIN_GROUP || reg[0].type == END_GROUP || reg[0].type == BEGIN || reg[0].type == END) {
+            reg++;
+            continue;
+        }
+
+        // anything else ends the run, and quantifiers make the width vary
+        if (IS_QUANTIFIER(reg[1].type)) {
+            offset = -1;
+            reg += 2;
+        } else {
+            if (offset >= 0)
+                offset++;
+            reg++;
+        }
+    }
+
+    if (!best_len)
+        return NULL;
+
+    prefilter_t *pf = arena_calloc(arena, 1, sizeof(prefilter_t));
+    pf->len = best_len;
+    pf->offset = best_offset;
+    pf->lit = arena_calloc(arena, 1, best_len + 1);
+    for (size_t i = 0; i < best_len; i++)
+        pf->lit[i] = best[i].class.c;
+
+    // characters not in the literal (or only in its last position) shift
+    // by its whole length
+    if (best_len >= PREFILTER_BMH_MIN) {
+        pf->skip = arena_alloc(arena, 256 * sizeof(size_t));
+        for (int i = 0; i < 256; i++)
+            pf->skip[i] = best_len;
+        for (size_t i = 0; i + 1 < best_len; i++)
+            pf->skip[(unsigned char) pf->lit[i]] = best_len - 1 - i;
+    }
+
+    return pf;
+}
+
+void prefilter_free(prefilter_t *pf) {
+    if (!pf) return;
+
+    free(pf->lit);
+    free(pf->skip);
+    free(pf);
+}
+
+/* Boyer-Moore-Horspool: compares the last character of each window first
+   and shifts by how far that character is from the end of the literal */
+static const char *bmh_find(const prefilter_t *pf, const char *text, const char *end) {
+    const unsigned char *lit = (const unsigned char *) pf->lit;
+    const unsigned char *sp = (const unsigned char *) text;
+    const unsigned char last = lit[pf->len - 1];
+
+    while ((size_t) ((const unsigned char *) end - sp) >= pf->len) {
+        const unsigned char ch = sp[pf->len - 1];
+
+        if (ch == last && !memcmp(sp, lit, pf->len - 1))
+            return (const char *) sp;
+
+        sp += pf->skip[ch];
+    }
+
+    return NULL;
+}
+
+const char *prefilter_find(const prefilter_t *pf, const char *text, const char *end) {
+    if (text >= end || (size_t) (end - text) < pf->len)
+        return NULL;
+
+    if (pf->skip)
+        return bmh_find(pf, text, end);
+
+    // short literals: jump between occurrences of the first character
+    const char *last = end - pf->len;
+    while (text <= last) {
+        const char *sp = memchr(text, pf->lit[0], last - text + 1);
+        if (!sp)
+            return NULL;
+
+        if (!memcmp(sp + 1, pf->lit + 1, pf->len - 1))
+            return sp;
+
+        text = sp + 1;
+    }
+
+    return NULL;
+}
+
+const char *prefilter_start(const prefilter_t *pf, const char *text, const char *end, int anchored) {
+    // the literal must be right where the match needs it
+    if (pf->offset >= 0) {
+        if (text >= end || (size_t) (end - text) < pf->offset + pf->len)
+            return NULL;
+
+        if (anchored)
+            return memcmp(text + pf->offset, pf->lit, pf->len) ? NULL : text;
+
+        const char *lit = prefilter_find(pf, text + pf->offset, end);
+        return lit ? lit - pf->offset : NULL;
+    }
+
+    // the literal must be somewhere after the beginning of the match
+    if (!prefilter_find(pf, text, end))
+        return NULL;
+
+    return text;
+}
@@ -1,12 +1,53 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "regex.h"
 #include "regex-private.h"
+#include "nfa.h"
+#include "dfa.h"
+#include "prefilter.h"
+#include "ccl.h"
+#include "arena.h"
+#include "cache.h"
+#include "jit.h"
+#include "optimize.h"
 
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define IS_METACHAR(x) \
-    ((x) == DOT || (x) == STAR || (x) == PLUS || (x) == OPTIONAL || (x) == BEGIN || (x) == END)
+    ((x) == DOT || (x) == STAR || (x) == PLUS || (x) == OPTIONAL || (x) == BEGIN || (x) == END || \
+     (x) == BEGIN_GROUP || (x) == END_GROUP || (x) == ALTERNATE || (x) == REPEAT)
+
+/* patterns with up to this many groups are captured without allocating */
+#define SMALL_GROUPS 16
+
+/* a memoized search needing up to this many bytes of bitmap keeps it on the
+   stack, and one needing more than MEMO_MAX bits is left to the Pike VM */
+#define SMALL_MEMO 256
+#define MEMO_MAX   ((size_t) 1 << 26)
+
+/* counts the work of a search in its state, or of every search in the
+   pattern's counters (which threads share). Both are nothing without
+   RE_STATS */
+#ifdef RE_STATS
+#define STAT(exec, field, n) ((exec) ? (void) ((exec)->stats.field += (n)) : (void) 0)
+#define COUNT(pattern, field, n) \
+    ((void) __atomic_fetch_add(&((re_pattern_t *) (pattern))->stats.field, (size_t) (n), __ATOMIC_RELAXED))
+#else
+#define STAT(exec, field, n) ((void) 0)
+#define COUNT(pattern, field, n) ((void) (n))
+#endif
+
+/* true once the search has run out of budget (and backs out of every try) */
+#define EXCEEDED(exec) ((exec) && (exec)->limit && (exec)->limit->exceeded)
+
+/* a character that is matched exactly once */
+#define IS_LITERAL(reg) \
+    ((reg)[0].type == CHAR && (reg)[1].type != STAR && (reg)[1].type != PLUS && \
+     (reg)[1].type != OPTIONAL && (reg)[1].type != REPEAT)
 
 #define IS_ABBR(x) \
     ((x) == DIGIT || (x) == N_DIGIT || (x) == ALPH || (x) == N_ALPH || (x) == SPACE || (x) == N_SPACE || (x) == WORD || (x) == N_WORD)
@@ -22,40 +63,48 @@ static char RE_WORD[]     = "[a-zA-Z0-9]";
 static char RE_N_WORD[]     = "[^a-zA-Z0-9]";
 
 /**
- * @brief checks a single character using a given class by checking if:
+ * @brief checks a single character against an instruction by checking if:
  * -------
  *  - we are not at the end of the string
- *  - the metacharacter matches against the character
- *  - the literal character matches
- *  - the literal character is in the character class
+ *  - the character is in the instruction's class, which holds the literal
+ *    character of a CHAR, every character for a DOT and none for anything
+ *    but an atom
  * 
- * @param cl the class to check against
- * @param ch the character to match
+ * @param code the program the instruction belongs to
+ * @param inst the instruction to check against
+ * @param text the character to match
+ * @param end  the end of the text
  * @returns int
 */
-static __attribute__((always_inline)) int check_char(const re_t *cl, char ch) {
-    return  ch != '\0' && (
-            (cl->type == DOT) || 
-            (cl->type == CHAR && cl->class.c == ch) ||
-            (cl->type == CHAR_CLASS && (cl->nccl ^ get_ind(cl->class.mask, ch)))
-        );
+static inline __attribute__((always_inline)) int check_char(const re_code_t *code, const re_inst_t *inst,
+                                                            const char *text, const char *end) {
+    if (text >= end)
+        return 0;
+
+    const unsigned char ch = *text;
+    return (code->classes[inst->cl][ch >> 3] >> (ch & 7)) & 1;
 }
 
 char *re_precompile(const char *regexp) {
-    const int RE_LEN = strlen(regexp);
-    int length = RE_LEN;
+    size_t len;
+    return re_precompile_n(regexp, strlen(regexp), &len);
+}
+
+char *re_precompile_n(const char *regexp, size_t RE_LEN, size_t *out_len) {
+    size_t length = RE_LEN;
 
-    char *str = calloc(1, length);
-    int idx = 0; /* index of str */
+    // leave room for the null terminator
+    char *str = calloc(1, length + 1);
+    size_t idx = 0; /* index of str */
 
-    for (int i = 0; regexp[i]; i++) {
+    for (size_t i = 0; i < RE_LEN; i++) {
         if (idx == length) {
             length *= 2;
-            str = realloc(str, length);
+            str = realloc(str, length + 1);
         }
 
         // we do not encounter a shortcut character, copy it to the buffer and move on
-        if (!(regexp[i] == '\\' && IS_ABBR(regexp[i + 1]))) {
+        if (!(regexp[i] == '\\' && i + 1 < RE_LEN && IS_ABBR(regexp[i + 1]))) {
             str[idx++] = regexp[i];
             continue;
         }
@@ -64,7 +113,7 @@ char *re_precompile(const char *regexp) {
         i++;  // move pointer to shortcut character
 
         // get pattern
-        char *pattern;
+        char *pattern = NULL;
         switch(regexp[i]) {
             case DIGIT:
                 pattern = RE_DIGIT;
@@ -93,10 +142,11 @@ char *re_precompile(const char *regexp) {
         }
 
         // guarantee space for pattern
-        int patt_len = strlen(pattern);
-        if (idx + patt_len >= length) {
-            length *= 2;
-            str = realloc(str, length);
+        size_t patt_len = strlen(pattern);
+        if (idx + patt_len > length) {
+            while (idx + patt_len > length)
+                length *= 2;
+            str = realloc(str, length + 1);
         }
 
         // copy pattern to string
@@ -104,13 +154,161 @@ char *re_precompile(const char *regexp) {
         idx += patt_len;
     }
 
+    str[idx] = '\0';
+    *out_len = idx;
     return str;
 }
 
-/* takes in a string regexp and returns a list of `re_t`s representing the regexp */
 re_t *re_compile(const char *regexp) {
-    const size_t REGEXP_LEN = strlen(regexp);
-    re_t *regex = calloc(REGEXP_LEN + 1, sizeof(re_t));
+    return re_compile_n(regexp, strlen(regexp), NULL);
+}
+
+/* returns the class a shortcut character stands for */
+static const char *abbr_class(char abbr) {
+    switch (abbr) {
+        case DIGIT:
+            return RE_DIGIT;
+        case N_DIGIT:
+            return RE_N_DIGIT;
+        case ALPH:
+            return RE_ALPH;
+        case N_ALPH:
+            return RE_N_ALPH;
+        case SPACE:
+            return RE_SPACE;
+        case N_SPACE:
+            return RE_N_SPACE;
+        case WORD:
+            return RE_WORD;
+        default:
+            return RE_N_WORD;
+    }
+}
+
+static int parse_class(const char *regexp, size_t len, size_t *idx, re_t *atom);
+
+/* compiles the class a shortcut character stands for into `atom` */
+static void parse_abbr(char abbr, re_t *atom) {
+    const char *class = abbr_class(abbr);
+    size_t i = 1;
+
+    // the hard-coded classes are always well formed
+    parse_class(class, strlen(class), &i, atom);
+}
+
+/* compiles the character class whose contents begin at `*idx` into `atom`,
+   leaving `*idx` on its closing bracket. Returns false if it is malformed */
+static int parse_class(const char *regexp, size_t len, size_t *idx, re_t *atom) {
+    size_t i = *idx;
+
+    // check for character class negation
+    if (i < len && regexp[i] == BEGIN) {
+        atom->nccl = 1;
+        i++;
+    }
+
+    // true if the previous member was a shortcut, which cannot begin a range
+    int after_abbr = 0;
+
+    // add all characters to class bit map
+    while (i >= len || regexp[i] != END_CCL) {
+        if (i >= len) {
+            fprintf(stderr, "unclosed character class!\n");
+            return 0;
+        }
+
+        // a shortcut adds every character of its class (or of its complement)
+        if (regexp[i] == ESCAPE && i + 1 < len && IS_ABBR(regexp[i + 1])) {
+            re_t abbr = {0};
+            parse_abbr(regexp[i + 1], &abbr);
+
+            for (int j = 0; j < 4; j++)
+                atom->class.mask[j] |= abbr.nccl ? ~abbr.class.mask[j] : abbr.class.mask[j];
+
+            after_abbr = 1;
+            i += 2;
+            continue;
+        }
+
+        // take care of range
+        if (regexp[i - 1] != ESCAPE && regexp[i] == RANGE && !after_abbr) {
+            // catch if the range is not closed
+            if (i + 1 >= len) {
+                fprintf(stderr, "unclosed range!\n");
+                return 0;
+            }
+
+            // add all the characters in the range to the mask
+            char ch = regexp[i - 1];
+            for (; ch <= regexp[i + 1] && ch; ch++)
+                set_ind(atom->class.mask, (unsigned char) ch);
+
+            // move regexp pointer as needed
+            i++;
+        }
+
+        // set flag in bit map to indicate part of char class
+        set_ind(atom->class.mask, (unsigned char) regexp[i]);
+        after_abbr = 0;
+        i++;
+    }
+
+    atom->type = CHAR_CLASS;
+    *idx = i;
+    return 1;
+}
+
+/* reads the decimal number at `*i` into `bound`, stopping once it is out of
+   range, and returns false if there is none */
+static int parse_bound(const char *regexp, size_t len, size_t *i, int *bound) {
+    const size_t start = *i;
+    *bound = 0;
+
+    for (; *i < len && regexp[*i] >= '0' && regexp[*i] <= '9'; (*i)++) {
+        if (*bound <= REPEAT_MAX)
+            *bound = 10 * *bound + regexp[*i] - '0';
+    }
+
+    return *i > start;
+}
+
+/* compiles the bounds `{m}`, `{m,}` or `{m,n}` whose brace is at `*idx`
+   into `atom`, leaving `*idx` on the closing brace. Returns 0 if there are
+   no bounds (so the brace is literal) and -1 if they are out of range */
+static int parse_repeat(const char *regexp, size_t len, size_t *idx, re_t *atom) {
+    size_t i = *idx + 1;
+    int min, max;
+
+    if (!parse_bound(regexp, len, &i, &min))
+        return 0;
+
+    max = min;
+    if (i < len && regexp[i] == ',') {
+        i++;
+        if (!parse_bound(regexp, len, &i, &max))
+            max = REPEAT_INF;
+    }
+
+    if (i >= len || regexp[i] != '}')
+        return 0;
+
+    if (min > REPEAT_MAX || max > REPEAT_MAX || (max != REPEAT_INF && max < min)) {
+        fprintf(stderr, "invalid repetition!\n");
+        return -1;
+    }
+
+    atom->class.rep.min = min;
+    atom->class.rep.max = max;
+    atom->type = REPEAT;
+    *idx = i;
+    return 1;
+}
+
+/* takes in a regexp of the given length and returns a list of `re_t`s representing
+   the regexp. Shortcuts are compiled in place, without expanding them first */
+re_t *re_compile_n(const char *regexp, size_t REGEXP_LEN, arena_t *arena) {
+    // every character (or shortcut) compiles to at most one `re_t`
+    re_t *regex = arena_calloc(arena, REGEXP_LEN + 1, sizeof(re_t));
 
     // flag the last element in the array
     regex[REGEXP_LEN].type = TERMINAL;
@@ -118,9 +316,17 @@ re_t *re_compile(const char *regexp) {
     /* separate index variable since regexp may parse multiple characters at a time */
     size_t index = 0;
 
+    // the groups are numbered in the order they begin, from 1
+    int ngroups = 0, depth = 0;
+
     for (size_t i = 0; i < REGEXP_LEN; i++) {
+        // a shortcut is the same as the class it stands for
+        if (regexp[i] == ESCAPE && i + 1 < REGEXP_LEN && IS_ABBR(regexp[i + 1])) {
+            parse_abbr(regexp[++i], &regex[index]);
+        }
+
         // handle escaped sequence
-        if (regexp[i] == ESCAPE) {
+        else if (regexp[i] == ESCAPE) {
             regex[index].type = CHAR;
 
             // if the next character is a metacharacter, make it a character
@@ -133,6 +339,51 @@ re_t *re_compile(const char *regexp) {
             i++;
         }
         
+        // a group is bracketed by a pair of markers that know its number
+        else if (regexp[i] == BEGIN_GROUP) {
+            regex[index].class.c = ++ngroups;
+            regex[index].type = BEGIN_GROUP;
+            depth++;
+        }
+
+        else if (regexp[i] == END_GROUP) {
+            if (!depth--) {
+                fprintf(stderr, "unbalanced parentheses!\n");
+                if (!arena)
+                    free(regex);
+                return NULL;
+            }
+
+            // find the number of the group being closed
+            int open = 0;
+            for (size_t j = index; j-- > 0;) {
+                if (regex[j].type == END_GROUP)
+                    open++;
+                else if (regex[j].type == BEGIN_GROUP && !open--) {
+                    regex[index].class.c = regex[j].class.c;
+                    break;
+                }
+            }
+
+            regex[index].type = END_GROUP;
+        }
+
+        // a brace begins a repetition if bounds follow it, and is literal otherwise
+        else if (regexp[i] == REPEAT) {
+            const int status = parse_repeat(regexp, REGEXP_LEN, &i, &regex[index]);
+
+            if (status < 0) {
+                if (!arena)
+                    free(regex);
+                return NULL;
+            }
+
+            if (!status) {
+                regex[index].class.c = REPEAT;
+                regex[index].type = CHAR;
+            }
+        }
+
         else if (IS_METACHAR(regexp[i])) {
             regex[index].class.c = regexp[i];
             regex[index].type = regexp[i];
@@ -142,42 +393,11 @@ re_t *re_compile(const char *regexp) {
         else if (regexp[i] == BEGIN_CCL) {
             i++;
 
-            // check for character class negation
-            if (regexp[i] == BEGIN) {
-                regex[index].nccl = 1;
-                i++;
-            }
-
-            // add all characters to class bit map
-            while (regexp[i] != END_CCL) {
-                // take care of range
-                if (regexp[i - 1] != ESCAPE && regexp[i] == RANGE) {
-                    // catch if the range is not closed
-                    if (regexp[i + 1] == '\0') {
-                        fprintf(stderr, "unclosed range!\n");
-                        return NULL;
-                    }
-                    
-                    // add all the characters in the range to the mask 
-                    char ch = regexp[i - 1];
-                    for (; ch <= regexp[i + 1] && ch; ch++)
-                        set_ind(regex[index].class.mask, ch);
-                    
-                    // move regexp pointer as needed
-                    i++;
-                }
-
-                if (regexp[i] == '\0') {
-                    fprintf(stderr, "unclosed character class!\n");
-                    return NULL;
-                }
-
-                // set flag in bit map to indicate part of char class
-                set_ind(regex[index].class.mask, regexp[i]);
-                i++;
+            if (!parse_class(regexp, REGEXP_LEN, &i, &regex[index])) {
+                if (!arena)
+                    free(regex);
+                return NULL;
             }
-
-            regex[index].type = CHAR_CLASS;
         }
 
         else {
@@ -188,120 +408,939 @@ re_t *re_compile(const char *regexp) {
         index++;
     }
 
+    if (depth) {
+        fprintf(stderr, "unbalanced parentheses!\n");
+        if (!arena)
+            free(regex);
+        return NULL;
+    }
+
     return regex;
 }
 
-int re_is_match(char *regexp, char *text) {
-    char *exp_regexp = re_precompile(regexp);
-    re_t *reg = re_compile(exp_regexp);
-    free(exp_regexp);
+/* sets `class` to the bytes the single `re_t` consumes */
+static void atom_class(const re_t *atom, re_class_t class) {
+    memset(class, 0, sizeof(re_class_t));
+
+    for (int ch = 0; ch < 256; ch++) {
+        int in = 0;
+
+        switch (atom->type) {
+            case CHAR:
+                in = (unsigned char) atom->class.c == ch;
+                break;
+            case DOT:
+                in = 1;
+                break;
+            case CHAR_CLASS:
+                in = atom->nccl ^ get_ind(atom->class.mask, ch);
+                break;
+            default:
+                break;
+        }
+
+        if (in)
+            class[ch >> 3] |= 1 << (ch & 7);
+    }
+}
+
+re_code_t *re_code_compile(const re_t *reg, const ccl_t *runs, arena_t *arena) {
+    size_t len = 0;
+    while (reg[len].type != TERMINAL)
+        len++;
+
+    re_code_t *code = arena_calloc(arena, 1, sizeof(re_code_t));
+    code->inst = arena_calloc(arena, len + 1, sizeof(re_inst_t));
+    code->lits = arena_alloc(arena, len + 1);
+    code->runs = runs;
+
+    // the classes are collected first, so only the distinct ones are kept
+    re_class_t *classes = calloc(len + 1, sizeof(re_class_t));
+    int nclasses = 1;
+    size_t nlits = 0;
+
+    for (size_t i = 0, n = 0; i <= len; i++) {
+        re_inst_t *inst = &code->inst[n++];
 
-    int status;
+        // a run of characters, none of them repeated, is compared in one go
+        size_t run = 0;
+        while (IS_LITERAL(&reg[i + run]) && nlits + run < USHRT_MAX)
+            run++;
+
+        if (run > 1) {
+            inst->type = STRING;
+            inst->cl = nlits;
+            inst->run = run;
+
+            for (size_t j = 0; j < run; j++)
+                code->lits[nlits++] = reg[i + j].class.c;
+
+            i += run - 1;
+            continue;
+        }
+
+        inst->type = reg[i].type;
+
+        // a scanner only saves time, so one out of reach can be left out
+        if (reg[i].run && reg[i].run - runs < USHRT_MAX)
+            inst->run = reg[i].run - runs + 1;
+
+        // the bounds of a repetition fit in the fields it has no use for
+        if (reg[i].type == REPEAT) {
+            inst->c = reg[i].class.rep.min;
+            inst->run = reg[i].class.rep.max == REPEAT_INF ? USHRT_MAX : reg[i].class.rep.max;
+        }
+
+        re_class_t class;
+        atom_class(&reg[i], class);
+
+        int cl = 0;
+        while (cl < nclasses && memcmp(classes[cl], class, sizeof(re_class_t)))
+            cl++;
+
+        if (cl == nclasses) {
+            if (nclasses > USHRT_MAX) {
+                fprintf(stderr, "too many character classes!\n");
+                free(classes);
+                if (!arena)
+                    re_code_free(code);
+                return NULL;
+            }
+
+            memcpy(classes[nclasses++], class, sizeof(re_class_t));
+        }
+
+        inst->cl = cl;
+    }
+
+    code->classes = arena_alloc(arena, nclasses * sizeof(re_class_t));
+    memcpy(code->classes, classes, nclasses * sizeof(re_class_t));
+    code->nclasses = nclasses;
+    free(classes);
+
+    return code;
+}
+
+void re_code_free(re_code_t *code) {
+    if (!code) return;
+
+    free(code->inst);
+    free(code->lits);
+    free(code->classes);
+    free(code);
+}
+
+/* runs the backtracking matcher from `inst`, the start of the program (past
+   any `^`), in native code if it was compiled (and has no steps to count) */
+static inline char *match_start(const re_pattern_t *pattern, const re_inst_t *inst, char *text, char *end,
+                                re_exec_t *exec) {
+    if (pattern->jit && !(exec && exec->limit))
+        return pattern->jit->match(text, end);
+
+    return match_exec(pattern->code, inst, text, end, exec);
+}
+
+/* finds the leftmost match of the backtracking matcher in [text, end),
+   storing where it begins in `start`. Where the rest of the program failed
+   at one start, it fails at every other, so `exec` is kept throughout */
+static char *search_from(const re_pattern_t *pattern, char *text, char *end, char **start, re_exec_t *exec) {
+    const re_inst_t *inst = pattern->code->inst;
+    const prefilter_t *pf = pattern->prefilter;
+    char *end_match;
 
     // checks if the text starts as desired
-    if (reg[0].type == BEGIN) {
-        status = !!match_here(reg + 1, text);
-        re_free(reg);
-        return status;
+    if (inst[0].type == BEGIN) {
+        STAT(exec, starts, 1);
+        *start = text;
+        return match_start(pattern, inst + 1, text, end, exec);
     }
-    
+
+    // every match has the literal at the same offset, so only try the
+    // positions the prefilter finds
+    if (pf && pf->offset >= 0) {
+        for (; (text = (char *) prefilter_start(pf, text, end, 0)); text++) {
+            STAT(exec, starts, 1);
+            if ((end_match = match_start(pattern, inst, text, end, exec))) {
+                *start = text;
+                return end_match;
+            }
+
+            if (EXCEEDED(exec))
+                return NULL;
+        }
+
+        return NULL;
+    }
+
+    // every match contains the literal somewhere after it begins, so stop
+    // once there are no occurrences left
+    const char *lit = NULL;
+
     // match starting at any point in the text (even if text is empty)
     do {
-        if ((status = !!match_here(reg, text))) {
-            re_free(reg);
-            return status;
+        // a match has to begin with a character in the first class
+        if (pattern->first && !(text = (char *) ccl_find(pattern->first, text, end)))
+            return NULL;
+
+        if (pf && (!lit || text > lit) && !(lit = prefilter_find(pf, text, end)))
+            return NULL;
+
+        STAT(exec, starts, 1);
+        if ((end_match = match_start(pattern, inst, text, end, exec))) {
+            *start = text;
+            return end_match;
         }
-    } while (*text++ != '\0');
 
-    re_free(reg);
+        if (EXCEEDED(exec))
+            return NULL;
+    } while (text++ != end);
+
+    return NULL;
+}
+
+/* returns the pattern's memo, grown to at least `bytes` (which are clear) */
+static unsigned char *memo_reserve(re_pattern_t *pattern, size_t bytes) {
+    if (pattern->memo_cap < bytes) {
+        free(pattern->memo_bits);
+        pattern->memo_bits = calloc(bytes, 1);
+        pattern->memo_cap = bytes;
+    }
+
+    return pattern->memo_bits;
+}
+
+/* same as `search_from`, remembering where the matcher failed if the
+   pattern asks for it, and keeping to `limit` (if any) */
+static char *re_search(const re_pattern_t *pattern, char *text, char *end, char **start, re_limit_t *limit) {
+    const size_t width = (size_t) (end - text) + 1;
+    unsigned char small[SMALL_MEMO];
+    re_exec_t exec = { .text = text, .stride = pattern->memo, .limit = limit };
+    pthread_mutex_t *lock = NULL;
+
+    // a short text's memo fits on the stack, and a longer one is the
+    // pattern's, unless another thread is using it. A text too long to
+    // remember every try in is searched without (if the Pike VM could not
+    // take it over)
+    if (pattern->memo && width <= MEMO_MAX / pattern->memo) {
+        const size_t bytes = (pattern->memo * width + 7) / 8;
+
+        if (bytes <= SMALL_MEMO) {
+            exec.visited = memset(small, 0, bytes);
+        } else if (!pthread_mutex_trylock((pthread_mutex_t *) &pattern->memo_lock)) {
+            lock = (pthread_mutex_t *) &pattern->memo_lock;
+            exec.visited = memo_reserve((re_pattern_t *) pattern, bytes);
+        } else {
+            exec.visited = calloc(bytes, 1);
+        }
+    }
+
+#ifndef RE_STATS
+    // with nothing to remember, count or keep to, the search has no state
+    if (!exec.visited && !limit)
+        return search_from(pattern, text, end, start, NULL);
+#endif
+
+    char *match = search_from(pattern, text, end, start, &exec);
+
+    // the positions come one after another in the memo, so clearing those
+    // the search reached leaves it clear for the next, which would
+    // otherwise have to clear (or allocate) one for the whole text
+    if (lock) {
+        memset(exec.visited, 0, (exec.reach * pattern->memo + 7) / 8);
+        pthread_mutex_unlock(lock);
+    } else if (exec.visited != small) {
+        free(exec.visited);
+    }
+
+#ifdef RE_STATS
+    // every position up to where the match begins was either tried or
+    // skipped, unless the pattern is anchored to the first
+    const size_t positions = (size_t) ((match ? *start : end) - text) + 1;
+    if (pattern->code->inst[0].type != BEGIN)
+        COUNT(pattern, skipped, positions - exec.stats.starts);
+    COUNT(pattern, starts, exec.stats.starts);
+    COUNT(pattern, insts, exec.stats.insts);
+    COUNT(pattern, backtracks, exec.stats.backtracks);
+    COUNT(pattern, memo_hits, exec.stats.memo_hits);
+#endif
+
+    return match;
+}
+
+/* returns the number of repetitions the backtracking matcher may have to
+   come back to, which is every one but a run it consumes in full */
+static int count_backtracks(const re_t *reg) {
+    int n = 0;
+    for (; reg->type != TERMINAL; reg++) {
+        if (reg[1].type == STAR || reg[1].type == PLUS)
+            n += !reg->run;
+        else if (reg[1].type == REPEAT)
+            n += reg[1].class.rep.min != reg[1].class.rep.max;
+    }
+
+    return n;
+}
+
+/* returns true if the backtracking matcher finds out whether there is a
+   match about as fast as the DFA would (or faster, scanning runs of a class
+   with SIMD): nothing is backtracked into, so each try runs straight
+   through, and one is only tried where the input begins or at a literal */
+static int is_cheap_to_try(const re_t *reg) {
+    if (count_backtracks(reg))
+        return 0;
+
+    return reg[0].type == BEGIN || (reg[0].type == CHAR && reg[1].type != STAR && reg[1].type != OPTIONAL &&
+                                    !(reg[1].type == REPEAT && !reg[1].class.rep.min));
+}
+
+/* returns true if the pattern has a `|` anywhere */
+static int has_alternation(const re_t *reg) {
+    for (; reg->type != TERMINAL; reg++) {
+        if (reg->type == ALTERNATE)
+            return 1;
+    }
+
     return 0;
 }
 
-char *re_get_match(char *regexp, char *text) {
-    char *exp_regexp = re_precompile(regexp);
-    re_t *reg = re_compile(exp_regexp);
-    free(exp_regexp);
+/* returns true if the pattern has a `^` or `$` in the middle, which the
+   backtracking matcher takes for a character that never matches */
+static int has_inner_anchor(const re_t *reg) {
+    for (size_t i = 0; reg[i].type != TERMINAL; i++) {
+        if ((reg[i].type == BEGIN && i) || (reg[i].type == END && reg[i + 1].type != TERMINAL))
+            return 1;
+    }
 
-    char *end_match;
+    return 0;
+}
 
-    // checks if the text starts as desired
-    if (reg[0].type == BEGIN) {
-        end_match = match_here(reg + 1, text);
+/* returns the size of an arena that fits a pattern of length `len`, which
+   saves growing it (or wasting most of a default-sized block) */
+static size_t arena_estimate(size_t len, int flags) {
+    // every allocation may be padded to the arena's alignment
+    size_t size = sizeof(re_pattern_t) + (len + 1) * (sizeof(re_t) + sizeof(ccl_t)) + sizeof(ccl_t);
+    size += sizeof(re_code_t) + (len + 1) * (sizeof(re_inst_t) + sizeof(re_class_t) + 1);
+    size += 8 * sizeof(max_align_t);
+
+    // each atom needs at most three instructions, plus the final match
+    if (flags & (RE_NFA | RE_DFA))
+        size += sizeof(prog_t) + (3 * len + 1) * sizeof(inst_t);
+
+    if (!(flags & RE_NO_PREFILTER))
+        size += sizeof(prefilter_t) + len + 1 + 256 * sizeof(size_t);
+
+    return size;
+}
+
+re_pattern_t *re_pattern_compile(const char *regexp) {
+    return re_pattern_compile_flags(regexp, RE_BACKTRACK);
+}
+
+re_pattern_t *re_pattern_compile_flags(const char *regexp, int flags) {
+    return re_pattern_compile_n(regexp, strlen(regexp), flags);
+}
+
+re_pattern_t *re_pattern_compile_n(const char *regexp, size_t len, int flags) {
+    // the pattern owns an arena just large enough for it
+    arena_t *arena = arena_new(arena_estimate(len, flags));
+    re_pattern_t *pattern = re_pattern_compile_arena(regexp, len, flags, arena);
+
+    if (!pattern) {
+        arena_free(arena);
+        return NULL;
+    }
+
+    pattern->owns_arena = 1;
+    return pattern;
+}
+
+re_pattern_t *re_pattern_compile_arena(const char *regexp, size_t len, int flags, re_arena_t *arena) {
+    re_t *reg = re_compile_n(regexp, len, arena);
+
+    if (!reg)
+        return NULL;
+
+    re_optimize(reg);
+
+    re_pattern_t *pattern = arena_calloc(arena, 1, sizeof(re_pattern_t));
+    pattern->reg = reg;
+    pattern->flags = flags;
+    pattern->arena = arena;
+
+    // only the Pike VM can capture groups, branch or assert `^` and `$`
+    // anywhere, so it also runs every such pattern that was compiled for the
+    // backtracking matcher
+    pattern->ngroups = re_count_groups(reg);
+    pattern->anchored = re_anchored(reg);
+    const int needs_vm = pattern->ngroups || has_alternation(reg) || has_inner_anchor(reg);
+    if (flags & (RE_NFA | RE_DFA) || needs_vm)
+        pattern->prog = nfa_compile(reg, arena);
+
+    // the Pike VM copies out counted repetitions, which can make its program
+    // too large. The backtracking matcher counts them instead, so it takes
+    // over if it can
+    if (!pattern->prog && needs_vm) {
+        fprintf(stderr, "repetition too large!\n");
+        return NULL;
+    }
+
+    if (!(flags & RE_NO_PREFILTER)) {
+        pattern->prefilter = prefilter_compile(reg, arena);
+        pattern->literal = re_literal_len(reg);
+    }
+
+    // the backtracking matcher scans runs of a class with SIMD kernels
+    pattern->runs = ccl_annotate(reg, arena);
+    pattern->code = re_code_compile(reg, pattern->runs, arena);
+
+    if (!pattern->code) {
+        re_pattern_free(pattern);
+        return NULL;
+    }
+
+    // repetitions that backtrack into each other can take the matcher time
+    // to the power of their number, unless it remembers where it failed
+    const int memoize = !pattern->prog && (flags & RE_MEMO || count_backtracks(reg) > 1);
+    const int cheap = is_cheap_to_try(reg);
+
+    // a pattern left to the backtracking matcher may still need a program,
+    // for the DFA and for the Pike VM to search a text too long to memoize
+    if (!pattern->prog && (memoize || !cheap))
+        pattern->vm_prog = nfa_compile(reg, arena);
+
+    // the DFA's states come and go as it runs, so it lives on the heap. It
+    // answers whether there is a match in one lookup per byte, so it does
+    // for every pattern (unless RE_NFA) that the backtracking matcher could
+    // take longer over, and rules out texts without one before the Pike VM
+    // looks for where it is
+    const prog_t *dfa_prog = pattern->prog ? pattern->prog : pattern->vm_prog;
+    if (dfa_prog && !(flags & RE_NFA) && (pattern->prog || !cheap)) {
+        pattern->dfa = dfa_new(dfa_prog, DFA_DEFAULT_BUDGET);
+        pthread_mutex_init(&pattern->dfa_lock, NULL);
+    }
+
+    // only the interpreter can memoize, so it runs such patterns even with
+    // RE_JIT, as well as whatever the JIT cannot compile
+    if (flags & RE_JIT && !memoize && !pattern->prog)
+        pattern->jit = jit_compile(pattern->code, pattern->code->inst[0].type == BEGIN);
+
+    if (memoize) {
+        while (pattern->code->inst[pattern->memo].type != TERMINAL)
+            pattern->memo++;
+
+        pattern->memo++;
+        pthread_mutex_init(&pattern->memo_lock, NULL);
+    }
+
+    // the Pike VM's thread lists are kept from one search to the next
+    if (pattern->prog || pattern->vm_prog) {
+        pattern->scratch = nfa_scratch_new();
+        pthread_mutex_init(&pattern->scratch_lock, NULL);
+    }
+
+    // an unanchored match has to begin with a character of a leading class
+    // (unless there are other alternatives to begin with)
+    if (reg[0].type == CHAR_CLASS && reg[1].type != STAR && reg[1].type != OPTIONAL &&
+        !(reg[1].type == REPEAT && !reg[1].class.rep.min) && re_alternative_end(reg)->type == TERMINAL) {
+        pattern->first = arena_alloc(arena, sizeof(ccl_t));
+        ccl_compile(pattern->first, &reg[0]);
+    }
+
+    return pattern;
+}
+
+/* runs the Pike VM program `prog` for `pattern_search`, in the pattern's
+   scratch space unless another thread is running in it (and then in space
+   of its own) */
+static const char *vm_search(const re_pattern_t *pattern, const prog_t *prog, const char *text, const char *end,
+                             int bol, const char **start, int earliest, const char **caps) {
+    pthread_mutex_t *lock = (pthread_mutex_t *) &pattern->scratch_lock;
+    nfa_scratch_t *scratch = !pthread_mutex_trylock(lock) ? pattern->scratch : NULL;
+    const char *end_match;
+
+    if (caps) {
+        end_match = nfa_captures(prog, scratch, text, end, bol, start, caps);
+    } else if (!earliest) {
+        end_match = nfa_search(prog, scratch, text, end, bol, start);
     } else {
-        // match starting at any point in the text (even if text is empty)
-        do {
-            if ((end_match = match_here(reg, text)))
-                break;
-        } while (*text++ != '\0');
+        end_match = nfa_is_match(prog, scratch, text, end, bol) ? text : NULL;
+        *start = text;
     }
 
-    re_free(reg);
-    if (!end_match) return NULL;
-    
-    char *str = calloc(1, (end_match - text + 1));
-    memcpy(str, text, (end_match - text));
+    if (scratch)
+        pthread_mutex_unlock(lock);
+
+    return end_match;
+}
+
+/* finds the leftmost match of `pattern` in [text, end) with the engine it
+   was compiled for, where `^` matches at `text` if `bol` (if it is the
+   beginning of the input). If `earliest`, only whether there is a match
+   matters. If `caps`, the capture slots of the match are stored in it. If
+   `limit`, the backtracking matcher gives up once it is exceeded (the other
+   engines take linear time, and ignore it) */
+static const char *pattern_search(const re_pattern_t *pattern, const char *text, const char *end, int bol,
+                                  const char **start, int earliest, const char **caps, re_limit_t *limit) {
+    COUNT(pattern, searches, 1);
+    COUNT(pattern, bytes, end - text);
+
+    // an anchored pattern only matches at the beginning of the input
+    if (pattern->anchored && !bol)
+        return NULL;
+
+    // the prefilter's literal is the whole pattern, so what it finds is the match
+    if (pattern->literal) {
+        const char *found = prefilter_find(pattern->prefilter, text, end);
+        COUNT(pattern, skipped, (found ? found : end + 1) - text);
+
+        if (!found)
+            return NULL;
+
+        *start = found;
+        return found + pattern->literal;
+    }
+
+    // skip to where a match could begin, if anywhere
+    const char *from = text;
+
+    if (pattern->prefilter)
+        text = prefilter_start(pattern->prefilter, text, end, pattern->anchored);
+
+    if (text && pattern->first)
+        text = ccl_find(pattern->first, text, end);
+
+    COUNT(pattern, skipped, (text ? text : end + 1) - from);
+    if (!text)
+        return NULL;
+
+    // a match that needs `^` can only begin where the input does
+    bol = bol && text == from;
+
+    // the DFA quickly rules out texts without a match, and otherwise says
+    // there is one. Its states change as it runs, so a thread that finds
+    // another running it makes do without. Where the backtracking matcher
+    // finds the match, only a search for whether there is one (and not on
+    // a budget, which counts the matcher's steps) is left to the DFA, as
+    // it would just scan the text twice
+    pthread_mutex_t *lock = (pthread_mutex_t *) &pattern->dfa_lock;
+    if (pattern->dfa && (pattern->prog || (earliest && !limit)) && !pthread_mutex_trylock(lock)) {
+        const int match = dfa_is_match(pattern->dfa, text, end, bol);
+        pthread_mutex_unlock(lock);
+
+        if (!match)
+            return NULL;
+
+        if (earliest) {
+            *start = text;
+            return text;
+        }
+    }
+
+    if (pattern->prog)
+        return vm_search(pattern, pattern->prog, text, end, bol, start, earliest, caps);
+
+    // a text too long to memoize is left to the Pike VM (which finds the
+    // same matches), in linear time
+    if (pattern->memo && pattern->vm_prog && (size_t) (end - text) + 1 > MEMO_MAX / pattern->memo)
+        return vm_search(pattern, pattern->vm_prog, text, end, bol, start, earliest, caps);
+
+    return re_search(pattern, (char *) text, (char *) end, (char **) start, limit);
+}
+
+int re_pattern_match(const re_pattern_t *pattern, const char *text) {
+    return re_pattern_match_n(pattern, text, strlen(text));
+}
+
+int re_pattern_match_n(const re_pattern_t *pattern, const char *text, size_t len) {
+    const char *start;
+    return !!pattern_search(pattern, text, text + len, 1, &start, 1, NULL, NULL);
+}
+
+int re_pattern_span(const re_pattern_t *pattern, const char *text, re_span_t *span) {
+    return re_pattern_span_n(pattern, text, strlen(text), span);
+}
+
+int re_pattern_span_n(const re_pattern_t *pattern, const char *text, size_t len, re_span_t *span) {
+    const char *start;
+    const char *end_match = pattern_search(pattern, text, text + len, 1, &start, 0, NULL, NULL);
+    if (!end_match) return 0;
+
+    span->start = start - text;
+    span->len = end_match - start;
+    return 1;
+}
+
+/* sets up `limit` to keep a search to `budget` */
+static void limit_init(re_limit_t *limit, const re_budget_t *budget) {
+    limit->steps = budget->steps ? budget->steps : SIZE_MAX;
+    limit->deadline = budget->deadline;
+    limit->exceeded = 0;
+}
+
+int re_pattern_match_budget(const re_pattern_t *pattern, const char *text, size_t len, const re_budget_t *budget) {
+    re_limit_t limit;
+    limit_init(&limit, budget);
+
+    const char *start;
+    const char *end_match = pattern_search(pattern, text, text + len, 1, &start, 1, NULL, &limit);
+    return limit.exceeded ? RE_BUDGET_EXCEEDED : !!end_match;
+}
+
+int re_pattern_span_budget(const re_pattern_t *pattern, const char *text, size_t len, re_span_t *span,
+                           const re_budget_t *budget) {
+    re_limit_t limit;
+    limit_init(&limit, budget);
+
+    const char *start;
+    const char *end_match = pattern_search(pattern, text, text + len, 1, &start, 0, NULL, &limit);
+    if (limit.exceeded) return RE_BUDGET_EXCEEDED;
+    if (!end_match) return 0;
+
+    span->start = start - text;
+    span->len = end_match - start;
+    return 1;
+}
+
+size_t re_pattern_groups(const re_pattern_t *pattern) {
+    return pattern->ngroups;
+}
+
+int re_pattern_has_anchor(const re_pattern_t *pattern) {
+    for (const re_t *reg = pattern->reg; reg->type != TERMINAL; reg++) {
+        if (reg->type == BEGIN || reg->type == END)
+            return 1;
+    }
+
+    return 0;
+}
+
+int re_pattern_captures(const re_pattern_t *pattern, const char *text, size_t len,
+                        re_span_t *spans, size_t nspans) {
+    const int nslots = pattern->prog ? pattern->prog->nslots : 0;
+
+    // the slots only need the heap for patterns with many groups
+    const char *small[2 * SMALL_GROUPS];
+    const char **caps = nslots <= 2 * SMALL_GROUPS ? small : malloc(nslots * sizeof(const char *));
+
+    const char *start;
+    const char *end_match = pattern_search(pattern, text, text + len, 1, &start, 0, nslots ? caps : NULL, NULL);
+
+    if (end_match && nspans) {
+        spans[0].start = start - text;
+        spans[0].len = end_match - start;
+    }
+
+    for (size_t i = 1; end_match && i < nspans; i++) {
+        const char *begin = i <= (size_t) nslots / 2 ? caps[2 * i - 2] : NULL;
+        const char *close = begin ? caps[2 * i - 1] : NULL;
+
+        // a group that took no part in the match
+        if (!close) {
+            spans[i].start = RE_NO_GROUP;
+            spans[i].len = 0;
+            continue;
+        }
+
+        spans[i].start = begin - text;
+        spans[i].len = close - begin;
+    }
+
+    if (caps != small)
+        free(caps);
+
+    return !!end_match;
+}
+
+char *re_span_dup(const char *text, re_span_t span) {
+    char *str = malloc(span.len + 1);
+    memcpy(str, text + span.start, span.len);
+    str[span.len] = '\0';
+    return str;
+}
+
+char *re_pattern_find(const re_pattern_t *pattern, const char *text) {
+    re_span_t span;
+    if (!re_pattern_span(pattern, text, &span)) return NULL;
+
+    return re_span_dup(text, span);
+}
+
+void re_iter_init(re_iter_t *iter, const re_pattern_t *pattern, const char *text) {
+    re_iter_init_n(iter, pattern, text, strlen(text));
+}
+
+void re_iter_init_n(re_iter_t *iter, const re_pattern_t *pattern, const char *text, size_t len) {
+    iter->pattern = pattern;
+    iter->string = text;
+    iter->len = len;
+    iter->pos = 0;
+    iter->done = 0;
+}
+
+int re_iter_next(re_iter_t *iter, re_span_t *span) {
+    if (iter->done || iter->pos > iter->len)
+        return 0;
+
+    const char *text = iter->string + iter->pos;
+    const char *end = iter->string + iter->len;
+    const char *start;
+    const char *end_match = pattern_search(iter->pattern, text, end, !iter->pos, &start, 0, NULL, NULL);
+
+    // an anchored pattern can only match once, at the very start
+    iter->done = !end_match || iter->pattern->anchored;
+    if (!end_match)
+        return 0;
+
+    span->start = start - iter->string;
+    span->len = end_match - start;
+
+    // never return the same empty match twice
+    iter->pos = span->start + span->len + !span->len;
+    return 1;
+}
+
+void re_pattern_set_dfa_budget(re_pattern_t *pattern, size_t bytes) {
+    if (!pattern->dfa) return;
+
+    pthread_mutex_lock(&pattern->dfa_lock);
+    pattern->dfa->budget = bytes;
+    pthread_mutex_unlock(&pattern->dfa_lock);
+}
+
+int re_pattern_get_stats(const re_pattern_t *pattern, re_stats_t *stats) {
+    memset(stats, 0, sizeof(re_stats_t));
+
+#ifdef RE_STATS
+    const re_stats_t *counts = &pattern->stats;
+    stats->searches = __atomic_load_n(&counts->searches, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&counts->bytes, __ATOMIC_RELAXED);
+    stats->skipped = __atomic_load_n(&counts->skipped, __ATOMIC_RELAXED);
+    stats->starts = __atomic_load_n(&counts->starts, __ATOMIC_RELAXED);
+    stats->insts = __atomic_load_n(&counts->insts, __ATOMIC_RELAXED);
+    stats->backtracks = __atomic_load_n(&counts->backtracks, __ATOMIC_RELAXED);
+    stats->memo_hits = __atomic_load_n(&counts->memo_hits, __ATOMIC_RELAXED);
+
+    // the DFA counts for itself, while it is locked. Each byte it stepped
+    // over was a step that was either cached or not
+    if (pattern->dfa) {
+        pthread_mutex_t *lock = (pthread_mutex_t *) &pattern->dfa_lock;
+        pthread_mutex_lock(lock);
+        stats->dfa_bytes = pattern->dfa->nbytes;
+        stats->dfa_misses = pattern->dfa->nsteps;
+        stats->dfa_flushes = pattern->dfa->nflushes;
+        pthread_mutex_unlock(lock);
+
+        // the start state is worked out without a byte to step over
+        stats->dfa_hits = stats->dfa_bytes > stats->dfa_misses ? stats->dfa_bytes - stats->dfa_misses : 0;
+    }
+
+    return 1;
+#else
+    (void) pattern;
+    return 0;
+#endif
+}
+
+void re_pattern_reset_stats(re_pattern_t *pattern) {
+#ifdef RE_STATS
+    memset(&pattern->stats, 0, sizeof(re_stats_t));
+
+    if (pattern->dfa) {
+        pthread_mutex_lock(&pattern->dfa_lock);
+        pattern->dfa->nbytes = pattern->dfa->nsteps = pattern->dfa->nflushes = 0;
+        pthread_mutex_unlock(&pattern->dfa_lock);
+    }
+#else
+    (void) pattern;
+#endif
+}
+
+void re_pattern_free(re_pattern_t *pattern) {
+    if (!pattern) return;
+
+    // everything but the DFA's cache, the VM's scratch space, the memo and
+    // the native code lives in the arena
+    if (pattern->dfa) {
+        dfa_free(pattern->dfa);
+        pthread_mutex_destroy(&pattern->dfa_lock);
+        pattern->dfa = NULL;
+    }
+
+    if (pattern->memo) {
+        free(pattern->memo_bits);
+        pthread_mutex_destroy(&pattern->memo_lock);
+        pattern->memo_bits = NULL;
+    }
+
+    if (pattern->scratch) {
+        nfa_scratch_free(pattern->scratch);
+        pthread_mutex_destroy(&pattern->scratch_lock);
+        pattern->scratch = NULL;
+    }
+
+    jit_free(pattern->jit);
+    pattern->jit = NULL;
+
+    if (pattern->owns_arena)
+        arena_free(pattern->arena);
+}
+
+re_arena_t *re_arena_new(size_t block_size) {
+    return arena_new(block_size);
+}
+
+void re_arena_free(re_arena_t *arena) {
+    arena_free(arena);
+}
+
+int re_is_match(char *regexp, char *text) {
+    cache_entry_t *entry = cache_acquire(regexp);
+    if (!entry) return 0;
+
+    int status = re_pattern_match(entry->pattern, text);
+    cache_release(entry);
+    return status;
+}
+
+char *re_get_match(char *regexp, char *text) {
+    cache_entry_t *entry = cache_acquire(regexp);
+    if (!entry) return NULL;
+
+    char *str = re_pattern_find(entry->pattern, text);
+    cache_release(entry);
     return str;
 }
 
 /* search for regexp at the beginning of text */
-char *match_here(const re_t *reg, char *text) {
+char *match_here(const re_code_t *code, const re_inst_t *inst, char *text, char *end) {
+    return match_exec(code, inst, text, end, NULL);
+}
+
+/* returns true if the program was already tried from `inst` at `text`,
+   marking it as tried if not */
+static inline int memo_visit(const re_code_t *code, const re_inst_t *inst, const char *text, re_exec_t *exec) {
+    const size_t pos = (size_t) (text - exec->text);
+    const size_t bit = pos * exec->stride + (size_t) (inst - code->inst);
+    if (exec->visited[bit >> 3] >> (bit & 7) & 1) {
+        STAT(exec, memo_hits, 1);
+        return 1;
+    }
+
+    if (pos >= exec->reach)
+        exec->reach = pos + 1;
+
+    exec->visited[bit >> 3] |= 1 << (bit & 7);
+    return 0;
+}
+
+/* matches the rest of the program from `inst` where a repetition stopped,
+   unless it was tried there before */
+static inline char *match_rest(const re_code_t *code, const re_inst_t *inst, char *text, char *end,
+                               re_exec_t *exec) {
+    if (exec && exec->visited && memo_visit(code, inst, text, exec))
+        return NULL;
+
+    return match_exec(code, inst, text, end, exec);
+}
+
+/* returns true if the monotonic clock has reached `deadline` */
+static int past_deadline(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/* takes a step from the budget, reading the clock every RE_CLOCK_STEPS of
+   them. Returns false (for good) once either has run out */
+static inline int spend(re_limit_t *limit) {
+    if (!limit->steps) {
+        limit->exceeded = 1;
+        return 0;
+    }
+
+    limit->steps--;
+    if (limit->steps % RE_CLOCK_STEPS || (!limit->deadline.tv_sec && !limit->deadline.tv_nsec))
+        return 1;
+
+    if (past_deadline(&limit->deadline)) {
+        limit->steps = 0;
+        limit->exceeded = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+char *match_exec(const re_code_t *code, const re_inst_t *inst, char *text, char *end, re_exec_t *exec) {
+    // a search on a budget pays for every try of the program
+    if (exec && exec->limit && !spend(exec->limit))
+        return NULL;
+
     while (1) {
+        STAT(exec, insts, 1);
+
         // if there are no more expressions to check, we matched everything
-        if (reg[0].type == TERMINAL)
+        if (inst[0].type == TERMINAL)
             return text;
 
-        // if kleene star, then defer to helper function
-        else if (reg[1].type == STAR) {
-            if (!(text = match_kleene(&reg[0], reg + 2, text)))
+        // a run of characters is compared all at once
+        else if (inst[0].type == STRING) {
+            if (end - text < inst[0].run || memcmp(text, code->lits + inst[0].cl, inst[0].run))
                 return NULL;
-            
-            reg += 2;
+
+            text += inst[0].run;
+            inst++;
             continue;
         }
+
+        // if kleene star, then defer to helper function
+        else if (inst[1].type == STAR)
+            return match_kleene(code, &inst[0], inst + 2, text, end, exec);
         
         // if we hit a termination character and are at the end of the regexp
-        else if (reg[0].type == END && reg[1].type == TERMINAL)
-            return *text == '\0' ? text : NULL;
+        else if (inst[0].type == END && inst[1].type == TERMINAL)
+            return text == end ? text : NULL;
 
         // if we hit a `+` character, check one or more
-        else if (reg[1].type == PLUS) {
-            if (!check_char(reg, text[0]))
-                return NULL;
-            
-            if (!(text = match_kleene(&reg[0], reg + 2, text)))
+        else if (inst[1].type == PLUS) {
+            if (!check_char(code, inst, text, end))
                 return NULL;
             
-            reg += 2;
-            continue;
+            // the first occurrence has been consumed, the rest are optional
+            return match_kleene(code, &inst[0], inst + 2, text + 1, end, exec);
+        }
+
+        // if we hit a `{m,n}`, check the first `m` and then up to `n - m` more
+        else if (inst[1].type == REPEAT) {
+            for (int i = 0; i < inst[1].c; i++, text++) {
+                if (!check_char(code, inst, text, end))
+                    return NULL;
+            }
+
+            const int max = inst[1].run == USHRT_MAX ? -1 : inst[1].run - inst[1].c;
+            return match_repeat(code, &inst[0], inst + 2, text, end, max, exec);
         }
 
-        // if we hit a `?` character, check 0 or 1
-        else if (reg[1].type == OPTIONAL) {
-            // if we are at the end of our string, check that we are done matching
-            if (text[0] == '\0')
-                return reg[2].type == TERMINAL ? text : NULL;
-                
-            // there is more than one instance of the character
-            if (reg[0].class.c == text[1])
+        // if we hit a `?` character, prefer to consume one (like the Pike
+        // VM), and otherwise go on without
+        else if (inst[1].type == OPTIONAL) {
+            char *match;
+            if (check_char(code, inst, text, end) && (match = match_rest(code, inst + 2, text + 1, end, exec)))
+                return match;
+
+            if (EXCEEDED(exec))
                 return NULL;
-            
-            // if the first character is the same, then we consume it
-            if (reg[0].class.c == text[0] || (reg[0].type == DOT))
-                text++;
-            
-            // skip over instruction in regexp
-            reg += 2;
 
-            // if the regexp is done but there are more (of the samee)
+            inst += 2;
             continue;
         }
 
         // if the next character does not pass the subsequent regex task,
         // break and return 0
-        else if (!check_char(reg, text[0]))
+        else if (!check_char(code, inst, text, end))
             break;
         
-        reg++;
+        inst++;
         text++;
     }
 
@@ -310,23 +1349,101 @@ char *match_here(const re_t *reg, char *text) {
 }
 
 /* matches c*regexp at beginning of text */
-char *match_kleene(const re_t *c, const re_t *reg, char *text) {
+char *match_kleene(const re_code_t *code, const re_inst_t *c, const re_inst_t *inst, char *text, char *end,
+                   re_exec_t *exec) {
     // check for correct type coming in
     if (!(c->type == CHAR || c->type == DOT || c->type == CHAR_CLASS)) {
         fprintf(stderr, "incorrect type given to match_kleene: %d\n", c->type);
         return 0;
     }
     
+    // the rest of the pattern cannot begin inside the run, so skip it in one scan
+    if (c->run) {
+        text = (char *) ccl_span(&code->runs[c->run - 1], text, end);
+        return match_exec(code, inst, text, end, exec);
+    }
+
     // while there are matches for kleene character, check if the remaining
     // string matches the regexp
+    char *match;
     do {
-        if (match_here(reg, text))
-            return text;
-    } while (check_char(c, *text++));
+        // the loop itself went on from here before (it is keyed by the
+        // `*` or `+`, where the program is never started)
+        if (exec && exec->visited && memo_visit(code, c + 1, text, exec))
+            return NULL;
+
+        if ((match = match_rest(code, inst, text, end, exec)))
+            return match;
+
+        if (EXCEEDED(exec))
+            return NULL;
+
+        STAT(exec, backtracks, 1);
+    } while (check_char(code, c, text++, end));
 
     return NULL;
 }
 
+/* matches c{0,max}regexp at beginning of text */
+char *match_repeat(const re_code_t *code, const re_inst_t *c, const re_inst_t *inst, char *text, char *end, int max,
+                   re_exec_t *exec) {
+    char *match;
+
+    // like `*`, prefer as few repetitions as the rest of the pattern allows
+    for (;; max--) {
+        if ((match = match_rest(code, inst, text, end, exec)))
+            return match;
+
+        if (EXCEEDED(exec))
+            return NULL;
+
+        STAT(exec, backtracks, 1);
+        if (!max || !check_char(code, c, text, end))
+            return NULL;
+
+        text++;
+    }
+}
+
+const re_t *re_group_end(const re_t *open) {
+    int depth = 0;
+
+    for (const re_t *reg = open; ; reg++) {
+        if (reg->type == BEGIN_GROUP)
+            depth++;
+        else if (reg->type == END_GROUP && !--depth)
+            return reg;
+    }
+}
+
+const re_t *re_alternative_end(const re_t *reg) {
+    while (reg->type != ALTERNATE && reg->type != END_GROUP && reg->type != TERMINAL)
+        reg = reg->type == BEGIN_GROUP ? re_group_end(reg) + 1 : reg + 1;
+
+    return reg;
+}
+
+int re_anchored(const re_t *reg) {
+    while (1) {
+        if (reg->type != BEGIN)
+            return 0;
+
+        reg = re_alternative_end(reg);
+        if (reg->type == TERMINAL)
+            return 1;
+
+        reg++;
+    }
+}
+
+int re_count_groups(const re_t *reg) {
+    int ngroups = 0;
+    for (; reg->type != TERMINAL; reg++)
+        ngroups += reg->type == BEGIN_GROUP;
+
+    return ngroups;
+}
+
 void re_free(re_t *reg) {
     free(reg);
 }
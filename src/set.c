@@ -0,0 +1,83 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "nfa.h"
+#include "dfa.h"
+#include "optimize.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+re_set_t *re_set_compile(const char *const *patterns, const int *tokens, size_t n) {
+    if (!n)
+        return NULL;
+
+    // every pattern is compiled into one arena, which is freed in one go
+    arena_t *arena = arena_new(0);
+    re_set_t *set = arena_calloc(arena, 1, sizeof(re_set_t));
+    set->arena = arena;
+    set->regs = arena_calloc(arena, n, sizeof(re_t *));
+    set->tokens = arena_alloc(arena, n * sizeof(int));
+    set->n = n;
+
+    prog_t **progs = arena_calloc(arena, n, sizeof(prog_t *));
+
+    for (size_t i = 0; i < n; i++) {
+        set->regs[i] = re_compile_n(patterns[i], strlen(patterns[i]), arena);
+
+        if (!set->regs[i])
+            break;
+
+        re_optimize(set->regs[i]);
+
+        set->tokens[i] = tokens[i];
+        progs[i] = nfa_compile(set->regs[i], arena);
+
+        if (!progs[i])
+            break;
+    }
+
+    if (progs[n - 1]) {
+        set->prog = nfa_union(progs, n, arena);
+        set->dfa = dfa_new(set->prog, DFA_DEFAULT_BUDGET);
+        pthread_mutex_init(&set->dfa_lock, NULL);
+    }
+
+    if (!set->prog) {
+        re_set_free(set);
+        return NULL;
+    }
+
+    return set;
+}
+
+long re_set_match(const re_set_t *set, const char *string, size_t len, int *token) {
+    int idx;
+    long match;
+
+    // the DFA's states change as it runs, so a thread that finds another
+    // running it makes do with the Pike VM
+    pthread_mutex_t *lock = (pthread_mutex_t *) &set->dfa_lock;
+    if (!pthread_mutex_trylock(lock)) {
+        match = dfa_longest(set->dfa, string, string + len, &idx);
+        pthread_mutex_unlock(lock);
+    } else {
+        match = nfa_longest(set->prog, string, string + len, &idx);
+    }
+
+    if (match >= 0)
+        *token = set->tokens[idx];
+
+    return match;
+}
+
+void re_set_free(re_set_t *set) {
+    if (!set) return;
+
+    // everything but the DFA's cache lives in the arena
+    if (set->dfa) {
+        dfa_free(set->dfa);
+        pthread_mutex_destroy(&set->dfa_lock);
+    }
+
+    arena_free(set->arena);
+}
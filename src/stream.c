@@ -0,0 +1,265 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "nfa.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* the bytes a stream keeps room for at first */
+#define STREAM_MIN_KEPT 64
+
+/* the most bytes a stream keeps by default (see `re_stream_set_limit`) */
+#define STREAM_MAX_KEPT ((size_t) 1 << 24)
+
+/***********************************
+ *          Stream State           *
+ ***********************************/
+struct re_stream {
+    const re_pattern_t *pattern;    /* the pattern being matched */
+    prog_t       *prog;         /* the Pike VM program it runs */
+    int           owns_prog;    /* true if `prog` was compiled for the stream */
+    nfa_stream_t *vm;           /* the search in progress */
+    nfa_status_t  status;       /* the state of that search */
+    nfa_stream_t *ahead;        /* the search from the end of its match, while that may still grow */
+    nfa_status_t  ahead_status; /* the state of that search */
+    size_t        ahead_at;     /* the end of the match it searches on from */
+    int           ahead_on;     /* true if `ahead` is running */
+    int           ahead_skip;   /* true if it begins after the byte at `pos` */
+    re_stream_fn  on_match;     /* called with each match */
+    void         *data;         /* passed to `on_match` */
+    char         *kept;         /* the bytes [kept_at, kept_at + nkept) of the stream */
+    size_t        kept_at;      /* the offset of the first kept byte */
+    size_t        nkept;        /* the number of kept bytes */
+    size_t        cap;          /* the room in `kept` */
+    size_t        limit;        /* the most bytes `kept` may hold */
+    size_t        pos;          /* the offset of the next byte to search */
+    size_t        len;          /* the number of bytes fed so far */
+    size_t        found;        /* the matches reported by the current call */
+    int           restart;      /* true if a search begins at `pos` */
+    int           skip;         /* true if one begins after the byte at `pos` */
+    int           done;         /* true if nothing more can match */
+    int           failed;       /* true if a byte could not be kept */
+};
+
+/* returns true if the byte at `pos` may have to be searched again: the match
+   of the search in progress may still grow, and either nothing searches on
+   from its end, or what does has found a match of its own */
+static int must_keep(const re_stream_t *stream) {
+    return stream->status == NFA_PENDING && (!stream->ahead_on || stream->ahead_status != NFA_SEARCHING);
+}
+
+/* keeps the byte at `pos` (the next one) for a search that may start again
+   before it, returning false if the limit or the memory does not allow it */
+static int keep(re_stream_t *stream, char ch) {
+    // only the bytes since the match would be searched again
+    if (stream->kept_at + stream->nkept != stream->pos) {
+        stream->kept_at = stream->pos;
+        stream->nkept = 0;
+    }
+
+    if (stream->nkept == stream->cap) {
+        size_t start, end;
+        nfa_stream_match(stream->ahead_on ? stream->ahead : stream->vm, &start, &end);
+
+        // drop what came before the match ended, before asking for more room
+        if (end > stream->kept_at) {
+            memmove(stream->kept, stream->kept + (end - stream->kept_at), stream->kept_at + stream->nkept - end);
+            stream->nkept -= end - stream->kept_at;
+            stream->kept_at = end;
+        }
+
+        if (stream->nkept >= stream->limit)
+            return 0;
+
+        if (stream->nkept == stream->cap) {
+            size_t cap = stream->cap ? 2 * stream->cap : STREAM_MIN_KEPT;
+            if (cap > stream->limit)
+                cap = stream->limit;
+
+            char *kept = realloc(stream->kept, cap);
+            if (!kept)
+                return 0;
+
+            stream->kept = kept;
+            stream->cap = cap;
+        }
+    }
+
+    stream->kept[stream->nkept++] = ch;
+    return 1;
+}
+
+/* reports the match the search settled on, if any, and sets up the next
+   search from its end: the one that ran alongside it, or a new one (over
+   the bytes kept since). A match that may still grow, found just now, has
+   the next search start alongside it instead */
+static void settle(re_stream_t *stream) {
+    size_t start, end;
+
+    if (stream->status == NFA_FAILED) {
+        stream->done = 1;
+        return;
+    }
+
+    if (stream->status == NFA_PENDING) {
+        nfa_stream_match(stream->vm, &start, &end);
+
+        // the search after an empty match begins one byte later
+        if (!stream->pattern->anchored && end == stream->pos && (!stream->ahead_on || stream->ahead_at != end)) {
+            stream->ahead_on = 1;
+            stream->ahead_at = end;
+            stream->ahead_skip = start == end;
+            stream->ahead_status = stream->ahead_skip ? NFA_SEARCHING : nfa_stream_start(stream->ahead, end);
+        }
+        return;
+    }
+
+    if (stream->status != NFA_MATCHED)
+        return;
+
+    nfa_stream_match(stream->vm, &start, &end);
+    stream->on_match((re_span_t) { start, end - start }, stream->data);
+    stream->found++;
+
+    const int ahead = stream->ahead_on && !stream->ahead_skip && stream->ahead_at == end;
+    stream->ahead_on = stream->ahead_skip = 0;
+
+    // an anchored pattern can only match once, at the very start
+    if (stream->pattern->anchored) {
+        stream->done = 1;
+        return;
+    }
+
+    if (ahead) {
+        nfa_stream_t *vm = stream->vm;
+        stream->vm = stream->ahead;
+        stream->ahead = vm;
+        stream->status = stream->ahead_status;
+        settle(stream);
+        return;
+    }
+
+    stream->pos = end;
+    stream->restart = start != end;
+    stream->skip = start == end;
+    stream->status = NFA_SEARCHING;
+}
+
+/* searches the stream up to the end of `chunk`, whose first byte is the
+   one after those fed before. The bytes before it come from `kept` */
+static void search(re_stream_t *stream, const char *chunk, size_t len) {
+    const size_t end = stream->len + len;
+
+    while (!stream->done) {
+        if (stream->restart) {
+            stream->restart = stream->ahead_on = 0;
+            stream->status = nfa_stream_start(stream->vm, stream->pos);
+            settle(stream);
+            continue;
+        }
+
+        if (stream->pos == end)
+            break;
+
+        const int is_kept = stream->pos < stream->kept_at + stream->nkept;
+        const char ch = is_kept ? stream->kept[stream->pos - stream->kept_at] : chunk[stream->pos - stream->len];
+
+        if (stream->skip) {
+            stream->skip = 0;
+            stream->restart = 1;
+            stream->pos++;
+            continue;
+        }
+
+        // the bytes that may be searched again are kept until then. Without
+        // the room to keep one, the stream stops rather than report wrongly
+        if (must_keep(stream) && !is_kept && !keep(stream, ch)) {
+            stream->failed = stream->done = 1;
+            break;
+        }
+
+        stream->status = nfa_stream_step(stream->vm, ch);
+        if (stream->ahead_on && !stream->ahead_skip)
+            stream->ahead_status = nfa_stream_step(stream->ahead, ch);
+        stream->pos++;
+
+        if (stream->ahead_skip) {
+            stream->ahead_skip = 0;
+            stream->ahead_status = nfa_stream_start(stream->ahead, stream->pos);
+        }
+
+        settle(stream);
+    }
+
+    stream->len = end;
+}
+
+re_stream_t *re_stream_new(const re_pattern_t *pattern, re_stream_fn on_match, void *data) {
+    re_stream_t *stream = calloc(1, sizeof(re_stream_t));
+    stream->pattern = pattern;
+    stream->on_match = on_match;
+    stream->data = data;
+    stream->limit = STREAM_MAX_KEPT;
+    stream->restart = 1;
+
+    // patterns left to the backtracking matcher have no program of their own
+    stream->prog = pattern->prog;
+    if (!stream->prog) {
+        stream->prog = nfa_compile(pattern->reg, NULL);
+        stream->owns_prog = 1;
+    }
+
+    if (!stream->prog) {
+        free(stream);
+        return NULL;
+    }
+
+    stream->vm = nfa_stream_new(stream->prog);
+    stream->ahead = nfa_stream_new(stream->prog);
+    return stream;
+}
+
+void re_stream_set_limit(re_stream_t *stream, size_t limit) {
+    stream->limit = limit;
+}
+
+size_t re_stream_feed(re_stream_t *stream, const char *chunk, size_t len) {
+    stream->found = 0;
+    search(stream, chunk, len);
+    return stream->failed ? RE_STREAM_ERROR : stream->found;
+}
+
+size_t re_stream_finish(re_stream_t *stream) {
+    stream->found = 0;
+
+    // the match at the end may leave kept bytes to search again
+    for (search(stream, NULL, 0); !stream->done && !stream->skip; search(stream, NULL, 0)) {
+        stream->status = nfa_stream_end(stream->vm);
+        if (stream->ahead_on && !stream->ahead_skip)
+            stream->ahead_status = nfa_stream_end(stream->ahead);
+        settle(stream);
+    }
+
+    const size_t found = stream->failed ? RE_STREAM_ERROR : stream->found;
+
+    stream->status = NFA_SEARCHING;
+    stream->nkept = stream->kept_at = 0;
+    stream->pos = stream->len = 0;
+    stream->restart = 1;
+    stream->ahead_on = stream->ahead_skip = 0;
+    stream->skip = stream->done = stream->failed = 0;
+
+    return found;
+}
+
+void re_stream_free(re_stream_t *stream) {
+    if (!stream) return;
+
+    if (stream->owns_prog)
+        nfa_free(stream->prog);
+
+    nfa_stream_free(stream->vm);
+    nfa_stream_free(stream->ahead);
+    free(stream->kept);
+    free(stream);
+}
@@ -0,0 +1,154 @@
+/**
+ * @file regex-cases.h
+ * @author Anshul Kamath
+ * @brief A table of (pattern, text, result) cases taken from test-regex.c,
+ *        shared by the tests of each matching engine
+ * @version 0.1
+ * @date 2022-05-03
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+
+#ifndef REGEX_CASES_H
+#define REGEX_CASES_H
+
+#include <stddef.h>
+
+typedef struct regex_case {
+    char *pattern;          /* the pattern to compile */
+    char *text;             /* the text to match against */
+    int   match;            /* true if the pattern should match the text */
+} regex_case_t;
+
+static const regex_case_t REGEX_CASES[] = {
+    { "^Hello .orld.",      "Hello World!", 1 },
+    { "^Hello .orld.",      "Hello world.", 1 },
+    { "^Hello .orld.",      "world.", 0 },
+    { "^Hello .orld.",      "random string.", 0 },
+    { "^Hello .orld*!",     "Hello worlddddddddd!", 1 },
+    { "^Hello .orld*!",     "Hello worl!", 1 },
+    { "",                   "test", 1 },
+    { "a",                  "", 0 },
+    { "world$",             "this is the world", 1 },
+    { "a*bc",               "bc", 1 },
+    { "a*bc",               "abc", 1 },
+    { "a*bc",               "aabc", 1 },
+    { "a*bc",               "a", 0 },
+    { "a*bc",               "ab", 0 },
+    { "Hello world\\.",     "Hello world.", 1 },
+    { "Hello world\\.",     "Hello world", 0 },
+    { "Hello world\\$",     "Hello world$", 1 },
+    { "Hello world\\$",     "Hello world", 0 },
+    { "Hello world\\*",     "Hello world*", 1 },
+    { "Hello world\\*",     "Hello worldddd", 0 },
+    { "\\$Hello world",     "$Hello world", 1 },
+    { "\\$Hello world",     "Hello world", 0 },
+    { "Hello world\\\\*.",  "Hello world\\\\\\.", 1 },
+    { "Hello world\\\\*.",  "Hello world.", 1 },
+    { "Hello world!+",      "Hello world!", 1 },
+    { "Hello world!+",      "Hello world!!!!", 1 },
+    { "Hello world.+",      "Hello worlddddd", 1 },
+    { "Hello world.+",      "Hello world", 0 },
+    { "Hello world!\\+",    "Hello world!+", 1 },
+    { "Hello world!?",      "Hello world!", 1 },
+    { "Hello world!?",      "Hello world", 1 },
+    { "Hello world.?",      "Hello world!!!!", 1 },
+    { "Hello world!\\?\\?", "Hello world!??", 1 },
+    { "a+bc",               "bc", 0 },
+    { "a+bc",               "abc", 1 },
+    { "a+bc",               "aabc", 1 },
+    { "a+bc",               "a", 0 },
+    { "a+bc",               "ab", 0 },
+    { "[abc]",              "a", 1 },
+    { "[abc]",              "b", 1 },
+    { "[abc]",              "c", 1 },
+    { "[abc]",              "d", 0 },
+    { "[abc]",              "A", 0 },
+    { "[abc]",              "ab", 1 },
+    { "[abc]*",             "aaa", 1 },
+    { "[abc]*",             "bbb", 1 },
+    { "[abc]*",             "ccc", 1 },
+    { "[abc]*",             "abc", 1 },
+    { "[abc]*",             "abcabc", 1 },
+    { "[abc]*",             "d", 1 },
+    { "[abc]*",             "abcA", 1 },
+    { "[abc]*",             "abcd", 1 },
+    { "[a-z]+",             "abc", 1 },
+    { "[a-z]+",             "A", 0 },
+    { "[a-z]+",             "aBC", 1 },
+    { "^[a-zA-Z]+",         "abcDEF", 1 },
+    { "^[a-zA-Z]+",         "ABCdef", 1 },
+    { "^[a-zA-Z]+",         "123abc", 0 },
+    { "[A\\-Z\\]",          "A-Z", 1 },
+    { "[A\\-Z\\]",          "-", 1 },
+    { "[A\\-Z\\]",          "\\", 1 },
+    { "[A\\-Z\\]",          "B", 0 },
+    { "^[^a-z]+",           "abc", 0 },
+    { "^[^a-z]+",           "A", 1 },
+    { "^[^a-z]+",           "aBC", 0 },
+    { "^[^a-zA-Z]+",        "abcDEF", 0 },
+    { "^[^a-zA-Z]+",        "ABCdef", 0 },
+    { "^[^a-zA-Z]+",        "123abc", 1 },
+    { "^[^A\\-Z\\]",        "A-Z", 0 },
+    { "^[^A\\-Z\\]",        "-", 0 },
+    { "^[^A\\-Z\\]",        "\\", 0 },
+    { "^[^A\\-Z\\]",        "B", 1 },
+    { "cat|dog",            "hotdog", 1 },
+    { "cat|dog",            "cow", 0 },
+    { "^(cat|dog)s?$",      "cats", 1 },
+    { "^(cat|dog)s?$",      "dogs", 1 },
+    { "^(cat|dog)s?$",      "cog", 0 },
+    { "^if|^in|^int",       "int x", 1 },
+    { "^if|^in|^int",       "print", 0 },
+    { "[0-9]+|x",           "x", 1 },
+    { "a(|b)c",             "ac", 1 },
+    { "a(|b)c",             "abc", 1 },
+    { "a\\|b",              "a|b", 1 },
+    { "a\\|b",              "b", 0 },
+    { "^[0-9]{1,5}$",       "12345", 1 },
+    { "^[0-9]{1,5}$",       "123456", 0 },
+    { "^[0-9]{1,5}$",       "", 0 },
+    { "^a{3}$",             "aaa", 1 },
+    { "^a{3}$",             "aa", 0 },
+    { "^a{3}$",             "aaaa", 0 },
+    { "^a{2,}b",            "aaaab", 1 },
+    { "^a{2,}b",            "ab", 0 },
+    { "x.{0,3}y",           "x12y", 1 },
+    { "x.{0,3}y",           "x1234y", 0 },
+    { "^(ab){2}$",          "abab", 1 },
+    { "^(ab){2}$",          "ab", 0 },
+    { "a{,2}",              "a{,2}", 1 },
+    { "a\\{2}",             "a{2}", 1 },
+    { "a\\{2}",             "aa", 0 },
+};
+
+#define NUM_REGEX_CASES (sizeof(REGEX_CASES) / sizeof(REGEX_CASES[0]))
+
+typedef struct regex_find_case {
+    char *pattern;          /* the pattern to compile */
+    char *text;             /* the text to search */
+    char *found;            /* the first match expected, or NULL */
+} regex_find_case_t;
+
+static const regex_find_case_t REGEX_FIND_CASES[] = {
+    { "\\w+@\\w+\\.com", "this is a test: testemail@gmail.com", "testemail@gmail.com" },
+    { "\\w+@\\w+\\.com", "this is a test",                      NULL },
+    { "a*bc",             "xaabcx",                              "aabc" },
+    { "[a-z]+",           "ABC def",                             "d" },
+    { "^[a-zA-Z]+",       "abcDEF",                              "a" },
+    { "Hello world!?",    "Hello world!",                        "Hello world!" },
+    { "world$",           "world world",                         "world" },
+    { "x*",               "abc",                                 "" },
+    { "b.*d",             "abcdcd",                              "bcd" },
+    { "^a",               "ba",                                  NULL },
+    { "ab|abc",           "xabcd",                               "ab" },
+    { "abc|ab",           "xabcd",                               "abc" },
+    { "b|if|int",         "print",                               "int" },
+    { "[0-9]{2,3}",       "a12345",                              "12" },
+    { "[0-9]{2,3}x",      "a12345x",                             "345x" },
+};
+
+#define NUM_REGEX_FIND_CASES (sizeof(REGEX_FIND_CASES) / sizeof(REGEX_FIND_CASES[0]))
+
+#endif
@@ -0,0 +1,103 @@
+#include "arena.h"
+
+#include "testing-logger.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* returns true if `ptr` is aligned for any type */
+static int is_aligned(const void *ptr) {
+    return (uintptr_t) ptr % sizeof(max_align_t) == 0;
+}
+
+void test_arena_alloc() {
+    testing_logger_t *tester = create_tester();
+    arena_t *arena = arena_new(256);
+
+    expect(tester, arena->block_size == 256);
+    expect(tester, arena->head == NULL);
+
+    // odd sizes still leave the next allocation aligned
+    char *a = arena_alloc(arena, 3);
+    char *b = arena_alloc(arena, 5);
+    expect(tester, is_aligned(a));
+    expect(tester, is_aligned(b));
+    expect(tester, b - a == sizeof(max_align_t));
+    expect(tester, arena->allocated == 2 * sizeof(max_align_t));
+
+    // both allocations are usable in full
+    memcpy(a, "abc", 3);
+    memcpy(b, "defgh", 5);
+    expect(tester, !memcmp(a, "abc", 3));
+
+    arena_free(arena);
+    log_tests(tester);
+}
+
+void test_arena_growth() {
+    testing_logger_t *tester = create_tester();
+    arena_t *arena = arena_new(64);
+
+    // a full block is kept, and a new one started
+    arena_alloc(arena, 48);
+    arena_block_t *first = arena->head;
+    arena_alloc(arena, 48);
+    expect(tester, arena->head != first);
+    expect(tester, arena->head->next == first);
+    expect(tester, arena->head->size == 64);
+
+    // an allocation larger than a block gets a block of its own
+    char *big = arena_alloc(arena, 1000);
+    expect(tester, arena->head->size >= 1000);
+    expect(tester, is_aligned(big));
+    memset(big, 'x', 1000);
+
+    arena_free(arena);
+    log_tests(tester);
+}
+
+void test_arena_calloc() {
+    testing_logger_t *tester = create_tester();
+    arena_t *arena = arena_new(0);
+
+    expect(tester, arena->block_size == ARENA_DEFAULT_BLOCK);
+
+    // dirty the memory that calloc hands out next
+    memset(arena_alloc(arena, 100), 0xff, 100);
+    arena->head->used = 0;
+
+    int *ints = arena_calloc(arena, 25, sizeof(int));
+    int zero = 1;
+    for (int i = 0; i < 25; i++)
+        zero &= !ints[i];
+    expect(tester, zero);
+
+    arena_free(arena);
+    arena_free(NULL);
+    log_tests(tester);
+}
+
+void test_arena_heap() {
+    testing_logger_t *tester = create_tester();
+
+    // without an arena, allocations come from (and go back to) the heap
+    char *str = arena_alloc(NULL, 4);
+    memcpy(str, "abc", 4);
+    expect(tester, !strcmp(str, "abc"));
+    free(str);
+
+    long *longs = arena_calloc(NULL, 4, sizeof(long));
+    expect(tester, !longs[0] && !longs[3]);
+    free(longs);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_arena_alloc();
+    test_arena_growth();
+    test_arena_calloc();
+    test_arena_heap();
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "regex.h"
+
+#include "testing-logger.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_SUBJECTS 3000
+#define NUM_THREADS  4
+
+/* fills `subjects` with strings of up to 40 characters drawn from `alphabet`
+   (some of them empty, or with a '\0' inside), all stored in `buf` */
+static void make_subjects(re_subject_t *subjects, size_t n, char *buf, const char *alphabet) {
+    const size_t nalpha = strlen(alphabet);
+
+    for (size_t i = 0; i < n; i++) {
+        const size_t len = rand() % 41;
+        for (size_t j = 0; j < len; j++)
+            buf[j] = rand() % 50 ? alphabet[rand() % nalpha] : '\0';
+
+        subjects[i] = (re_subject_t) { buf, len };
+        buf += len;
+    }
+}
+
+/* returns true if the batch found what matching each subject in turn does */
+static int same_as_serial(const re_pattern_t *pattern, const re_subject_t *subjects, size_t n,
+                          const unsigned char *matched, const re_span_t *spans, size_t matches) {
+    size_t expected = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        re_span_t span;
+        const int match = re_pattern_span_n(pattern, subjects[i].string, subjects[i].len, &span);
+
+        if (matched && ((matched[i / 8] >> (i % 8)) & 1) != match)
+            return 0;
+        if (spans && match && (spans[i].start != span.start || spans[i].len != span.len))
+            return 0;
+        if (spans && !match && spans[i].start != RE_NO_GROUP)
+            return 0;
+
+        expected += match;
+    }
+
+    return matches == expected;
+}
+
+void test_batch_results() {
+    testing_logger_t *tester = create_tester();
+    static const char *const patterns[] = { "\\w+@\\w+\\.com", "a.*b.*c", "(ab|cd)+x", "^b?c{2,3}", "abc" };
+    static const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA, RE_JIT, RE_MEMO };
+    static const int threads[] = { 1, 3, NUM_THREADS, 0 };
+
+    re_subject_t *subjects = malloc(NUM_SUBJECTS * sizeof(re_subject_t));
+    char *buf = malloc(NUM_SUBJECTS * 40);
+    unsigned char *matched = malloc(NUM_SUBJECTS / 8 + 1);
+    re_span_t *spans = malloc(NUM_SUBJECTS * sizeof(re_span_t));
+
+    srand(22);
+    make_subjects(subjects, NUM_SUBJECTS, buf, "abcdx@.com ");
+
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        for (size_t j = 0; j < sizeof(engines) / sizeof(engines[0]); j++) {
+            re_pattern_t *pattern = re_pattern_compile_flags(patterns[i], engines[j]);
+
+            for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+                memset(matched, 0xa5, NUM_SUBJECTS / 8 + 1);
+                memset(spans, 0xa5, NUM_SUBJECTS * sizeof(re_span_t));
+
+                // either result alone, or both at once
+                size_t matches = re_pattern_match_batch(pattern, subjects, NUM_SUBJECTS, matched, NULL, threads[k]);
+                expect(tester, same_as_serial(pattern, subjects, NUM_SUBJECTS, matched, NULL, matches));
+
+                matches = re_pattern_match_batch(pattern, subjects, NUM_SUBJECTS, NULL, spans, threads[k]);
+                expect(tester, same_as_serial(pattern, subjects, NUM_SUBJECTS, NULL, spans, matches));
+
+                matches = re_pattern_match_batch(pattern, subjects, NUM_SUBJECTS, matched, spans, threads[k]);
+                expect(tester, same_as_serial(pattern, subjects, NUM_SUBJECTS, matched, spans, matches));
+            }
+
+            re_pattern_free(pattern);
+        }
+    }
+
+    free(subjects);
+    free(buf);
+    free(matched);
+    free(spans);
+
+    log_tests(tester);
+}
+
+void test_batch_edges() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern = re_pattern_compile("b+");
+    const re_subject_t subjects[] = { { "abba", 4 }, { "", 0 }, { "xb", 2 }, { "a\0b", 3 }, { "aaa", 3 } };
+    unsigned char matched[1] = { 0xff };
+    re_span_t spans[5];
+
+    // nothing to match
+    expect(tester, re_pattern_match_batch(pattern, subjects, 0, NULL, NULL, 0) == 0);
+
+    // the count alone, with fewer subjects than threads
+    expect(tester, re_pattern_match_batch(pattern, subjects, 5, NULL, NULL, 16) == 3);
+
+    // the bits past the last subject are left alone
+    expect(tester, re_pattern_match_batch(pattern, subjects, 5, matched, spans, 16) == 3);
+    expect(tester, matched[0] == (0xe0 | 0x0d));
+    expect(tester, spans[0].start == 1 && spans[0].len == 1);
+    expect(tester, spans[1].start == RE_NO_GROUP);
+    expect(tester, spans[3].start == 2 && spans[3].len == 1);
+    expect(tester, spans[4].start == RE_NO_GROUP);
+
+    re_pattern_free(pattern);
+    log_tests(tester);
+}
+
+typedef struct shared {
+    const re_pattern_t *pattern;
+    const re_subject_t *subjects;
+    size_t              n;
+    size_t              matches;
+} shared_t;
+
+static void *match_shared(void *arg) {
+    shared_t *shared = arg;
+    shared->matches = re_pattern_match_batch(shared->pattern, shared->subjects, shared->n, NULL, NULL, 2);
+    return NULL;
+}
+
+void test_batch_shared() {
+    testing_logger_t *tester = create_tester();
+    re_subject_t *subjects = malloc(NUM_SUBJECTS * sizeof(re_subject_t));
+    char *buf = malloc(NUM_SUBJECTS * 40);
+
+    srand(23);
+    make_subjects(subjects, NUM_SUBJECTS, buf, "abcx");
+
+    // one subject far longer than the rest leaves its thread behind, so the
+    // others take over its share
+    char *large = malloc(1 << 20);
+    memset(large, 'a', 1 << 20);
+    subjects[0] = (re_subject_t) { large, 1 << 20 };
+
+    // the DFA is taken over by one thread at a time, and everything else is
+    // only read, so batches on one pattern can run at once
+    re_pattern_t *pattern = re_pattern_compile_flags("a[bc]*x", RE_DFA);
+    const size_t expected = re_pattern_match_batch(pattern, subjects, NUM_SUBJECTS, NULL, NULL, 1);
+    shared_t shared[NUM_THREADS];
+    pthread_t threads[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        shared[i] = (shared_t) { pattern, subjects, NUM_SUBJECTS, 0 };
+        pthread_create(&threads[i], NULL, match_shared, &shared[i]);
+    }
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        expect(tester, shared[i].matches == expected);
+    }
+
+    re_pattern_free(pattern);
+    free(large);
+    free(subjects);
+    free(buf);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_batch_results();
+    test_batch_edges();
+    test_batch_shared();
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "regex.h"
+#include "cache.h"
+
+#include "testing-logger.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_THREADS 8
+#define NUM_CALLS   2000
+
+/* returns the cache's counters */
+static re_cache_stats_t stats(void) {
+    re_cache_stats_t stats;
+    re_cache_get_stats(&stats);
+    return stats;
+}
+
+void test_cache_hits() {
+    testing_logger_t *tester = create_tester();
+    re_cache_clear();
+
+    expect(tester, stats().capacity == CACHE_DEFAULT_CAPACITY);
+
+    // the first call compiles the pattern, and the rest reuse it
+    for (int i = 0; i < 10; i++)
+        expect(tester, re_is_match("b+c", "abbbcd"));
+    expect(tester, stats().misses == 1 && stats().hits == 9);
+    expect(tester, stats().size == 1);
+
+    // re_get_match shares the cache
+    char *match = re_get_match("b+c", "abbbcd");
+    expect(tester, match && !strcmp(match, "bbbc"));
+    free(match);
+    expect(tester, stats().misses == 1 && stats().hits == 10);
+
+    // a malformed pattern is never cached
+    expect(tester, !re_is_match("[ab", "a"));
+    expect(tester, !re_is_match("[ab", "a"));
+    expect(tester, stats().misses == 3 && stats().size == 1);
+
+    re_cache_clear();
+    expect(tester, stats().size == 0 && stats().hits == 0 && stats().misses == 0);
+
+    log_tests(tester);
+}
+
+void test_cache_lru() {
+    testing_logger_t *tester = create_tester();
+    re_cache_clear();
+    re_cache_set_capacity(2);
+
+    re_is_match("a", "a");
+    re_is_match("b", "b");
+
+    // using `a` makes `b` the least recently used pattern
+    re_is_match("a", "a");
+    re_is_match("c", "c");
+    expect(tester, stats().size == 2 && stats().evictions == 1);
+
+    expect(tester, re_is_match("a", "a"));
+    expect(tester, stats().hits == 2 && stats().misses == 3);
+    expect(tester, re_is_match("b", "b"));
+    expect(tester, stats().hits == 2 && stats().misses == 4);
+
+    // shrinking the cache evicts straight away
+    re_cache_set_capacity(1);
+    expect(tester, stats().size == 1 && stats().evictions == 3);
+    expect(tester, re_is_match("b", "b"));
+    expect(tester, stats().hits == 3);
+
+    // without a cache, every call compiles its pattern
+    re_cache_set_capacity(0);
+    expect(tester, stats().size == 0);
+    expect(tester, re_is_match("b", "b"));
+    expect(tester, re_is_match("b", "b"));
+    expect(tester, stats().hits == 3 && stats().misses == 6);
+
+    re_cache_set_capacity(CACHE_DEFAULT_CAPACITY);
+    re_cache_clear();
+
+    log_tests(tester);
+}
+
+void test_cache_entries() {
+    testing_logger_t *tester = create_tester();
+    re_cache_clear();
+    re_cache_set_capacity(1);
+
+    // an entry in use survives its eviction, until it is given back
+    cache_entry_t *entry = cache_acquire("x+y");
+    expect(tester, entry && entry->cached && entry->refs == 1);
+    expect(tester, re_is_match("z", "z"));
+    expect(tester, !entry->cached);
+    expect(tester, re_pattern_match(entry->pattern, "axxy"));
+    cache_release(entry);
+
+    // the same pattern is shared by every caller
+    cache_entry_t *first = cache_acquire("z");
+    cache_entry_t *second = cache_acquire("z");
+    expect(tester, first == second && first->refs == 2);
+    cache_release(first);
+    cache_release(second);
+
+    re_cache_set_capacity(CACHE_DEFAULT_CAPACITY);
+    re_cache_clear();
+
+    log_tests(tester);
+}
+
+/* calls re_is_match with a few patterns, returning the number of wrong results.
+   The threads share the DFA of the pattern with a group */
+static void *worker(void *arg) {
+    static char *const patterns[] = { "\\d+ms", "^(GET|HEAD) /", "[a-z]+@[a-z]+\\.com", "x*y$" };
+    static char *const texts[] = { "took 12ms", "GET /index", "mail bob@example.com", "xxy" };
+    size_t *wrong = arg;
+
+    for (int i = 0; i < NUM_CALLS; i++) {
+        const int p = i % 4, t = (i / 4) % 4;
+        if (re_is_match(patterns[p], texts[t]) != (p == t))
+            (*wrong)++;
+    }
+
+    return NULL;
+}
+
+void test_cache_threads() {
+    testing_logger_t *tester = create_tester();
+    re_cache_clear();
+
+    // a small cache keeps patterns being evicted while they are in use
+    re_cache_set_capacity(2);
+
+    pthread_t threads[NUM_THREADS];
+    size_t wrong[NUM_THREADS] = {0};
+    for (int i = 0; i < NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, worker, &wrong[i]);
+
+    size_t total = 0;
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        total += wrong[i];
+    }
+
+    expect(tester, total == 0);
+    expect(tester, stats().hits + stats().misses == NUM_THREADS * NUM_CALLS);
+    expect(tester, stats().size == 2);
+
+    re_cache_set_capacity(CACHE_DEFAULT_CAPACITY);
+    re_cache_clear();
+
+    log_tests(tester);
+}
+
+int main() {
+    test_cache_hits();
+    test_cache_lru();
+    test_cache_entries();
+    test_cache_threads();
+
+    return 0;
+}
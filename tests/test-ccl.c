@@ -0,0 +1,203 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "ccl.h"
+
+#include "testing-logger.h"
+#include <string.h>
+
+#define BUF_LEN 300
+
+/* builds a scanner for the first `re_t` of `regexp` */
+static void compile(ccl_t *ccl, const char *regexp) {
+    re_t *reg = re_compile(regexp);
+    ccl_compile(ccl, reg);
+    re_free(reg);
+}
+
+/* returns the kernels this machine can run for `ccl` */
+static int kernels(const ccl_t *ccl, ccl_kernel_t *out) {
+    int n = 0;
+    out[n++] = CCL_SCALAR;
+
+#if defined(__x86_64__)
+    if (ccl->nranges <= CCL_MAX_RANGES)
+        out[n++] = CCL_SSE2;
+    if (__builtin_cpu_supports("avx2"))
+        out[n++] = CCL_AVX2;
+#else
+    (void) ccl;
+#endif
+
+    return n;
+}
+
+void test_ccl_compile() {
+    testing_logger_t *tester = create_tester();
+    ccl_t ccl;
+
+    compile(&ccl, "[a-z]");
+    expect(tester, ccl_has(&ccl, 'a') && ccl_has(&ccl, 'm') && ccl_has(&ccl, 'z'));
+    expect(tester, !ccl_has(&ccl, 'A') && !ccl_has(&ccl, '\0') && !ccl_has(&ccl, 0xe9));
+    expect(tester, ccl.nranges == 1 && !ccl.invert);
+    expect(tester, ccl.lo[0] == 'a' && ccl.width[0] == 25);
+
+    // '\0' is an ordinary character, so a negated class accepts it
+    compile(&ccl, "[^\n]");
+    expect(tester, ccl_has(&ccl, 'a') && ccl_has(&ccl, 0xff) && ccl_has(&ccl, '\0'));
+    expect(tester, !ccl_has(&ccl, '\n'));
+    expect(tester, ccl.nranges == 1 && ccl.invert);
+
+    compile(&ccl, ".");
+    expect(tester, ccl_has(&ccl, 1) && ccl_has(&ccl, 0x80) && ccl_has(&ccl, '\0'));
+    expect(tester, ccl.nranges == 0 && ccl.invert);
+
+    compile(&ccl, "x");
+    expect(tester, ccl_has(&ccl, 'x') && !ccl_has(&ccl, 'y'));
+
+    log_tests(tester);
+}
+
+void test_ccl_span() {
+    testing_logger_t *tester = create_tester();
+    char *classes[] = { "[a-zA-Z0-9]", "[^\n]", ".", "[\n\t\r ]", "[acegikmoqsuwy02468]" };
+    ccl_kernel_t available[3];
+    ccl_t ccl;
+
+    // a buffer (with embedded zeros) with runs of every length at every alignment
+    char *buf = malloc(BUF_LEN);
+    for (int i = 0; i < BUF_LEN; i++)
+        buf[i] = "abcdefgh12 \n\xe9-\0"[(i * 7 + i / 13) % 15];
+
+    for (size_t c = 0; c < sizeof(classes) / sizeof(classes[0]); c++) {
+        compile(&ccl, classes[c]);
+        int n = kernels(&ccl, available);
+
+        for (int k = 0; k < n; k++) {
+            ccl.kernel = available[k];
+
+            int ok = 1;
+            for (int i = 0; i < BUF_LEN; i++) {
+                const char *span = buf + i;
+                while (span < buf + BUF_LEN && ccl_has(&ccl, *span))
+                    span++;
+
+                ok &= ccl_span(&ccl, buf + i, buf + BUF_LEN) == span;
+            }
+            expect(tester, ok);
+        }
+    }
+
+    // the end of the text always ends the span
+    compile(&ccl, ".");
+    for (int k = 0, n = kernels(&ccl, available); k < n; k++) {
+        ccl.kernel = available[k];
+        expect(tester, ccl_span(&ccl, buf, buf + BUF_LEN) == buf + BUF_LEN);
+        expect(tester, ccl_span(&ccl, buf + 5, buf + 77) == buf + 77);
+        expect(tester, ccl_span(&ccl, buf + BUF_LEN, buf + BUF_LEN) == buf + BUF_LEN);
+    }
+
+    free(buf);
+    log_tests(tester);
+}
+
+void test_ccl_find() {
+    testing_logger_t *tester = create_tester();
+    char *classes[] = { "[0-9]", "[^a-z]", "[\xe9]", "[acegikmoqsuwy02468]" };
+    ccl_kernel_t available[3];
+    ccl_t ccl;
+
+    char *buf = malloc(BUF_LEN);
+    for (int i = 0; i < BUF_LEN; i++)
+        buf[i] = i % 61 == 60 ? '7' : i % 97 == 96 ? '\xe9' : 'a' + i % 26;
+
+    for (size_t c = 0; c < sizeof(classes) / sizeof(classes[0]); c++) {
+        compile(&ccl, classes[c]);
+        int n = kernels(&ccl, available);
+
+        for (int k = 0; k < n; k++) {
+            ccl.kernel = available[k];
+
+            // search every (start, end) window of the buffer's first half
+            int ok = 1;
+            for (int i = 0; i < BUF_LEN / 2; i++) {
+                for (int j = i; j < BUF_LEN; j += 17) {
+                    const char *hit = buf + i;
+                    while (hit < buf + j && !ccl_has(&ccl, *hit))
+                        hit++;
+
+                    ok &= ccl_find(&ccl, buf + i, buf + j) == (hit < buf + j ? hit : NULL);
+                }
+            }
+            expect(tester, ok);
+        }
+    }
+
+    free(buf);
+    log_tests(tester);
+}
+
+void test_ccl_annotate() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+    ccl_t *runs;
+
+    // the run can never be followed from inside, so it is annotated
+    reg = re_compile("[a-z]*@[a-z]+\\.");
+    runs = ccl_annotate(reg, NULL);
+    expect(tester, reg[0].run == &runs[0]);
+    expect(tester, reg[3].run == &runs[1]);
+    free(runs);
+    re_free(reg);
+
+    reg = re_compile("^.*$");
+    runs = ccl_annotate(reg, NULL);
+    expect(tester, reg[1].run == &runs[0]);
+    free(runs);
+    re_free(reg);
+
+    // the next atom may match inside the run, or is optional
+    reg = re_compile("[a-z]*b.*x?[0-9]+");
+    expect(tester, ccl_annotate(reg, NULL) == NULL);
+    expect(tester, reg[0].run == NULL && reg[3].run == NULL);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_ccl_match() {
+    testing_logger_t *tester = create_tester();
+    char *res;
+
+    // runs that are skipped in one scan give the same matches
+    res = re_get_match("\"[^\"]*\"", "echo \"hello world\" \"again\"");
+    expect(tester, res && !strcmp(res, "\"hello world\""));
+    free(res);
+
+    res = re_get_match("\\w+@\\w+\\.com", "mail testemail@gmail.com now");
+    expect(tester, res && !strcmp(res, "testemail@gmail.com"));
+    free(res);
+
+    res = re_get_match("[0-9]+ms", "took 1234ms");
+    expect(tester, res && !strcmp(res, "1234ms"));
+    free(res);
+
+    expect(tester, re_is_match("^[^\n]*$", "no newline here"));
+    expect(tester, !re_is_match("^[^\n]*$", "one\nnewline"));
+    expect(tester, !re_is_match("\"[^\"]*\"", "echo \"unterminated"));
+
+    // the first class of a pattern rules out positions before it
+    expect(tester, re_is_match("[0-9]+\\.", "version 12."));
+    expect(tester, !re_is_match("[0-9]+\\.", "no version."));
+
+    log_tests(tester);
+}
+
+int main() {
+    test_ccl_compile();
+    test_ccl_span();
+    test_ccl_find();
+    test_ccl_annotate();
+    test_ccl_match();
+
+    return 0;
+}
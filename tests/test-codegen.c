@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "regex.h"
+#include "codegen.h"
+
+// generated by the Makefile from tests/shell-tokens.txt
+#include "shell-matcher.h"
+
+#include "testing-logger.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* the patterns of tests/shell-tokens.txt */
+static const char *const PATTERNS[] = {
+    "if", "then", "fi", "[a-z_][a-z_0-9]*", "\\d+", "\\s+", ">>", ">", "\\|", "-", "\"[^\"]*\"", "--?[a-z]+(=\\w+)?"
+};
+#define NUM_TOKENS (sizeof(PATTERNS) / sizeof(PATTERNS[0]))
+
+/* returns the number of positions of `text` where the generated matcher and
+   the set disagree */
+static int differences(const re_set_t *set, const char *text, size_t len) {
+    int wrong = 0;
+
+    for (size_t i = 0; i <= len; i++) {
+        int token = -1, expected = -1;
+        long match = shell_match(text + i, len - i, &token);
+
+        if (match != re_set_match(set, text + i, len - i, &expected) || token != expected)
+            wrong++;
+    }
+
+    return wrong;
+}
+
+void test_codegen_tokens() {
+    testing_logger_t *tester = create_tester();
+    int token = -1;
+
+    expect(tester, SHELL_NUM_TOKENS == NUM_TOKENS);
+
+    expect(tester, shell_match("iffy", 4, &token) == 4 && token == SHELL_WORD);
+    expect(tester, shell_match("if x", 4, &token) == 2 && token == SHELL_IF);
+    expect(tester, shell_match(">> out", 6, &token) == 2 && token == SHELL_APPEND);
+    expect(tester, shell_match("--color=auto", 12, &token) == 12 && token == SHELL_FLAG);
+    expect(tester, shell_match("\"a b\" c", 7, &token) == 5 && token == SHELL_STRING);
+
+    // the length bounds the match, even inside a string with more
+    expect(tester, shell_match("then", 3, &token) == 3 && token == SHELL_WORD);
+
+    // nothing matches, so the token is left alone
+    token = -1;
+    expect(tester, shell_match("&&", 2, &token) == -1 && token == -1);
+    expect(tester, shell_match("", 0, &token) == -1 && token == -1);
+
+    log_tests(tester);
+}
+
+void test_codegen_differential() {
+    testing_logger_t *tester = create_tester();
+    int tokens[NUM_TOKENS];
+    for (size_t i = 0; i < NUM_TOKENS; i++)
+        tokens[i] = i;
+
+    re_set_t *set = re_set_compile(PATTERNS, tokens, NUM_TOKENS);
+    expect(tester, set != NULL);
+
+    const char *script = "if test -f out.log then\n  cat out.log | grep --count=3 \"ok\" >> all_2\nfi\n";
+    expect(tester, differences(set, script, strlen(script)) == 0);
+
+    // random text over an alphabet the tokens care about, and some bytes they do not
+    static const char alphabet[] = "ifthen_az09 \t\n>|-=\"&\x80\xff";
+    char text[256];
+    int wrong = 0;
+
+    srand(18);
+    for (int round = 0; round < 200; round++) {
+        for (size_t i = 0; i < sizeof(text); i++)
+            text[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        wrong += differences(set, text, sizeof(text));
+    }
+    expect(tester, wrong == 0);
+
+    re_set_free(set);
+    log_tests(tester);
+}
+
+void test_codegen_write() {
+    testing_logger_t *tester = create_tester();
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&buf, &len);
+
+    static const char *const names[] = { "star", "word" };
+    static const char *const patterns[] = { "a*/", "/*b" };
+
+    // a pattern is written into a comment without ending it
+    expect(tester, codegen_write(out, "lex", names, patterns, 2));
+    fflush(out);
+    expect(tester, strstr(buf, "LEX_STAR,  /* a* / */") != NULL);
+    expect(tester, strstr(buf, "LEX_WORD,  /* / *b */") != NULL);
+    expect(tester, strstr(buf, "static long lex_match(") != NULL);
+
+    // names must make identifiers, and patterns must compile
+    static const char *const bad_name[] = { "a-b" };
+    static const char *const bad_pattern[] = { "[ab" };
+    expect(tester, !codegen_write(out, "lex", bad_name, patterns, 1));
+    expect(tester, !codegen_write(out, "1lex", names, patterns, 1));
+    expect(tester, !codegen_write(out, "lex", names, bad_pattern, 1));
+    expect(tester, !codegen_write(out, "lex", names, patterns, 0));
+
+    fclose(out);
+    free(buf);
+    log_tests(tester);
+}
+
+int main() {
+    test_codegen_tokens();
+    test_codegen_differential();
+    test_codegen_write();
+
+    return 0;
+}
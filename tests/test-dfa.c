@@ -0,0 +1,166 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "dfa.h"
+#include "regex-cases.h"
+
+#include "testing-logger.h"
+#include <string.h>
+
+void test_dfa_suite() {
+    testing_logger_t *tester = create_tester();
+
+    // every case from the regex suite gives the same result on the DFA
+    for (size_t i = 0; i < NUM_REGEX_CASES; i++) {
+        const regex_case_t *test = &REGEX_CASES[i];
+        re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, RE_DFA);
+
+        expect(tester, pattern != NULL);
+        expect(tester, re_pattern_match(pattern, test->text) == test->match);
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_dfa_find() {
+    testing_logger_t *tester = create_tester();
+
+    for (size_t i = 0; i < NUM_REGEX_FIND_CASES; i++) {
+        const regex_find_case_t *test = &REGEX_FIND_CASES[i];
+        re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, RE_DFA);
+        char *res = re_pattern_find(pattern, test->text);
+
+        if (test->found)
+            expect(tester, res && !strcmp(res, test->found));
+        else
+            expect(tester, res == NULL);
+
+        free(res);
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_dfa_end() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+    prog_t *prog;
+    dfa_t *dfa;
+    char *text;
+
+    reg = re_compile("^a*$");
+    prog = nfa_compile(reg, NULL);
+    dfa = dfa_new(prog, DFA_DEFAULT_BUDGET);
+
+    text = "";
+    expect(tester, dfa_is_match(dfa, text, text, 1));
+    text = "aaaa";
+    expect(tester, dfa_is_match(dfa, text, text + strlen(text), 1));
+    text = "aaab";
+    expect(tester, !dfa_is_match(dfa, text, text + strlen(text), 1));
+
+    // only the given range of the text is matched
+    expect(tester, dfa_is_match(dfa, text, text + 3, 1));
+
+    dfa_free(dfa);
+    nfa_free(prog);
+    re_free(reg);
+
+    // the bounds of a group are passed through, even right before the end
+    reg = re_compile("^(ab)+($)");
+    prog = nfa_compile(reg, NULL);
+    dfa = dfa_new(prog, DFA_DEFAULT_BUDGET);
+
+    text = "abab";
+    expect(tester, dfa_is_match(dfa, text, text + strlen(text), 1));
+    expect(tester, !dfa_is_match(dfa, text, text + 3, 1));
+    expect(tester, !dfa_is_match(dfa, text, text, 1));
+
+    dfa_free(dfa);
+    nfa_free(prog);
+    re_free(reg);
+
+    // `^` in one alternative only matches if the text is the whole input
+    reg = re_compile("x|^a|$^");
+    prog = nfa_compile(reg, NULL);
+    dfa = dfa_new(prog, DFA_DEFAULT_BUDGET);
+
+    text = "ba";
+    expect(tester, dfa_is_match(dfa, text + 1, text + 2, 1));
+    expect(tester, !dfa_is_match(dfa, text + 1, text + 2, 0));
+    expect(tester, !dfa_is_match(dfa, text, text + 2, 1));
+    expect(tester, dfa_is_match(dfa, text, text, 1));
+    expect(tester, !dfa_is_match(dfa, text, text, 0));
+
+    dfa_free(dfa);
+    nfa_free(prog);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_dfa_cache() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg = re_compile("[a-c]+d");
+    prog_t *prog = nfa_compile(reg, NULL);
+    dfa_t *dfa = dfa_new(prog, DFA_DEFAULT_BUDGET);
+    char *text = "xxabcabcdxx";
+
+    // states are materialised on the first run...
+    expect(tester, dfa_is_match(dfa, text, text + strlen(text), 1));
+    size_t nstates = dfa->nstates;
+    expect(tester, nstates > 0);
+
+    // ...and reused on the next
+    expect(tester, dfa_is_match(dfa, text, text + strlen(text), 1));
+    expect(tester, dfa->nstates == nstates);
+    expect(tester, dfa->nflushes == 0);
+    expect(tester, dfa->mem <= DFA_DEFAULT_BUDGET);
+
+    dfa_free(dfa);
+
+    // a budget of a single state flushes the cache on every new state, but
+    // still gives the right answers
+    dfa = dfa_new(prog, 1);
+    expect(tester, dfa_is_match(dfa, text, text + strlen(text), 1));
+    expect(tester, dfa->nflushes > 0);
+    expect(tester, dfa->nstates == 1);
+
+    text = "xxabcabcxx";
+    expect(tester, !dfa_is_match(dfa, text, text + strlen(text), 1));
+
+    dfa_free(dfa);
+    nfa_free(prog);
+    re_free(reg);
+
+    // the budget can be set through the public api
+    re_pattern_t *pattern = re_pattern_compile_flags("[a-c]+d", RE_DFA);
+    re_pattern_set_dfa_budget(pattern, 1);
+    expect(tester, re_pattern_match(pattern, "xxabcabcdxx"));
+    expect(tester, !re_pattern_match(pattern, "xxabcabcxx"));
+    expect(tester, pattern->dfa->nflushes > 0);
+    re_pattern_free(pattern);
+
+    // a pattern for the backtracking matcher asks the DFA whether it
+    // matches, and only finds where with the matcher
+    pattern = re_pattern_compile_flags("[a-c]+d", RE_NO_PREFILTER);
+    expect(tester, pattern->dfa != NULL && !pattern->prog);
+    expect(tester, !re_pattern_match(pattern, "xxabcabcxx"));
+    expect(tester, pattern->dfa->nstates > 0);
+    re_span_t span;
+    expect(tester, re_pattern_span(pattern, "xxabcabcdxx", &span));
+    expect(tester, span.start == 2 && span.len == 7);
+    re_pattern_free(pattern);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_dfa_suite();
+    test_dfa_find();
+    test_dfa_end();
+    test_dfa_cache();
+
+    return 0;
+}
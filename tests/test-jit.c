@@ -0,0 +1,144 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "jit.h"
+#include "regex-cases.h"
+
+#include "testing-logger.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_PATTERNS 2000
+#define TEXT_LEN     24
+
+void test_jit_suite() {
+    testing_logger_t *tester = create_tester();
+
+    // every case from the regex suite gives the same result in native code
+    for (size_t i = 0; i < NUM_REGEX_CASES; i++) {
+        const regex_case_t *test = &REGEX_CASES[i];
+        re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, RE_JIT);
+
+        expect(tester, pattern != NULL);
+        expect(tester, re_pattern_match(pattern, test->text) == test->match);
+        re_pattern_free(pattern);
+    }
+
+    for (size_t i = 0; i < NUM_REGEX_FIND_CASES; i++) {
+        const regex_find_case_t *test = &REGEX_FIND_CASES[i];
+        re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, RE_JIT);
+        char *res = re_pattern_find(pattern, test->text);
+
+        if (test->found)
+            expect(tester, res && !strcmp(res, test->found));
+        else
+            expect(tester, res == NULL);
+
+        free(res);
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_jit_compiled() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+
+#if defined(__x86_64__)
+    static const char *const patterns[] = {
+        "\\w+@\\w+\\.com", "^[^\n]*$", "a?b", "x{2,4}y", "[0-9]{3}", ".*z", "^$", "abc\\."
+    };
+
+    // the backtracking matcher's programs are all compiled
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        pattern = re_pattern_compile_flags(patterns[i], RE_JIT);
+        expect(tester, pattern->jit != NULL);
+        re_pattern_free(pattern);
+    }
+#endif
+
+    // without the flag, or on the Pike VM, the program is interpreted
+    pattern = re_pattern_compile("abc");
+    expect(tester, pattern->jit == NULL);
+    re_pattern_free(pattern);
+
+    pattern = re_pattern_compile_flags("(ab)+", RE_JIT);
+    expect(tester, pattern->jit == NULL);
+    expect(tester, re_pattern_match(pattern, "xabab"));
+    re_pattern_free(pattern);
+
+    jit_free(NULL);
+
+    log_tests(tester);
+}
+
+/* writes a random pattern of the backtracking matcher's constructs */
+static void random_pattern(char *buf) {
+    static const char *const atoms[] = { "a", "b", ".", "[ab]", "[^a]", "\\d", "x", "\\w" };
+    static const char *const quantifiers[] = { "", "", "*", "+", "?", "{2}", "{0,2}", "{1,}" };
+    const int natoms = 1 + rand() % 5;
+
+    strcpy(buf, rand() % 4 ? "" : "^");
+    for (int i = 0; i < natoms; i++) {
+        strcat(buf, atoms[rand() % 8]);
+        strcat(buf, quantifiers[rand() % 8]);
+    }
+    strcat(buf, rand() % 4 ? "" : "$");
+}
+
+void test_jit_differential() {
+    testing_logger_t *tester = create_tester();
+    static const char alphabet[] = "ab1x ";
+    char regexp[128], text[TEXT_LEN];
+    int wrong = 0, compiled = 0;
+
+    srand(19);
+    for (int i = 0; i < NUM_PATTERNS; i++) {
+        random_pattern(regexp);
+        re_pattern_t *pattern = re_pattern_compile_flags(regexp, RE_JIT);
+
+        // a pattern that is memoized is left to the interpreter, but its
+        // native code must still agree with it
+        const int start = pattern->code->inst[0].type == BEGIN;
+        jit_t *jit = pattern->jit ? pattern->jit : jit_compile(pattern->code, start);
+
+        if (!jit) {
+            re_pattern_free(pattern);
+            continue;
+        }
+
+        compiled++;
+        const re_inst_t *inst = pattern->code->inst + start;
+
+        // the native code ends every match where the interpreter does
+        for (int round = 0; round < 8; round++) {
+            const int len = rand() % TEXT_LEN;
+            for (int j = 0; j < len; j++)
+                text[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+
+            for (int j = 0; j <= len; j++) {
+                if (jit->match(text + j, text + len) != match_here(pattern->code, inst, text + j, text + len))
+                    wrong++;
+            }
+        }
+
+        if (jit != pattern->jit)
+            jit_free(jit);
+        re_pattern_free(pattern);
+    }
+
+#if defined(__x86_64__)
+    expect(tester, compiled == NUM_PATTERNS);
+#endif
+    expect(tester, wrong == 0);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_jit_suite();
+    test_jit_compiled();
+    test_jit_differential();
+
+    return 0;
+}
@@ -0,0 +1,372 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "nfa.h"
+#include "regex-cases.h"
+
+#include "testing-logger.h"
+#include <stdlib.h>
+#include <string.h>
+
+void test_nfa_compile() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+    prog_t *prog;
+
+    // literals compile one-for-one
+    reg = re_compile("ab");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->len == 3);
+    expect(tester, !prog->anchored);
+    expect(tester, prog->inst[0].op == OP_CHAR && prog->inst[0].c == 'a');
+    expect(tester, prog->inst[1].op == OP_CHAR && prog->inst[1].c == 'b');
+    expect(tester, prog->inst[2].op == OP_MATCH);
+    nfa_free(prog);
+    re_free(reg);
+
+    // `*` prefers to skip the atom
+    reg = re_compile("^a*$");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->anchored);
+    expect(tester, prog->len == 5);
+    expect(tester, prog->inst[0].op == OP_SPLIT);
+    expect(tester, prog->inst[0].x == 3 && prog->inst[0].y == 1);
+    expect(tester, prog->inst[1].op == OP_CHAR);
+    expect(tester, prog->inst[2].op == OP_JMP && prog->inst[2].x == 0);
+    expect(tester, prog->inst[3].op == OP_EOL);
+    expect(tester, prog->inst[4].op == OP_MATCH);
+    nfa_free(prog);
+    re_free(reg);
+
+    // `+` loops back to the atom, `?` prefers to consume it
+    reg = re_compile("[ab]+.?");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->len == 5);
+    expect(tester, prog->inst[0].op == OP_CLASS && prog->inst[0].cl == &reg[0]);
+    expect(tester, prog->inst[1].op == OP_SPLIT);
+    expect(tester, prog->inst[1].x == 2 && prog->inst[1].y == 0);
+    expect(tester, prog->inst[2].op == OP_SPLIT);
+    expect(tester, prog->inst[2].x == 3 && prog->inst[2].y == 4);
+    expect(tester, prog->inst[3].op == OP_ANY);
+    expect(tester, prog->inst[4].op == OP_MATCH);
+    nfa_free(prog);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_nfa_groups() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+    prog_t *prog;
+
+    // a group saves where it begins and ends
+    reg = re_compile("a(b)");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->nslots == 2);
+    expect(tester, prog->len == 5);
+    expect(tester, prog->inst[1].op == OP_SAVE && prog->inst[1].x == 0);
+    expect(tester, prog->inst[2].op == OP_CHAR && prog->inst[2].c == 'b');
+    expect(tester, prog->inst[3].op == OP_SAVE && prog->inst[3].x == 1);
+    nfa_free(prog);
+    re_free(reg);
+
+    // a quantified group loops (or skips) as a whole, like an atom
+    reg = re_compile("(a)*(b)+(c)?");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->nslots == 6);
+    expect(tester, prog->inst[0].op == OP_SPLIT);
+    expect(tester, prog->inst[0].x == 5 && prog->inst[0].y == 1);
+    expect(tester, prog->inst[4].op == OP_JMP && prog->inst[4].x == 0);
+    expect(tester, prog->inst[5].op == OP_SAVE && prog->inst[5].x == 2);
+    expect(tester, prog->inst[8].op == OP_SPLIT);
+    expect(tester, prog->inst[8].x == 9 && prog->inst[8].y == 5);
+    expect(tester, prog->inst[9].op == OP_SPLIT);
+    expect(tester, prog->inst[9].x == 10 && prog->inst[9].y == 13);
+    expect(tester, prog->inst[13].op == OP_MATCH);
+    nfa_free(prog);
+    re_free(reg);
+
+    // the slots of the winning thread are kept
+    const char *text = "x key=val;", *start, *caps[4];
+    reg = re_compile("([a-z]+)=([a-z]*);");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, nfa_captures(prog, NULL, text, text + strlen(text), 1, &start, caps) == text + 10);
+    expect(tester, start == text + 2);
+    expect(tester, caps[0] == text + 2 && caps[1] == text + 5);
+    expect(tester, caps[2] == text + 6 && caps[3] == text + 9);
+    nfa_free(prog);
+    re_free(reg);
+
+    // a group that was skipped is left unset, and a loop keeps its last pass
+    text = "abab";
+    reg = re_compile("(x)?(ab)+$");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, nfa_captures(prog, NULL, text, text + 4, 1, &start, caps) == text + 4);
+    expect(tester, caps[0] == NULL && caps[1] == NULL);
+    expect(tester, caps[2] == text + 2 && caps[3] == text + 4);
+    nfa_free(prog);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_nfa_alternation() {
+    testing_logger_t *tester = create_tester();
+    const char *text, *start, *caps[4];
+    re_t *reg;
+    prog_t *prog;
+
+    // split L1, L2; L1: a; jmp L3; L2: b; L3:
+    reg = re_compile("a|b");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->len == 5);
+    expect(tester, prog->inst[0].op == OP_SPLIT);
+    expect(tester, prog->inst[0].x == 1 && prog->inst[0].y == 3);
+    expect(tester, prog->inst[1].op == OP_CHAR && prog->inst[1].c == 'a');
+    expect(tester, prog->inst[2].op == OP_JMP && prog->inst[2].x == 4);
+    expect(tester, prog->inst[3].op == OP_CHAR && prog->inst[3].c == 'b');
+    nfa_free(prog);
+    re_free(reg);
+
+    // neighbours share their first character, as in `i(f|n(|t))`
+    reg = re_compile("if|in|int");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->len == 9);
+    expect(tester, prog->inst[0].op == OP_CHAR && prog->inst[0].c == 'i');
+    expect(tester, prog->inst[4].op == OP_CHAR && prog->inst[4].c == 'n');
+    text = "print";
+    expect(tester, nfa_search(prog, NULL, text, text + 5, 1, &start) == text + 4);
+    expect(tester, start == text + 2);
+    nfa_free(prog);
+    re_free(reg);
+
+    // but only neighbours, so `ab` keeps its priority over `b`
+    reg = re_compile("ab|b|ac");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->inst[1].op == OP_CHAR && prog->inst[1].c == 'a');
+    expect(tester, prog->inst[7].op == OP_CHAR && prog->inst[7].c == 'a');
+    nfa_free(prog);
+    re_free(reg);
+
+    // the `^` of every alternative anchors the program
+    reg = re_compile("^ab|^ac");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->anchored);
+    expect(tester, prog->len == 6);
+    nfa_free(prog);
+    re_free(reg);
+
+    // the alternatives of a group are captured as a whole
+    text = "abcd";
+    reg = re_compile("(a|ab)(c|bcd)");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, nfa_captures(prog, NULL, text, text + 4, 1, &start, caps) == text + 4);
+    expect(tester, caps[0] == text && caps[1] == text + 1);
+    expect(tester, caps[2] == text + 1 && caps[3] == text + 4);
+    nfa_free(prog);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_nfa_repeat() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+    prog_t *prog;
+
+    // the first copy is required, and each after it prefers to stop
+    reg = re_compile("a{1,3}");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->len == 6);
+    expect(tester, prog->inst[0].op == OP_CHAR);
+    expect(tester, prog->inst[1].op == OP_SPLIT);
+    expect(tester, prog->inst[1].x == 5 && prog->inst[1].y == 2);
+    expect(tester, prog->inst[3].op == OP_SPLIT);
+    expect(tester, prog->inst[3].x == 5 && prog->inst[3].y == 4);
+    expect(tester, prog->inst[5].op == OP_MATCH);
+    nfa_free(prog);
+    re_free(reg);
+
+    // without a maximum, the last copy loops
+    reg = re_compile("(ab){2,}");
+    prog = nfa_compile(reg, NULL);
+    expect(tester, prog->len == 15);
+    expect(tester, prog->inst[8].op == OP_SPLIT && prog->inst[8].x == 14);
+    expect(tester, prog->inst[13].op == OP_JMP && prog->inst[13].x == 8);
+    nfa_free(prog);
+    re_free(reg);
+
+    // too many copies, even when each repetition is in bounds
+    reg = re_compile("(a{100}){101}");
+    expect(tester, nfa_compile(reg, NULL) == NULL);
+    re_free(reg);
+
+    reg = re_compile("a{1000}b{1000}c{1000}d{1000}e{1000}f{1000}g{1000}h{1000}i{1000}j{1000}");
+    expect(tester, nfa_compile(reg, NULL) == NULL);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_nfa_suite() {
+    testing_logger_t *tester = create_tester();
+
+    // every case from the regex suite gives the same result on the NFA
+    for (size_t i = 0; i < NUM_REGEX_CASES; i++) {
+        const regex_case_t *test = &REGEX_CASES[i];
+        re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, RE_NFA);
+
+        expect(tester, pattern != NULL);
+        expect(tester, re_pattern_match(pattern, test->text) == test->match);
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_nfa_find() {
+    testing_logger_t *tester = create_tester();
+
+    // the NFA reports the same (leftmost, shortest repetition) match
+    for (size_t i = 0; i < NUM_REGEX_FIND_CASES; i++) {
+        const regex_find_case_t *test = &REGEX_FIND_CASES[i];
+        re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, RE_NFA);
+        char *res = re_pattern_find(pattern, test->text);
+
+        if (test->found)
+            expect(tester, res && !strcmp(res, test->found));
+        else
+            expect(tester, res == NULL);
+
+        free(res);
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_nfa_pathological() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+
+    // nested stars against a long non-matching text would make the
+    // backtracking matcher take O(n^4) steps
+    char *text = malloc(20001);
+    for (int i = 0; i < 20000; i++)
+        text[i] = i % 2 ? 'x' : 'y';
+    text[20000] = '\0';
+
+    pattern = re_pattern_compile_flags(".*x.*y.*z", RE_NFA);
+    expect(tester, !re_pattern_match(pattern, text));
+    re_pattern_free(pattern);
+
+    text[19999] = 'z';
+    pattern = re_pattern_compile_flags(".*x.*y.*z", RE_NFA);
+    expect(tester, re_pattern_match(pattern, text));
+    re_pattern_free(pattern);
+
+    free(text);
+    log_tests(tester);
+}
+
+/* returns true if `pattern` compiled with `flags` finds the same match in
+   `text` as it does on the backtracking matcher */
+static int same_span(const char *pattern, int flags, const char *text) {
+    re_pattern_t *bt = re_pattern_compile(pattern), *other = re_pattern_compile_flags(pattern, flags);
+    const size_t len = strlen(text);
+    re_span_t a = { 0, 0 }, b = { 0, 0 };
+
+    const int match = re_pattern_span_n(bt, text, len, &a);
+    const int same = match == re_pattern_span_n(other, text, len, &b) && a.start == b.start && a.len == b.len;
+
+    re_pattern_free(bt);
+    re_pattern_free(other);
+    return same;
+}
+
+void test_nfa_engines() {
+    testing_logger_t *tester = create_tester();
+    static const int engines[] = { RE_NFA, RE_DFA, RE_JIT, RE_MEMO };
+    static const char *const atoms[] = { "a", "x", ".", "\\d", "[ax]" };
+    static const char *const quantifiers[] = { "", "", "?", "*", "+", "{1,2}" };
+
+    // `?` prefers to consume on every engine
+    static const char *const cases[][2] = {
+        { "x?", "axax" }, { ".\\d?$", "bx1" }, { "\\d?", "1abc" }, { "a?b", "aab" }, { "a?$", "a" }, { "x?x", "xx" }
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        for (size_t j = 0; j < sizeof(engines) / sizeof(engines[0]); j++)
+            expect(tester, same_span(cases[i][0], engines[j], cases[i][1]));
+    }
+
+    // and so do random patterns on random texts
+    srand(2);
+    for (int trial = 0; trial < 2000; trial++) {
+        char pattern[64] = "", text[9] = "";
+
+        if (rand() % 6 == 0)
+            strcat(pattern, "^");
+        for (int i = rand() % 3; i >= 0; i--) {
+            strcat(pattern, atoms[rand() % 5]);
+            strcat(pattern, quantifiers[rand() % 6]);
+        }
+        if (rand() % 5 == 0)
+            strcat(pattern, "$");
+
+        for (int i = rand() % 8, j = 0; j < i; j++)
+            text[j] = "ax1b"[rand() % 4];
+
+        for (size_t j = 0; j < sizeof(engines) / sizeof(engines[0]); j++)
+            expect(tester, same_span(pattern, engines[j], text));
+    }
+
+    log_tests(tester);
+}
+
+void test_nfa_scratch() {
+    testing_logger_t *tester = create_tester();
+    static const char *const texts[] = { "xabcd", "abcdddd", "", "ab", "zzabczz", "abbcd" };
+    re_t *reg = re_compile("(a|ab)(c|bcd)(d*)");
+    prog_t *prog = nfa_compile(reg, NULL);
+    nfa_scratch_t *scratch = nfa_scratch_new();
+
+    // searches run in the same scratch space (with and without capturing)
+    // find what they do in space of their own
+    for (int round = 0; round < 2; round++) {
+        for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+            const char *text = texts[i], *end = text + strlen(text);
+            const char *start, *fresh_start, *caps[6], *fresh[6];
+
+            const char *match = nfa_search(prog, scratch, text, end, 1, &start);
+            expect(tester, match == nfa_search(prog, NULL, text, end, 1, &fresh_start));
+            expect(tester, !match || start == fresh_start);
+            expect(tester, nfa_is_match(prog, scratch, text, end, 1) == !!match);
+
+            if (round) {
+                expect(tester, nfa_captures(prog, scratch, text, end, 1, &start, caps) == match);
+                expect(tester, nfa_captures(prog, NULL, text, end, 1, &fresh_start, fresh) == match);
+                expect(tester, !match || !memcmp(caps, fresh, sizeof(caps)));
+            }
+        }
+    }
+
+    nfa_scratch_free(scratch);
+    nfa_free(prog);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_nfa_compile();
+    test_nfa_groups();
+    test_nfa_alternation();
+    test_nfa_repeat();
+    test_nfa_suite();
+    test_nfa_find();
+    test_nfa_pathological();
+    test_nfa_engines();
+    test_nfa_scratch();
+
+    return 0;
+}
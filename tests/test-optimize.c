@@ -0,0 +1,162 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "optimize.h"
+
+#include "testing-logger.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* compiles and optimizes `regexp` */
+static re_t *optimize(const char *regexp) {
+    re_t *reg = re_compile(regexp);
+    re_optimize(reg);
+    return reg;
+}
+
+/* returns the number of `re_t`s before the terminator */
+static size_t length(const re_t *reg) {
+    size_t len = 0;
+    while (reg[len].type != TERMINAL)
+        len++;
+    return len;
+}
+
+void test_optimize_classes() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+
+    // a class of one character is that character
+    reg = optimize("a[x]b");
+    expect(tester, reg[1].type == CHAR && reg[1].class.c == 'x');
+    re_free(reg);
+
+    reg = optimize("[.]");
+    expect(tester, reg[0].type == CHAR && reg[0].class.c == '.');
+    re_free(reg);
+
+    // ...however it is repeated
+    reg = optimize("[x]*[x]?");
+    expect(tester, reg[0].type == CHAR && reg[1].type == STAR);
+    expect(tester, reg[2].type == CHAR && reg[2].class.c == 'x' && reg[3].type == OPTIONAL);
+    re_free(reg);
+
+    re_pattern_t *pattern = re_pattern_compile("a[x]?b");
+    expect(tester, re_pattern_match(pattern, "ab") && re_pattern_match(pattern, "axb"));
+    expect(tester, !re_pattern_match(pattern, "ayb") && !re_pattern_match(pattern, "axxb"));
+    re_pattern_free(pattern);
+
+    // ...but a class of more is not
+    reg = optimize("[xy][^x]");
+    expect(tester, reg[0].type == CHAR_CLASS && reg[1].type == CHAR_CLASS);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_optimize_kleene() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+
+    reg = optimize("a*a*b");
+    expect(tester, length(reg) == 3 && reg[1].type == STAR && reg[2].type == CHAR);
+    re_free(reg);
+
+    reg = optimize(".*.*.*");
+    expect(tester, length(reg) == 2 && reg[0].type == DOT && reg[1].type == STAR);
+    re_free(reg);
+
+    // either `+` needs at least one
+    reg = optimize("a+a*");
+    expect(tester, length(reg) == 2 && reg[1].type == PLUS);
+    re_free(reg);
+
+    reg = optimize("x[ab]*[ba]+");
+    expect(tester, length(reg) == 3 && reg[2].type == PLUS);
+    re_free(reg);
+
+    // different atoms, and `a+a+` (two or more), are left alone
+    reg = optimize("a*b*");
+    expect(tester, length(reg) == 4);
+    re_free(reg);
+
+    reg = optimize("a+a+");
+    expect(tester, length(reg) == 4);
+    re_free(reg);
+
+    reg = optimize("a*a{2}");
+    expect(tester, length(reg) == 4);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_optimize_literal() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg;
+
+    reg = optimize("hello\\.");
+    expect(tester, re_literal_len(reg) == 6);
+    re_free(reg);
+
+    static const char *const not_literals[] = { "", "^abc", "abc$", "ab*", "a.c", "a[bc]", "(abc)", "a|b", "ab{2}" };
+    for (size_t i = 0; i < sizeof(not_literals) / sizeof(not_literals[0]); i++) {
+        reg = optimize(not_literals[i]);
+        expect(tester, re_literal_len(reg) == 0);
+        re_free(reg);
+    }
+
+    // a literal pattern is still matched by every engine, with or without the prefilter
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA, RE_JIT, RE_NO_PREFILTER };
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        re_pattern_t *pattern = re_pattern_compile_flags("needle", engines[i]);
+        re_span_t span;
+
+        expect(tester, pattern->literal == (engines[i] == RE_NO_PREFILTER ? 0 : 6));
+        expect(tester, re_pattern_span(pattern, "haystack with a needle in it", &span));
+        expect(tester, span.start == 16 && span.len == 6);
+        expect(tester, !re_pattern_match(pattern, "needl"));
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_optimize_strings() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+    const re_inst_t *inst;
+
+    // the characters between quantifiers are compared as one string
+    pattern = re_pattern_compile("\\d+ms took x?yz");
+    inst = pattern->code->inst;
+    expect(tester, inst[0].type == CHAR_CLASS && inst[1].type == PLUS);
+    expect(tester, inst[2].type == STRING && inst[2].run == 8);
+    expect(tester, !memcmp(pattern->code->lits + inst[2].cl, "ms took ", 8));
+    expect(tester, inst[3].type == CHAR && inst[4].type == OPTIONAL);
+    expect(tester, inst[5].type == STRING && inst[5].run == 2);
+    expect(tester, inst[6].type == TERMINAL);
+
+    expect(tester, re_pattern_match(pattern, "it 12ms took yz"));
+    expect(tester, re_pattern_match(pattern, "it 12ms took xyz"));
+    expect(tester, !re_pattern_match(pattern, "it 12ms took y"));
+    expect(tester, !re_pattern_match(pattern, "it 12ms tool yz"));
+    re_pattern_free(pattern);
+
+    // a string right at the end of the text
+    pattern = re_pattern_compile("a*bcd$");
+    expect(tester, pattern->code->inst[2].type == STRING);
+    expect(tester, re_pattern_match(pattern, "aabcd"));
+    expect(tester, !re_pattern_match(pattern, "aabc"));
+    re_pattern_free(pattern);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_optimize_classes();
+    test_optimize_kleene();
+    test_optimize_literal();
+    test_optimize_strings();
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "prefilter.h"
+#include "regex-cases.h"
+
+#include "testing-logger.h"
+#include <string.h>
+
+/* compiles `regexp` and extracts its prefilter */
+static prefilter_t *compile(const char *regexp) {
+    re_t *reg = re_compile(regexp);
+    prefilter_t *pf = prefilter_compile(reg, NULL);
+    re_free(reg);
+    return pf;
+}
+
+void test_prefilter_compile() {
+    testing_logger_t *tester = create_tester();
+    prefilter_t *pf;
+
+    pf = compile("hello");
+    expect(tester, !strcmp(pf->lit, "hello"));
+    expect(tester, pf->offset == 0);
+    expect(tester, pf->skip != NULL);
+    prefilter_free(pf);
+
+    // the literal after a fixed-width prefix has a fixed offset
+    pf = compile("^.\\.com");
+    expect(tester, !strcmp(pf->lit, ".com"));
+    expect(tester, pf->offset == 1);
+    prefilter_free(pf);
+
+    // the longest run is chosen, even after a quantifier
+    pf = compile("a.b*cde");
+    expect(tester, !strcmp(pf->lit, "cde"));
+    expect(tester, pf->offset == -1);
+    expect(tester, pf->skip == NULL);
+    prefilter_free(pf);
+
+    // quantified characters are not required, and ties go to the earliest run
+    pf = compile("ab?c");
+    expect(tester, !strcmp(pf->lit, "a"));
+    expect(tester, pf->offset == 0);
+    prefilter_free(pf);
+
+    // a group takes no room, but a quantified one is not required
+    pf = compile("x(yz)w");
+    expect(tester, !strcmp(pf->lit, "yz"));
+    expect(tester, pf->offset == 1);
+    prefilter_free(pf);
+
+    pf = compile("a(bcd)*ef");
+    expect(tester, !strcmp(pf->lit, "ef"));
+    expect(tester, pf->offset == -1);
+    prefilter_free(pf);
+
+    // a counted character may be repeated or skipped
+    pf = compile("ab{2}cd");
+    expect(tester, !strcmp(pf->lit, "cd"));
+    expect(tester, pf->offset == -1);
+    prefilter_free(pf);
+
+    // no literal is required by every alternative, but one after them is
+    expect(tester, compile("foo|bar") == NULL);
+    pf = compile("x(ab|cd)yz");
+    expect(tester, !strcmp(pf->lit, "yz"));
+    expect(tester, pf->offset == -1);
+    prefilter_free(pf);
+
+    // no literals means no prefilter
+    expect(tester, compile("a*") == NULL);
+    expect(tester, compile("(ab)?") == NULL);
+    expect(tester, compile("[abc].+") == NULL);
+    expect(tester, compile("") == NULL);
+
+    log_tests(tester);
+}
+
+void test_prefilter_find() {
+    testing_logger_t *tester = create_tester();
+    prefilter_t *pf;
+    char *text;
+
+    // memchr for short literals
+    pf = compile("ab");
+    text = "aaaaab";
+    expect(tester, prefilter_find(pf, text, text + 6) == text + 4);
+    expect(tester, prefilter_find(pf, text, text + 5) == NULL);
+    expect(tester, prefilter_find(pf, text + 5, text + 6) == NULL);
+    prefilter_free(pf);
+
+    // Boyer-Moore-Horspool for long literals
+    pf = compile("export ");
+    text = "exporter exports export PATH";
+    expect(tester, prefilter_find(pf, text, text + strlen(text)) == text + 17);
+    expect(tester, prefilter_find(pf, text, text + 23) == NULL);
+    expect(tester, prefilter_find(pf, text, text + 24) == text + 17);
+    expect(tester, prefilter_find(pf, text + 18, text + strlen(text)) == NULL);
+    prefilter_free(pf);
+
+    log_tests(tester);
+}
+
+void test_prefilter_start() {
+    testing_logger_t *tester = create_tester();
+    prefilter_t *pf;
+    char *text;
+
+    // a fixed offset gives the exact candidate
+    pf = compile("..@");
+    text = "abc@de@";
+    expect(tester, prefilter_start(pf, text, text + 7, 0) == text + 1);
+    expect(tester, prefilter_start(pf, text + 2, text + 7, 0) == text + 4);
+    expect(tester, prefilter_start(pf, text, text + 7, 1) == NULL);
+    expect(tester, prefilter_start(pf, text + 1, text + 7, 1) == text + 1);
+    expect(tester, prefilter_start(pf, text, text + 2, 0) == NULL);
+    prefilter_free(pf);
+
+    // a varying offset can only rule out the text
+    pf = compile("a*bc");
+    text = "aaabc";
+    expect(tester, prefilter_start(pf, text, text + 5, 0) == text);
+    expect(tester, prefilter_start(pf, text, text + 4, 0) == NULL);
+    prefilter_free(pf);
+
+    log_tests(tester);
+}
+
+void test_prefilter_suite() {
+    testing_logger_t *tester = create_tester();
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA };
+
+    // skipping ahead never changes the result of any engine
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+        for (size_t i = 0; i < NUM_REGEX_CASES; i++) {
+            const regex_case_t *test = &REGEX_CASES[i];
+            re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, engines[e]);
+
+            expect(tester, re_pattern_match(pattern, test->text) == test->match);
+            re_pattern_free(pattern);
+        }
+
+        for (size_t i = 0; i < NUM_REGEX_FIND_CASES; i++) {
+            const regex_find_case_t *test = &REGEX_FIND_CASES[i];
+            re_pattern_t *pattern = re_pattern_compile_flags(test->pattern, engines[e]);
+            char *res = re_pattern_find(pattern, test->text);
+
+            if (test->found)
+                expect(tester, res && !strcmp(res, test->found));
+            else
+                expect(tester, res == NULL);
+
+            free(res);
+            re_pattern_free(pattern);
+        }
+    }
+
+    log_tests(tester);
+}
+
+int main() {
+    test_prefilter_compile();
+    test_prefilter_find();
+    test_prefilter_start();
+    test_prefilter_suite();
+
+    return 0;
+}
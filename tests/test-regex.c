@@ -1,7 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "regex.h"
 #include "regex-private.h"
+#include "regex-cases.h"
 
 #include "testing-logger.h"
+#include <stdlib.h>
 #include <string.h>
 
 void test_regex_compile_naive() {
@@ -143,6 +147,10 @@ void test_regex_some_many() {
     expect(tester, !re_is_match("a+bc", "a"));
     expect(tester, !re_is_match("a+bc", "ab"));
 
+    // `+` consumes its first occurrence before the rest of the pattern
+    expect(tester, !re_is_match("^a+a$", "a"));
+    expect(tester, re_is_match("^a+a$", "aa"));
+
     log_tests(tester);
 }
 
@@ -301,6 +309,782 @@ void test_regex_return() {
     expect(tester, res == NULL);
     free(res);
 
+    res = re_get_match("[a-z]+", "ABC def");
+    expect(tester, !strcmp(res, "d"));
+    free(res);
+
+    log_tests(tester);
+}
+
+void test_regex_pattern() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+    char *res;
+
+    // a compiled pattern can be reused across many strings
+    pattern = re_pattern_compile("^Hello .orld*!");
+    expect(tester, pattern != NULL);
+    expect(tester, re_pattern_match(pattern, "Hello worlddddddddd!"));
+    expect(tester, re_pattern_match(pattern, "Hello worl!"));
+    expect(tester, !re_pattern_match(pattern, "world."));
+    expect(tester, !re_pattern_match(pattern, ""));
+    re_pattern_free(pattern);
+
+    pattern = re_pattern_compile("\\w+@\\w+\\.com");
+    res = re_pattern_find(pattern, "this is a test: testemail@gmail.com");
+    expect(tester, res && !strcmp(res, "testemail@gmail.com"));
+    free(res);
+
+    res = re_pattern_find(pattern, "this is a test");
+    expect(tester, res == NULL);
+    free(res);
+    re_pattern_free(pattern);
+
+    // malformed patterns fail to compile
+    expect(tester, re_pattern_compile("[abc") == NULL);
+
+    // freeing NULL is a no-op
+    re_pattern_free(NULL);
+
+    log_tests(tester);
+}
+
+void test_regex_span() {
+    testing_logger_t *tester = create_tester();
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA };
+    re_pattern_t *pattern;
+    re_span_t span;
+    char *res;
+
+    // the span points into the searched string, with nothing allocated
+    const char *text = "mail testemail@gmail.com now";
+    pattern = re_pattern_compile("\\w+@\\w+\\.com");
+    expect(tester, re_pattern_span(pattern, text, &span));
+    expect(tester, span.start == 5);
+    expect(tester, span.len == 19);
+
+    res = re_span_dup(text, span);
+    expect(tester, !strcmp(res, "testemail@gmail.com"));
+    free(res);
+
+    span.start = span.len = 42;
+    expect(tester, !re_pattern_span(pattern, "no mail", &span));
+    expect(tester, span.start == 42 && span.len == 42);
+    re_pattern_free(pattern);
+
+    // an empty match has a span too
+    pattern = re_pattern_compile("x*");
+    expect(tester, re_pattern_span(pattern, "abc", &span));
+    expect(tester, span.start == 0 && span.len == 0);
+    res = re_span_dup("abc", span);
+    expect(tester, !strcmp(res, ""));
+    free(res);
+    re_pattern_free(pattern);
+
+    // every engine finds the same span as `re_pattern_find`
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        for (size_t j = 0; j < NUM_REGEX_FIND_CASES; j++) {
+            const regex_find_case_t *test = &REGEX_FIND_CASES[j];
+            pattern = re_pattern_compile_flags(test->pattern, engines[i]);
+
+            if (test->found) {
+                expect(tester, re_pattern_span(pattern, test->text, &span));
+                expect(tester, span.len == strlen(test->found));
+                expect(tester, !strncmp(test->text + span.start, test->found, span.len));
+            } else {
+                expect(tester, !re_pattern_span(pattern, test->text, &span));
+            }
+
+            re_pattern_free(pattern);
+        }
+    }
+
+    log_tests(tester);
+}
+
+/* returns the number of matches of `regexp` in `text`, storing each in `spans` */
+static size_t find_all(const char *regexp, int flags, const char *text, re_span_t *spans, size_t max) {
+    re_pattern_t *pattern = re_pattern_compile_flags(regexp, flags);
+    re_iter_t iter;
+    re_span_t span;
+    size_t n = 0;
+
+    re_iter_init(&iter, pattern, text);
+    while (re_iter_next(&iter, &span)) {
+        if (n < max)
+            spans[n] = span;
+        n++;
+    }
+
+    // an exhausted iterator stays exhausted
+    if (re_iter_next(&iter, &span))
+        n = (size_t) -1;
+
+    re_pattern_free(pattern);
+    return n;
+}
+
+void test_regex_iter() {
+    testing_logger_t *tester = create_tester();
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA };
+    re_span_t spans[8];
+
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        const int flags = engines[i];
+
+        // matches are returned left to right without overlapping
+        expect(tester, find_all("[a-z][0-9]+ ", flags, "a1 b22 c333 ", spans, 8) == 3);
+        expect(tester, spans[0].start == 0 && spans[0].len == 3);
+        expect(tester, spans[1].start == 3 && spans[1].len == 4);
+        expect(tester, spans[2].start == 7 && spans[2].len == 5);
+
+        // `+` stops at the shortest repetition, so each digit is a match
+        expect(tester, find_all("[0-9]+", flags, "a1 b22", spans, 8) == 3);
+        expect(tester, spans[2].start == 5 && spans[2].len == 1);
+
+        expect(tester, find_all("a.a", flags, "aaaaaaa", spans, 8) == 2);
+        expect(tester, spans[0].start == 0 && spans[1].start == 3);
+
+        expect(tester, find_all("\\w+@\\w+\\.com", flags, "a@b.com, c@d.com", spans, 8) == 2);
+        expect(tester, spans[1].start == 9 && spans[1].len == 7);
+
+        expect(tester, find_all("z", flags, "abc", spans, 8) == 0);
+        expect(tester, find_all("z", flags, "", spans, 8) == 0);
+
+        // an empty match at every position, including the end
+        expect(tester, find_all("x*", flags, "abc", spans, 8) == 4);
+        expect(tester, spans[3].start == 3 && spans[3].len == 0);
+        expect(tester, find_all("x*", flags, "", spans, 8) == 1);
+
+        // `^` only matches at the start, `$` only at the end
+        expect(tester, find_all("^a", flags, "aaa", spans, 8) == 1);
+        expect(tester, find_all("^b", flags, "ab", spans, 8) == 0);
+        expect(tester, find_all("a$", flags, "aaa", spans, 8) == 1);
+        expect(tester, spans[0].start == 2);
+    }
+
+    log_tests(tester);
+}
+
+void test_regex_slice() {
+    testing_logger_t *tester = create_tester();
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA, RE_NO_PREFILTER };
+    const char data[] = "key=\0\0val\0ue;\xff\0end";
+    const size_t len = sizeof(data) - 1;
+    re_pattern_t *pattern;
+    re_span_t span;
+
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        const int flags = engines[i];
+
+        // '\0' is an ordinary character of the text
+        pattern = re_pattern_compile_n("v.l.u", 5, flags);
+        expect(tester, re_pattern_match_n(pattern, data, len));
+        expect(tester, !re_pattern_match(pattern, data));
+        re_pattern_free(pattern);
+
+        pattern = re_pattern_compile_n("=[^;]*;", 7, flags);
+        expect(tester, re_pattern_span_n(pattern, data, len, &span));
+        expect(tester, span.start == 3 && span.len == 10);
+        re_pattern_free(pattern);
+
+        // and of the pattern
+        pattern = re_pattern_compile_n("\0\0val", 5, flags);
+        expect(tester, re_pattern_span_n(pattern, data, len, &span));
+        expect(tester, span.start == 4 && span.len == 5);
+        re_pattern_free(pattern);
+
+        pattern = re_pattern_compile_n("[\0]e", 4, flags);
+        expect(tester, re_pattern_span_n(pattern, data, len, &span));
+        expect(tester, span.start == 14 && span.len == 2);
+        re_pattern_free(pattern);
+
+        // `$` matches at the end of the slice, and nothing past it is read
+        pattern = re_pattern_compile_n("val$", 4, flags);
+        expect(tester, re_pattern_match_n(pattern, data, 9));
+        expect(tester, !re_pattern_match_n(pattern, data, 10));
+        re_pattern_free(pattern);
+
+        pattern = re_pattern_compile_n("^key=x*$", 8, flags);
+        expect(tester, re_pattern_match_n(pattern, data, 4));
+        expect(tester, !re_pattern_match_n(pattern, data, 3));
+        re_pattern_free(pattern);
+
+        pattern = re_pattern_compile_n("e.*d", 4, flags);
+        expect(tester, re_pattern_match_n(pattern, data, len));
+        expect(tester, !re_pattern_match_n(pattern, data, len - 1));
+        re_pattern_free(pattern);
+
+        // the iterator walks the slice, zeros and all
+        re_iter_t iter;
+        size_t n = 0;
+        pattern = re_pattern_compile_n("\0", 1, flags);
+        re_iter_init_n(&iter, pattern, data, len);
+        while (re_iter_next(&iter, &span))
+            n++;
+        expect(tester, n == 4);
+        re_pattern_free(pattern);
+    }
+
+    // the pattern's length is respected too
+    pattern = re_pattern_compile_n("abc[", 3, RE_BACKTRACK);
+    expect(tester, pattern && re_pattern_match_n(pattern, "xabcx", 5));
+    re_pattern_free(pattern);
+
+    expect(tester, re_pattern_compile_n("[abc]", 4, RE_BACKTRACK) == NULL);
+    expect(tester, re_pattern_compile_n("[a-c]", 3, RE_BACKTRACK) == NULL);
+
+    log_tests(tester);
+}
+
+/* returns true if the two compiled regexps are the same */
+static int same_reg(const re_t *a, const re_t *b) {
+    for (; a->type == b->type; a++, b++) {
+        if (a->type == TERMINAL)
+            return 1;
+        if (a->nccl != b->nccl || memcmp(&a->class, &b->class, sizeof(a->class)))
+            return 0;
+    }
+
+    return 0;
+}
+
+void test_regex_abbr_compile() {
+    testing_logger_t *tester = create_tester();
+    const char *patterns[] = { "^\\a+", "\\d*x", "^[a-z]\\D*", "\\s\\S?\\w\\W" };
+    re_t *fused, *expanded;
+    char *exp_pattern;
+
+    // compiling a shortcut is the same as compiling the class it stands for
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        exp_pattern = re_precompile(patterns[i]);
+        fused = re_compile(patterns[i]);
+        expanded = re_compile(exp_pattern);
+        expect(tester, same_reg(fused, expanded));
+        re_free(fused);
+        re_free(expanded);
+        free(exp_pattern);
+    }
+
+    // inside a class, a shortcut adds its class (or its complement)
+    expect(tester, re_is_match("^[\\d_]+$", "0_9"));
+    expect(tester, !re_is_match("[\\d_]", "abc"));
+    expect(tester, re_is_match("^[^\\s]+$", "a-b"));
+    expect(tester, !re_is_match("[^\\s]", " \t\n"));
+    expect(tester, re_is_match("^[\\D]+$", "ab-"));
+    expect(tester, !re_is_match("[\\D]", "123"));
+
+    // and cannot begin a range
+    expect(tester, re_is_match("^[\\d-x]+$", "1-x"));
+    expect(tester, !re_is_match("[\\d-x]", "e"));
+
+    log_tests(tester);
+}
+
+void test_regex_code() {
+    testing_logger_t *tester = create_tester();
+    re_t *reg = re_compile("a[bc]a.[cb]*x?\\s");
+    re_code_t *code = re_code_compile(reg, NULL, NULL);
+    const re_inst_t *inst = code->inst;
+
+    // the empty class, then a, [bc], ., x and \s, each stored once
+    expect(tester, code->nclasses == 6);
+    expect(tester, inst[0].cl == inst[2].cl);
+    expect(tester, inst[1].cl == inst[4].cl);
+    expect(tester, inst[0].cl != inst[1].cl && inst[3].cl != inst[1].cl);
+
+    // quantifiers and the end of the program consume nothing
+    expect(tester, inst[5].type == STAR && inst[5].cl == 0);
+    expect(tester, inst[9].type == TERMINAL && inst[9].cl == 0);
+
+    // each class holds exactly the bytes its instruction consumes
+    const unsigned char *bc = code->classes[inst[1].cl];
+    expect(tester, bc['b' >> 3] == (1 << ('b' & 7) | 1 << ('c' & 7)));
+    expect(tester, code->classes[inst[3].cl][0] == 0xff && code->classes[inst[3].cl][31] == 0xff);
+
+    // every instruction is a fraction of the size of a `re_t`
+    expect(tester, sizeof(re_inst_t) <= 8);
+
+    re_code_free(code);
+    re_free(reg);
+
+    log_tests(tester);
+}
+
+void test_regex_arena() {
+    testing_logger_t *tester = create_tester();
+    const char *patterns[] = { "\\w+@\\w+\\.com", "^[0-9]+$", "a.*b", "[bc" };
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA };
+    re_arena_t *arena = re_arena_new(128);
+    re_pattern_t *compiled[3][3];
+
+    // many patterns share one arena, small as its blocks are
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            compiled[i][j] = re_pattern_compile_arena(patterns[j], strlen(patterns[j]), engines[i], arena);
+            expect(tester, compiled[i][j] != NULL);
+        }
+
+        expect(tester, re_pattern_compile_arena(patterns[3], strlen(patterns[3]), engines[i], arena) == NULL);
+    }
+
+    for (size_t i = 0; i < 3; i++) {
+        expect(tester, re_pattern_match(compiled[i][0], "mail bob@example.com"));
+        expect(tester, !re_pattern_match(compiled[i][0], "bob@example.org"));
+        expect(tester, re_pattern_match(compiled[i][1], "2022"));
+        expect(tester, !re_pattern_match(compiled[i][1], "20x22"));
+        expect(tester, re_pattern_match(compiled[i][2], "xaxxbx"));
+        expect(tester, !re_pattern_match(compiled[i][2], "bxa"));
+    }
+
+    // freeing a pattern only releases its DFA's cache, and the arena the rest
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++)
+            re_pattern_free(compiled[i][j]);
+    }
+    re_arena_free(arena);
+
+    log_tests(tester);
+}
+
+/* returns true if the span is at `start` and `len` long */
+static int span_is(re_span_t span, size_t start, size_t len) {
+    return span.start == start && span.len == len;
+}
+
+void test_regex_groups() {
+    testing_logger_t *tester = create_tester();
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA, RE_NO_PREFILTER };
+    const char *text = "export NAME=value >> out.txt";
+    re_span_t spans[4];
+    re_pattern_t *pattern;
+
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        const int flags = engines[i];
+
+        // the name and value of an assignment, in one pass
+        pattern = re_pattern_compile_flags("([A-Z_]+)=([^ ]*) ", flags);
+        expect(tester, re_pattern_groups(pattern) == 2);
+        expect(tester, re_pattern_captures(pattern, text, strlen(text), spans, 3));
+        expect(tester, span_is(spans[0], 7, 11));
+        expect(tester, span_is(spans[1], 7, 4));
+        expect(tester, span_is(spans[2], 12, 5));
+        re_pattern_free(pattern);
+
+        // a redirection, whose groups nest
+        pattern = re_pattern_compile_flags("(>(>)?) *([a-z.]+)$", flags);
+        expect(tester, re_pattern_captures(pattern, text, strlen(text), spans, 4));
+        expect(tester, span_is(spans[0], 18, 10));
+        expect(tester, span_is(spans[1], 18, 2));
+        expect(tester, span_is(spans[2], 19, 1));
+        expect(tester, span_is(spans[3], 21, 7));
+        expect(tester, re_pattern_captures(pattern, "> a", 3, spans, 4));
+        expect(tester, span_is(spans[1], 0, 1));
+        expect(tester, spans[2].start == RE_NO_GROUP);
+        re_pattern_free(pattern);
+
+        // quantified groups match as a whole
+        pattern = re_pattern_compile_flags("^(ab)+c(de)*$", flags);
+        expect(tester, re_pattern_match(pattern, "ababc"));
+        expect(tester, re_pattern_match(pattern, "abcdede"));
+        expect(tester, !re_pattern_match(pattern, "abac"));
+        expect(tester, !re_pattern_match(pattern, "c"));
+        expect(tester, !re_pattern_match(pattern, "abcd"));
+        expect(tester, re_pattern_captures(pattern, "ababcde", 7, spans, 3));
+        expect(tester, span_is(spans[1], 2, 2) && span_is(spans[2], 5, 2));
+        re_pattern_free(pattern);
+
+        // missing groups are not set, and neither is anything without a match
+        pattern = re_pattern_compile_flags("a(b)?", flags);
+        expect(tester, re_pattern_captures(pattern, "xa", 2, spans, 4));
+        expect(tester, span_is(spans[0], 1, 1));
+        expect(tester, spans[1].start == RE_NO_GROUP && spans[3].start == RE_NO_GROUP);
+        spans[0].start = 42;
+        expect(tester, !re_pattern_captures(pattern, "xyz", 3, spans, 2));
+        expect(tester, spans[0].start == 42);
+        re_pattern_free(pattern);
+    }
+
+    // a pattern without groups still has the span of its match
+    pattern = re_pattern_compile("b+");
+    expect(tester, re_pattern_groups(pattern) == 0);
+    expect(tester, re_pattern_captures(pattern, "abbc", 4, spans, 2));
+    expect(tester, span_is(spans[0], 1, 1) && spans[1].start == RE_NO_GROUP);
+    re_pattern_free(pattern);
+
+    // a group moves the pattern onto the Pike VM, which finds the same
+    // match as the backtracking matcher did without it
+    static const char *const wrapped[][3] = {
+        { ".\\d?$", "(.\\d?$)", "bx1" }, { "x?", "(x?)", "axax" }, { "a*b?c", "(a*)(b?)c", "aabbc" },
+        { "[ax]?1+", "([ax]?1+)", "a1x" }, { "x.*y?", "x(.*y?)", "zxyy" }, { "a{1,2}b", "(a{1,2})b", "aaab" },
+        { "^a+", "(^a+)", "aab" }, { "b$", "(b$)", "abab" }
+    };
+    for (size_t i = 0; i < sizeof(wrapped) / sizeof(wrapped[0]); i++) {
+        re_pattern_t *bare = re_pattern_compile(wrapped[i][0]);
+        re_span_t a, b;
+
+        pattern = re_pattern_compile(wrapped[i][1]);
+        expect(tester, pattern->prog != NULL && bare->prog == NULL);
+        expect(tester, re_pattern_span(bare, wrapped[i][2], &a) && re_pattern_span(pattern, wrapped[i][2], &b));
+        expect(tester, a.start == b.start && a.len == b.len);
+        re_pattern_free(pattern);
+        re_pattern_free(bare);
+    }
+
+    // escaped brackets are literal, and unbalanced ones are rejected
+    expect(tester, re_is_match("^\\(a\\)$", "(a)"));
+    expect(tester, re_pattern_compile("(ab") == NULL);
+    expect(tester, re_pattern_compile("ab)") == NULL);
+    expect(tester, re_pattern_compile("(a))(") == NULL);
+
+    log_tests(tester);
+}
+
+void test_regex_alternation() {
+    testing_logger_t *tester = create_tester();
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA, RE_NO_PREFILTER };
+    re_span_t spans[3];
+    re_pattern_t *pattern;
+
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        const int flags = engines[i];
+
+        // every keyword is found in a single scan
+        pattern = re_pattern_compile_flags("if|then|else|fi", flags);
+        expect(tester, re_pattern_span(pattern, "x = 1; then", &spans[0]));
+        expect(tester, span_is(spans[0], 7, 4));
+        expect(tester, re_pattern_span(pattern, "elsewhere", &spans[0]));
+        expect(tester, span_is(spans[0], 0, 4));
+        expect(tester, !re_pattern_match(pattern, "while"));
+        re_pattern_free(pattern);
+
+        // the left alternative wins where both match
+        pattern = re_pattern_compile_flags("(a|ab)(c|bcd)", flags);
+        expect(tester, re_pattern_captures(pattern, "xabcd", 5, spans, 3));
+        expect(tester, span_is(spans[0], 1, 4));
+        expect(tester, span_is(spans[1], 1, 1) && span_is(spans[2], 2, 3));
+        re_pattern_free(pattern);
+
+        // `^` anchors every alternative it begins
+        pattern = re_pattern_compile_flags("^GET|^HEAD", flags);
+        expect(tester, re_pattern_match(pattern, "HEAD /"));
+        expect(tester, !re_pattern_match(pattern, "A GET"));
+        re_pattern_free(pattern);
+
+        // and only its own alternative (or group) anywhere else
+        static const char *const anchors[] = { "^a|b", "b|^a", "(^a|b)", "x*(^a)" };
+        for (size_t j = 0; j < sizeof(anchors) / sizeof(anchors[0]); j++) {
+            pattern = re_pattern_compile_flags(anchors[j], flags);
+            expect(tester, re_pattern_match(pattern, "a"));
+            expect(tester, !re_pattern_match(pattern, "xa"));
+            expect(tester, re_pattern_span(pattern, "ab", &spans[0]) && span_is(spans[0], 0, 1));
+            re_pattern_free(pattern);
+        }
+
+        // `^` only matches at the beginning of the input, not of each search
+        re_iter_t iter;
+        pattern = re_pattern_compile_flags("^a|b", flags);
+        re_iter_init(&iter, pattern, "aab");
+        expect(tester, re_iter_next(&iter, &spans[0]) && span_is(spans[0], 0, 1));
+        expect(tester, re_iter_next(&iter, &spans[0]) && span_is(spans[0], 2, 1));
+        expect(tester, !re_iter_next(&iter, &spans[0]));
+        re_pattern_free(pattern);
+    }
+
+    // an iterator finds every alternative
+    re_iter_t iter;
+    size_t n = 0;
+    pattern = re_pattern_compile("cat|dog");
+    re_iter_init(&iter, pattern, "dog cat catdog");
+    while (re_iter_next(&iter, &spans[0]))
+        n++;
+    expect(tester, n == 4);
+    re_pattern_free(pattern);
+
+    // empty alternatives match nothing, and `\|` is literal
+    expect(tester, re_is_match("^(|x)$", ""));
+    expect(tester, re_is_match("^a|$", "b"));
+    expect(tester, re_is_match("^a\\|b$", "a|b"));
+    expect(tester, re_pattern_compile("a|(b") == NULL);
+
+    // grep matches a pattern with `^` or `$` anywhere one line at a time
+    static const struct { const char *pattern; int anchor; } anchors[] = {
+        { "^a", 1 }, { "a$|zz", 1 }, { "(a$)", 1 }, { "x|(^a)b", 1 }, { "a\\$", 0 }, { "[$^]|b", 0 }, { "(a)|b", 0 }
+    };
+    for (size_t i = 0; i < sizeof(anchors) / sizeof(anchors[0]); i++) {
+        pattern = re_pattern_compile(anchors[i].pattern);
+        expect(tester, re_pattern_has_anchor(pattern) == anchors[i].anchor);
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_regex_repeat() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+    re_span_t span;
+    re_t *reg;
+
+    // the bounds are kept in a single `re_t`
+    reg = re_compile("[0-9]{1,5}.{2}x{3,}");
+    expect(tester, reg[1].type == REPEAT);
+    expect(tester, reg[1].class.rep.min == 1 && reg[1].class.rep.max == 5);
+    expect(tester, reg[3].class.rep.min == 2 && reg[3].class.rep.max == 2);
+    expect(tester, reg[5].class.rep.min == 3 && reg[5].class.rep.max == REPEAT_INF);
+    expect(tester, reg[6].type == TERMINAL);
+    re_free(reg);
+
+    // a brace without bounds is literal, while bad bounds are rejected
+    reg = re_compile("a{x}{2");
+    expect(tester, reg[1].type == CHAR && reg[1].class.c == '{');
+    expect(tester, reg[4].type == CHAR && reg[4].class.c == '{');
+    re_free(reg);
+    expect(tester, re_compile("a{3,2}") == NULL);
+    expect(tester, re_compile("a{1001}") == NULL);
+    expect(tester, re_compile("a{0,99999999999}") == NULL);
+
+    // the backtracking matcher counts, so its program is the size of the pattern
+    pattern = re_pattern_compile(".{0,1000}x{1000}$");
+    expect(tester, pattern->code->inst[1].c == 0 && pattern->code->inst[1].run == 1000);
+    expect(tester, pattern->code->inst[4].type == END);
+    expect(tester, !re_pattern_match(pattern, "xxxx"));
+    re_pattern_free(pattern);
+
+    // a pattern too large for the NFA falls back to counting...
+    const char *large = "^a{1000}b{1000}c{1000}d{1000}e{1000}f{1000}g{1000}h{1000}i{1000}j{1000}$";
+    pattern = re_pattern_compile_flags(large, RE_DFA);
+    expect(tester, pattern && !pattern->prog && !pattern->dfa);
+    expect(tester, !re_pattern_match(pattern, "abcdefghij"));
+    re_pattern_free(pattern);
+
+    // ...unless it has to run on the NFA
+    expect(tester, re_pattern_compile("(a{100}){101}") == NULL);
+
+    // each engine prefers fewer repetitions
+    const int engines[] = { RE_BACKTRACK, RE_NFA, RE_DFA };
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        pattern = re_pattern_compile_flags("[0-9]{2,4}", engines[i]);
+        expect(tester, re_pattern_span(pattern, "x12345", &span));
+        expect(tester, span.start == 1 && span.len == 2);
+        re_pattern_free(pattern);
+
+        pattern = re_pattern_compile_flags("\\d{4}-\\d{2}-\\d{2}$", engines[i]);
+        expect(tester, re_pattern_span(pattern, "on 2024-01-31", &span));
+        expect(tester, span.start == 3 && span.len == 10);
+        expect(tester, !re_pattern_match(pattern, "on 24-01-31"));
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_regex_memo() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+    re_span_t span;
+
+    // only repetitions that backtrack into each other are memoized
+    pattern = re_pattern_compile("a.*b.*c");
+    expect(tester, pattern->memo == 8);
+    re_pattern_free(pattern);
+
+    pattern = re_pattern_compile("\\d+x.*y");
+    expect(tester, pattern->memo == 0);
+    re_pattern_free(pattern);
+
+    pattern = re_pattern_compile_flags("a.*b", RE_MEMO | RE_JIT);
+    expect(tester, pattern->memo == 5 && pattern->jit == NULL);
+    re_pattern_free(pattern);
+
+    // every case from the suite gives the same result
+    for (size_t i = 0; i < NUM_REGEX_CASES; i++) {
+        pattern = re_pattern_compile_flags(REGEX_CASES[i].pattern, RE_MEMO);
+        expect(tester, re_pattern_match(pattern, REGEX_CASES[i].text) == REGEX_CASES[i].match);
+        re_pattern_free(pattern);
+    }
+
+    // the leftmost match is found where it was before, with as few
+    // repetitions as the rest allows
+    pattern = re_pattern_compile_flags("x*a.*b.*c", RE_MEMO);
+    expect(tester, re_pattern_span(pattern, "zxxab_b_cc", &span));
+    expect(tester, span.start == 1 && span.len == 8);
+    re_pattern_free(pattern);
+
+    // without the memo this takes time to the power of the number of `.*`s
+    char *text = malloc(1001);
+    memset(text, 'a', 1000);
+    text[1000] = '\0';
+
+    pattern = re_pattern_compile_flags(".*a.*a.*a.*a.*c", RE_NO_PREFILTER);
+    expect(tester, pattern->memo > 0);
+    expect(tester, !re_pattern_match(pattern, text));
+    text[999] = 'c';
+    expect(tester, re_pattern_span(pattern, text, &span));
+    expect(tester, span.start == 0 && span.len == 1000);
+    re_pattern_free(pattern);
+
+    // and the JIT, which cannot memoize, leaves such a pattern to the
+    // interpreter, so it takes no longer to fail
+    text[999] = 'a';
+    pattern = re_pattern_compile_flags(".*a.*a.*a.*[bc]", RE_JIT);
+    expect(tester, pattern->memo > 0 && pattern->jit == NULL);
+    expect(tester, !re_pattern_match_n(pattern, text, 1000));
+    re_pattern_free(pattern);
+    free(text);
+
+    // the memo is kept from one search to the next, and only cleared as far
+    // as each reached, so an iterator finds the Pike VM's matches without
+    // clearing the rest of the text every time
+    text = malloc(4000);
+    for (size_t i = 0; i < 4000; i++)
+        text[i] = "xaybzcx_yz"[i % 10];
+
+    re_pattern_t *vm = re_pattern_compile_flags("x.*y.*z", RE_NFA);
+    re_iter_t iter, vm_iter;
+    re_span_t vm_span;
+    size_t n = 0;
+
+    pattern = re_pattern_compile("x.*y.*z");
+    re_iter_init_n(&iter, pattern, text, 4000);
+    re_iter_init_n(&vm_iter, vm, text, 4000);
+    for (; re_iter_next(&iter, &span); n++) {
+        expect(tester, re_iter_next(&vm_iter, &vm_span));
+        expect(tester, span.start == vm_span.start && span.len == vm_span.len);
+    }
+    expect(tester, n == 800 && !re_iter_next(&vm_iter, &vm_span));
+
+    expect(tester, pattern->memo_bits != NULL);
+    for (size_t i = 0; i < pattern->memo_cap; i++)
+        expect(tester, !pattern->memo_bits[i]);
+
+    re_pattern_free(pattern);
+    re_pattern_free(vm);
+    free(text);
+
+    // a text too long to memoize is left to the Pike VM (which a pattern of
+    // many instructions needs well before MEMO_MAX bytes)
+    char regexp[601] = "";
+    for (int i = 0; i < 300; i++)
+        strcat(regexp, "a.");
+
+    const size_t len = 120000;
+    text = malloc(len + 600);
+    memset(text, 'b', len);
+    memset(text + len, 'a', 600);
+
+    pattern = re_pattern_compile_flags(regexp, RE_MEMO | RE_NO_PREFILTER);
+    expect(tester, pattern->memo > 600 && pattern->vm_prog != NULL);
+    expect(tester, re_pattern_span_n(pattern, text, len + 600, &span));
+    expect(tester, span.start == len && span.len == 600);
+    expect(tester, pattern->memo_bits == NULL);
+    re_pattern_free(pattern);
+    free(text);
+
+    log_tests(tester);
+}
+
+void test_regex_stats() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+    re_stats_t stats;
+
+#ifdef RE_STATS
+    // a start is tried at every position, backtracking into `.*` each time
+    re_span_t span;
+    pattern = re_pattern_compile_flags("a.*b.*c", RE_NO_PREFILTER);
+    expect(tester, re_pattern_get_stats(pattern, &stats) && stats.searches == 0);
+    expect(tester, !re_pattern_span(pattern, "xabxb", &span));
+    expect(tester, re_pattern_get_stats(pattern, &stats));
+    expect(tester, stats.searches == 1 && stats.bytes == 5);
+    expect(tester, stats.starts == 6 && stats.skipped == 0);
+    expect(tester, stats.insts > stats.starts && stats.backtracks > 0);
+    expect(tester, stats.memo_hits > 0 && stats.dfa_bytes == 0);
+
+    re_pattern_reset_stats(pattern);
+    expect(tester, re_pattern_get_stats(pattern, &stats) && stats.searches == 0 && stats.insts == 0);
+
+    // ...while whether there is a match is left to the DFA
+    expect(tester, !re_pattern_match(pattern, "xabxb"));
+    expect(tester, re_pattern_get_stats(pattern, &stats));
+    expect(tester, stats.starts == 0 && stats.dfa_bytes == 5);
+    re_pattern_free(pattern);
+
+    // the prefilter rules out every position before the literal
+    pattern = re_pattern_compile("\\d+ms");
+    expect(tester, re_pattern_span(pattern, "took 12ms", &span));
+    expect(tester, re_pattern_get_stats(pattern, &stats));
+    expect(tester, stats.skipped + stats.starts == 6 && stats.skipped >= 5);
+    re_pattern_free(pattern);
+
+    // the DFA steps over each byte once, working out each step once
+    pattern = re_pattern_compile_flags("x[ab]+y", RE_DFA | RE_NO_PREFILTER);
+    expect(tester, !re_pattern_match(pattern, "abababab"));
+    expect(tester, !re_pattern_match(pattern, "abababab"));
+    expect(tester, re_pattern_get_stats(pattern, &stats));
+    expect(tester, stats.dfa_bytes == 16 && stats.dfa_misses == 2 && stats.dfa_hits == 14);
+    re_pattern_free(pattern);
+#else
+    // nothing is counted
+    pattern = re_pattern_compile("a.*b.*c");
+    expect(tester, !re_pattern_match(pattern, "xabxb"));
+    expect(tester, !re_pattern_get_stats(pattern, &stats));
+    expect(tester, stats.searches == 0 && stats.insts == 0);
+    re_pattern_reset_stats(pattern);
+    re_pattern_free(pattern);
+#endif
+
+    log_tests(tester);
+}
+
+void test_regex_budget() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+    re_span_t span = { 0, 0 };
+    re_budget_t budget = { 0 };
+
+    // no limit, or one that is never reached, changes nothing
+    pattern = re_pattern_compile("\\d+ms");
+    expect(tester, re_pattern_match_budget(pattern, "took 12ms", 9, &budget) == 1);
+    budget.steps = 100;
+    expect(tester, re_pattern_match_budget(pattern, "took 12ms", 9, &budget) == 1);
+    expect(tester, re_pattern_match_budget(pattern, "took 12s", 8, &budget) == 0);
+    expect(tester, re_pattern_span_budget(pattern, "took 12ms", 9, &span, &budget) == 1);
+    expect(tester, span.start == 5 && span.len == 4);
+    re_pattern_free(pattern);
+
+    // without the memo, each of the `a`s scans the rest of the text for a
+    // `c`, so the budget runs out
+    char *text = malloc(1000);
+    memset(text, 'a', 1000);
+
+    pattern = re_pattern_compile_flags("a.*c", RE_JIT | RE_NO_PREFILTER);
+    budget.steps = 100000;
+    expect(tester, re_pattern_match_budget(pattern, text, 1000, &budget) == RE_BUDGET_EXCEEDED);
+    span = (re_span_t) { 7, 7 };
+    expect(tester, re_pattern_span_budget(pattern, text, 1000, &span, &budget) == RE_BUDGET_EXCEEDED);
+    expect(tester, span.start == 7 && span.len == 7);
+
+    // ...and so does a deadline that has passed
+    budget.steps = 0;
+    clock_gettime(CLOCK_MONOTONIC, &budget.deadline);
+    expect(tester, re_pattern_match_budget(pattern, text, 1000, &budget) == RE_BUDGET_EXCEEDED);
+    re_pattern_free(pattern);
+
+    // with the memo, the same budget is plenty
+    pattern = re_pattern_compile_flags("a.*c", RE_MEMO | RE_NO_PREFILTER);
+    budget = (re_budget_t) { 100000, { 0, 0 } };
+    expect(tester, re_pattern_match_budget(pattern, text, 1000, &budget) == 0);
+    re_pattern_free(pattern);
+    free(text);
+
+    // the Pike VM takes linear time, so is not limited
+    pattern = re_pattern_compile("(a|b)+c");
+    budget.steps = 1;
+    expect(tester, re_pattern_span_budget(pattern, "xxababc", 7, &span, &budget) == 1);
+    expect(tester, span.start == 2 && span.len == 5);
+    re_pattern_free(pattern);
+
     log_tests(tester);
 }
 
@@ -315,6 +1099,19 @@ int main() {
     test_regex_nccl();
     test_regex_abbr();
     test_regex_return();
+    test_regex_pattern();
+    test_regex_span();
+    test_regex_iter();
+    test_regex_slice();
+    test_regex_abbr_compile();
+    test_regex_code();
+    test_regex_arena();
+    test_regex_groups();
+    test_regex_alternation();
+    test_regex_repeat();
+    test_regex_memo();
+    test_regex_stats();
+    test_regex_budget();
 
     return 0;
 }
@@ -0,0 +1,250 @@
+#include "regex.h"
+#include "regex-private.h"
+#include "nfa.h"
+#include "dfa.h"
+
+#include "testing-logger.h"
+#include <pthread.h>
+#include <string.h>
+
+#define NUM_THREADS 4
+
+enum { TOK_IF, TOK_WORD, TOK_NUM, TOK_SPACE, TOK_GT, TOK_APPEND, TOK_PIPE };
+
+static const char *const SHELL_PATTERNS[] = {
+    "if", "[a-z_][a-z_0-9]*", "\\d+", "\\s+", ">", ">>", "\\|"
+};
+static const int SHELL_TOKENS[] = {
+    TOK_IF, TOK_WORD, TOK_NUM, TOK_SPACE, TOK_GT, TOK_APPEND, TOK_PIPE
+};
+#define NUM_SHELL_PATTERNS (sizeof(SHELL_PATTERNS) / sizeof(SHELL_PATTERNS[0]))
+
+/* returns the length of the token at `text` (or -1), storing it in `token` */
+static long match(const re_set_t *set, const char *text, int *token) {
+    return re_set_match(set, text, strlen(text), token);
+}
+
+void test_set_longest() {
+    testing_logger_t *tester = create_tester();
+    re_set_t *set = re_set_compile(SHELL_PATTERNS, SHELL_TOKENS, NUM_SHELL_PATTERNS);
+    int token = -1;
+
+    expect(tester, set != NULL);
+
+    // the longest match wins over an earlier pattern...
+    expect(tester, match(set, "iffy", &token) == 4);
+    expect(tester, token == TOK_WORD);
+    expect(tester, match(set, ">> out", &token) == 2);
+    expect(tester, token == TOK_APPEND);
+
+    // ...and the earlier pattern wins a tie
+    expect(tester, match(set, "if x", &token) == 2);
+    expect(tester, token == TOK_IF);
+
+    expect(tester, match(set, "123abc", &token) == 3);
+    expect(tester, token == TOK_NUM);
+    expect(tester, match(set, " \t\nx", &token) == 3);
+    expect(tester, token == TOK_SPACE);
+    expect(tester, match(set, "> out", &token) == 1);
+    expect(tester, token == TOK_GT);
+
+    // no pattern matches, so the token is left alone
+    token = -1;
+    expect(tester, match(set, "&& x", &token) == -1);
+    expect(tester, token == -1);
+    expect(tester, match(set, "", &token) == -1);
+
+    // only the given length of the text is matched
+    expect(tester, re_set_match(set, "iffy", 2, &token) == 2);
+    expect(tester, token == TOK_IF);
+
+    re_set_free(set);
+    log_tests(tester);
+}
+
+void test_set_lex() {
+    testing_logger_t *tester = create_tester();
+    re_set_t *set = re_set_compile(SHELL_PATTERNS, SHELL_TOKENS, NUM_SHELL_PATTERNS);
+    const int expected[] = {
+        TOK_IF, TOK_SPACE, TOK_WORD, TOK_SPACE, TOK_PIPE, TOK_SPACE, TOK_WORD, TOK_SPACE,
+        TOK_NUM, TOK_APPEND, TOK_WORD
+    };
+    const char *text = "if cat_2 | head -12>>log";
+    size_t len = strlen(text), ntokens = 0;
+    int token;
+
+    // tokenize the text a match at a time, stopping at the unknown `-`
+    for (size_t pos = 0; pos < len; ) {
+        long n = re_set_match(set, text + pos, len - pos, &token);
+        if (n <= 0) {
+            expect(tester, text[pos] == '-');
+            pos++;
+            continue;
+        }
+
+        expect(tester, ntokens < sizeof(expected) / sizeof(expected[0]));
+        expect(tester, token == expected[ntokens]);
+        ntokens++;
+        pos += n;
+    }
+
+    expect(tester, ntokens == sizeof(expected) / sizeof(expected[0]));
+
+    re_set_free(set);
+    log_tests(tester);
+}
+
+void test_set_anchors() {
+    testing_logger_t *tester = create_tester();
+    const char *patterns[] = { "a*", "^ab", "b$" };
+    const int tokens[] = { 10, 20, 30 };
+    re_set_t *set = re_set_compile(patterns, tokens, 3);
+    int token;
+
+    // an empty match is still a match
+    expect(tester, match(set, "xyz", &token) == 0);
+    expect(tester, token == 10);
+
+    // `^` is implied at the position being matched
+    expect(tester, match(set, "abc", &token) == 2);
+    expect(tester, token == 20);
+    expect(tester, match(set, "aab", &token) == 2);
+    expect(tester, token == 10);
+
+    // `$` only matches at the end of the given length
+    expect(tester, match(set, "b", &token) == 1);
+    expect(tester, token == 30);
+    expect(tester, match(set, "bb", &token) == 0);
+    expect(tester, token == 10);
+    expect(tester, re_set_match(set, "bb", 1, &token) == 1);
+    expect(tester, token == 30);
+
+    re_set_free(set);
+    log_tests(tester);
+}
+
+void test_set_union() {
+    testing_logger_t *tester = create_tester();
+    re_t *regs[2] = { re_compile("ab*"), re_compile("^c") };
+    prog_t *progs[2] = { nfa_compile(regs[0], NULL), nfa_compile(regs[1], NULL) };
+    prog_t *prog = nfa_union(progs, 2, NULL);
+
+    // a split in front of the first program, then both programs in turn
+    expect(tester, prog->anchored);
+    expect(tester, prog->len == 1 + progs[0]->len + progs[1]->len);
+    expect(tester, prog->inst[0].op == OP_SPLIT);
+    expect(tester, prog->inst[0].x == 1);
+    expect(tester, prog->inst[0].y == 1 + progs[0]->len);
+    expect(tester, prog->inst[progs[0]->len].op == OP_MATCH);
+    expect(tester, prog->inst[progs[0]->len].x == 0);
+    expect(tester, prog->inst[prog->len - 1].op == OP_MATCH);
+    expect(tester, prog->inst[prog->len - 1].x == 1);
+
+    nfa_free(progs[0]);
+    nfa_free(progs[1]);
+
+    // the union outlives the programs it was built from
+    dfa_t *dfa = dfa_new(prog, DFA_DEFAULT_BUDGET);
+    const char *text = "abbbc";
+    int token = -1;
+    expect(tester, dfa_longest(dfa, text, text + strlen(text), &token) == 4);
+    expect(tester, token == 0);
+    text = "cab";
+    expect(tester, dfa_longest(dfa, text, text + strlen(text), &token) == 1);
+    expect(tester, token == 1);
+
+    // and the Pike VM finds the same longest matches
+    static const char *const texts[] = { "abbbc", "cab", "a", "", "b", "c" };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        const char *end = texts[i] + strlen(texts[i]);
+        int dfa_token = -1, nfa_token = -1;
+
+        expect(tester, dfa_longest(dfa, texts[i], end, &dfa_token) == nfa_longest(prog, texts[i], end, &nfa_token));
+        expect(tester, dfa_token == nfa_token);
+    }
+
+    dfa_free(dfa);
+    nfa_free(prog);
+    re_free(regs[0]);
+    re_free(regs[1]);
+
+    log_tests(tester);
+}
+
+/* a thread tokenizing the same text over and over with a shared set */
+typedef struct lexer {
+    const re_set_t *set;
+    size_t          wrong;      /* the number of tokens that were not expected */
+} lexer_t;
+
+static void *lex_shared(void *arg) {
+    lexer_t *lexer = arg;
+    const char *text = "if cat_2 | head >>log 12";
+    const int expected[] = {
+        TOK_IF, TOK_SPACE, TOK_WORD, TOK_SPACE, TOK_PIPE, TOK_SPACE, TOK_WORD, TOK_SPACE,
+        TOK_APPEND, TOK_WORD, TOK_SPACE, TOK_NUM
+    };
+    const size_t len = strlen(text);
+
+    for (int round = 0; round < 2000; round++) {
+        size_t ntokens = 0;
+        int token;
+
+        for (size_t pos = 0; pos < len; ntokens++) {
+            const long n = re_set_match(lexer->set, text + pos, len - pos, &token);
+            if (n <= 0 || ntokens >= sizeof(expected) / sizeof(expected[0]) || token != expected[ntokens]) {
+                lexer->wrong++;
+                break;
+            }
+
+            pos += n;
+        }
+    }
+
+    return NULL;
+}
+
+void test_set_threads() {
+    testing_logger_t *tester = create_tester();
+    re_set_t *set = re_set_compile(SHELL_PATTERNS, SHELL_TOKENS, NUM_SHELL_PATTERNS);
+    lexer_t lexers[NUM_THREADS];
+    pthread_t threads[NUM_THREADS];
+
+    // the DFA is taken over by one thread at a time, while the others run
+    // the Pike VM, so a set can be shared
+    for (int i = 0; i < NUM_THREADS; i++) {
+        lexers[i] = (lexer_t) { set, 0 };
+        pthread_create(&threads[i], NULL, lex_shared, &lexers[i]);
+    }
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        expect(tester, lexers[i].wrong == 0);
+    }
+
+    re_set_free(set);
+    log_tests(tester);
+}
+
+void test_set_errors() {
+    testing_logger_t *tester = create_tester();
+    const char *patterns[] = { "a", "[b" };
+    const int tokens[] = { 0, 1 };
+
+    expect(tester, re_set_compile(patterns, tokens, 2) == NULL);
+    expect(tester, re_set_compile(patterns, tokens, 0) == NULL);
+    re_set_free(NULL);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_set_longest();
+    test_set_lex();
+    test_set_anchors();
+    test_set_union();
+    test_set_threads();
+    test_set_errors();
+
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "regex.h"
+
+#include "testing-logger.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SPANS 256
+
+/* the matches a stream reported */
+typedef struct found {
+    re_span_t spans[MAX_SPANS];
+    size_t    n;
+} found_t;
+
+static void record(re_span_t span, void *data) {
+    found_t *found = data;
+    if (found->n < MAX_SPANS)
+        found->spans[found->n] = span;
+    found->n++;
+}
+
+/* feeds `text` to the stream in chunks of up to `chunk` bytes (or of random
+   sizes if it is 0), then finishes it. Returns the matches reported */
+static size_t feed(re_stream_t *stream, const char *text, size_t len, size_t chunk) {
+    size_t reported = 0;
+
+    for (size_t i = 0; i < len; ) {
+        size_t n = chunk ? chunk : (size_t) rand() % 8;
+        if (n > len - i)
+            n = len - i;
+
+        reported += re_stream_feed(stream, text + i, n);
+        i += n;
+    }
+
+    return reported + re_stream_finish(stream);
+}
+
+/* returns true if the stream found what iterating over the whole text does */
+static int same_as_iter(const re_pattern_t *pattern, const char *text, size_t len, const found_t *found) {
+    re_iter_t iter;
+    re_span_t span;
+    size_t n = 0;
+
+    re_iter_init_n(&iter, pattern, text, len);
+    for (; re_iter_next(&iter, &span); n++) {
+        if (n >= found->n || found->spans[n].start != span.start || found->spans[n].len != span.len)
+            return 0;
+    }
+
+    return n == found->n;
+}
+
+void test_stream_iter() {
+    testing_logger_t *tester = create_tester();
+    static const char *const patterns[] = {
+        "ab+c", "a*", "b|ab*", "(ab|a)(c|bcd)", "x?y", "[abc]{2,3}", "a.*c", "c$", "^a+", "(a|b)*c$", "", "a?$",
+        "^a|b", "x*(^a|$)", "a(.*d)?", "(a|)b?", "ab?(c.d)?", "(a|b.*c)(xy)?"
+    };
+    static const size_t chunks[] = { 1, 2, 3, 0, 64 };
+    char text[40];
+
+    srand(24);
+
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        // the stream's matches are the Pike VM's
+        re_pattern_t *pattern = re_pattern_compile_flags(patterns[i], RE_NFA);
+        found_t found;
+        re_stream_t *stream = re_stream_new(pattern, record, &found);
+
+        for (int trial = 0; trial < 200; trial++) {
+            const size_t len = rand() % sizeof(text);
+            for (size_t j = 0; j < len; j++)
+                text[j] = "abcdxy"[rand() % 6];
+
+            // the same stream is used again after each finish
+            for (size_t j = 0; j < sizeof(chunks) / sizeof(chunks[0]); j++) {
+                found.n = 0;
+                expect(tester, feed(stream, text, len, chunks[j]) == found.n);
+                expect(tester, same_as_iter(pattern, text, len, &found));
+            }
+        }
+
+        re_stream_free(stream);
+        re_pattern_free(pattern);
+    }
+
+    log_tests(tester);
+}
+
+void test_stream_edges() {
+    testing_logger_t *tester = create_tester();
+    re_pattern_t *pattern;
+    re_stream_t *stream;
+    found_t found = { 0 };
+
+    // a match is reported as soon as it is final, at its offset in the stream
+    pattern = re_pattern_compile("hello");
+    stream = re_stream_new(pattern, record, &found);
+    expect(tester, re_stream_feed(stream, "well, hel", 9) == 0);
+    expect(tester, re_stream_feed(stream, "lo", 2) == 1);
+    expect(tester, found.spans[0].start == 6 && found.spans[0].len == 5);
+    expect(tester, re_stream_feed(stream, " hello", 6) == 1);
+    expect(tester, found.spans[1].start == 12);
+    expect(tester, re_stream_finish(stream) == 0);
+
+    // and finishing starts the stream over
+    expect(tester, re_stream_feed(stream, "hello", 5) == 1);
+    expect(tester, found.spans[2].start == 0);
+    expect(tester, re_stream_finish(stream) == 0);
+    re_stream_free(stream);
+    re_pattern_free(pattern);
+
+    // a match that may still grow waits for more of the stream, or its end
+    found.n = 0;
+    pattern = re_pattern_compile("ab?c?");
+    stream = re_stream_new(pattern, record, &found);
+    expect(tester, re_stream_feed(stream, "xab", 3) == 0);
+    expect(tester, re_stream_finish(stream) == 1);
+    expect(tester, found.spans[0].start == 1 && found.spans[0].len == 2);
+    re_stream_free(stream);
+    re_pattern_free(pattern);
+
+    // `$` only matches once the stream ends
+    found.n = 0;
+    pattern = re_pattern_compile("a$");
+    stream = re_stream_new(pattern, record, &found);
+    expect(tester, re_stream_feed(stream, "aa", 2) == 0);
+    expect(tester, re_stream_feed(stream, "ba", 2) == 0);
+    expect(tester, re_stream_finish(stream) == 1);
+    expect(tester, found.spans[0].start == 3 && found.spans[0].len == 1);
+    re_stream_free(stream);
+    re_pattern_free(pattern);
+
+    // nothing fed is an empty stream
+    found.n = 0;
+    pattern = re_pattern_compile("x*");
+    stream = re_stream_new(pattern, record, &found);
+    expect(tester, re_stream_finish(stream) == 1);
+    expect(tester, found.spans[0].start == 0 && found.spans[0].len == 0);
+    re_stream_free(stream);
+    re_pattern_free(pattern);
+
+    // a pattern too large for the Pike VM cannot be streamed
+    pattern = re_pattern_compile("[ab]{1000}[bc]{1000}[cd]{1000}[de]{1000}[ef]{1000}[fg]{1000}"
+                                 "[gh]{1000}[hi]{1000}[ij]{1000}[jk]{1000}[kl]{1000}");
+    expect(tester, pattern != NULL);
+    expect(tester, re_stream_new(pattern, record, &found) == NULL);
+    re_pattern_free(pattern);
+
+    log_tests(tester);
+}
+
+void test_stream_long() {
+    testing_logger_t *tester = create_tester();
+    const size_t len = 1 << 22, chunk = 1000;
+    char *text = malloc(len);
+    size_t expected = 0;
+
+    // a match every 64 bytes, one of them across each chunk boundary
+    for (size_t i = 0; i < len; i++)
+        text[i] = i % 64 < 60 ? 'x' : "abbc"[i % 64 - 60];
+    for (size_t i = 62; i < len; i += 64)
+        expected++;
+
+    re_pattern_t *pattern = re_pattern_compile("ab+c");
+    found_t found = { 0 };
+    re_stream_t *stream = re_stream_new(pattern, record, &found);
+
+    expect(tester, feed(stream, text, len, chunk) == expected);
+    expect(tester, found.n == expected);
+    expect(tester, found.spans[MAX_SPANS - 1].start == 64 * MAX_SPANS - 4);
+
+    re_stream_free(stream);
+    re_pattern_free(pattern);
+    free(text);
+
+    log_tests(tester);
+}
+
+void test_stream_kept() {
+    testing_logger_t *tester = create_tester();
+    const size_t len = 1 << 22, chunk = 4096;
+    char *text = malloc(len);
+    found_t found = { 0 };
+
+    // a match that may grow for the whole stream keeps none of it, as the
+    // search after it runs alongside
+    re_pattern_t *pattern = re_pattern_compile("a(.*z)?");
+    re_stream_t *stream = re_stream_new(pattern, record, &found);
+    re_stream_set_limit(stream, 0);
+
+    memset(text, 'x', len);
+    expect(tester, re_stream_feed(stream, "a", 1) == 0);
+    expect(tester, feed(stream, text, len, chunk) == 1);
+    expect(tester, found.spans[0].start == 0 && found.spans[0].len == 1);
+
+    text[len - 1] = 'z';
+    found.n = 0;
+    expect(tester, re_stream_feed(stream, "a", 1) == 0);
+    expect(tester, feed(stream, text, len, chunk) == 1);
+    expect(tester, found.spans[0].start == 0 && found.spans[0].len == len + 1);
+
+    // and one after it that may grow too has the bytes since kept, up to
+    // the limit, after which the stream stops until it is finished
+    re_stream_set_limit(stream, 1000);
+    text[len - 1] = 'x';
+    text[10] = 'a';
+    found.n = 0;
+    expect(tester, re_stream_feed(stream, "a", 1) == 0);
+    expect(tester, re_stream_feed(stream, text, 1000) == 0);
+    expect(tester, re_stream_feed(stream, text + 1000, 1000) == RE_STREAM_ERROR);
+    expect(tester, re_stream_feed(stream, "z", 1) == RE_STREAM_ERROR);
+    expect(tester, re_stream_finish(stream) == RE_STREAM_ERROR);
+    expect(tester, found.n == 0);
+
+    // under the limit the kept bytes are searched again once the first
+    // match is final
+    expect(tester, re_stream_feed(stream, "a", 1) == 0);
+    expect(tester, re_stream_feed(stream, text, 500) == 0);
+    expect(tester, re_stream_feed(stream, "a", 1) == 0);
+    expect(tester, re_stream_finish(stream) == 3);
+    expect(tester, found.n == 3 && found.spans[1].start == 11 && found.spans[2].start == 501);
+
+    re_stream_free(stream);
+    re_pattern_free(pattern);
+    free(text);
+
+    log_tests(tester);
+}
+
+int main() {
+    test_stream_iter();
+    test_stream_edges();
+    test_stream_long();
+    test_stream_kept();
+
+    return 0;
+}